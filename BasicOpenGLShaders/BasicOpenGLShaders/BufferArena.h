@@ -0,0 +1,710 @@
+#ifndef BUFFER_ARENA_H
+#define BUFFER_ARENA_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "GLStateCache.h"
+#include "DirectStateAccess.h"
+
+// BUFFER ARENA
+// Giving every mesh its own vertex buffer and index buffer ends with thousands of buffer objects: the driver tracks every one of them,
+// and drawing a mesh means binding its buffers first. The arena carves the vertices and the indices of many meshes out of a few
+// large buffers (pages). An allocation is a range of a page: draws read it from GetBuffer at GetOffset.
+// The free ranges are found with TLSF (two level segregated fit): the free blocks are kept in lists by size, a list for every power of two
+// (first level), split into 16 lists of sizes between that power of two and the next (second level). A bit for every list that is not empty
+// finds a free block large enough in a few operations, whatever the number of blocks, and a freed block is merged with its free
+// neighbours right away. All the bookkeeping is on the CPU, nothing is read back from the buffers.
+// Allocating and freeing meshes in any order leaves holes between the allocations: there is enough free space in total,
+// but in pieces too small for a large mesh, which then needs a new page. Defragment moves a few allocations per call (a budget of bytes,
+// typically called every frame) with glCopyBufferSubData, without the data going through the CPU. It first slides the allocations of every page
+// towards its start, leaving its free space in one block at its end, then moves the allocations of the last page into the other pages
+// and deletes the page once it is empty. The copies are ordered with the draws: the draws submitted before read the old place,
+// and the draws after read the new one, once the offsets are read again.
+// The offset of an allocation changes when it is moved, so keep the handle and read the offset again after Defragment moved something
+// (the attribute offsets of the vertex arrays, the index offsets and the base vertices of the draws).
+//
+// Usage:
+//		BufferArena arena;
+//		BufferArena::Handle vertices = arena.Allocate(size, sizeof(Vertex), data);
+//		draw from arena.GetBuffer(vertices) at arena.GetOffset(vertices)
+//		arena.Defragment(1024 * 1024);			every frame, read the offsets again if it returns more than 0
+//		arena.Free(vertices);
+class BufferArena
+{
+public:
+	typedef GLuint Handle;
+
+	// Returned by Allocate when the arena cannot create a page large enough
+	static const Handle INVALID_HANDLE = 0xFFFFFFFF;
+
+	// The size of a page unless an allocation needs more
+	static const GLsizeiptr DEFAULT_PAGE_SIZE = 16 * 1024 * 1024;
+
+	// The state of the arena. The free space is fragmented when the largest free block is much smaller than all the free bytes.
+	struct Statistics
+	{
+		size_t pages;
+		GLsizeiptr capacity;
+		size_t allocations;
+		GLsizeiptr allocated;
+		size_t freeBlocks;
+		GLsizeiptr freeBytes;
+		GLsizeiptr largestFree;
+		// Since the creation of the arena
+		unsigned int moves;
+		GLsizeiptr movedBytes;
+	};
+
+	// Pages have at least pageSize bytes
+	explicit BufferArena(GLsizeiptr pageSize = DEFAULT_PAGE_SIZE)
+		: pageSize(pageSize), firstLevel(0), scratch(0), scratchSize(0), moves(0), movedBytes(0)
+	{
+		for (int fl = 0; fl < FL_COUNT; ++fl)
+		{
+			this->secondLevel[fl] = 0;
+			std::fill(this->freeLists[fl], this->freeLists[fl] + SL_COUNT, static_cast<GLuint>(NONE));
+		}
+	}
+
+	~BufferArena()
+	{
+		GLStateCache& state = GLStateCache::Global();
+		for (const Page& page : this->pages)
+		{
+			if (page.buffer != 0)
+			{
+				glDeleteBuffers(1, &page.buffer);
+				state.Forget(GL_BUFFER, page.buffer);
+			}
+		}
+		if (this->scratch != 0)
+		{
+			glDeleteBuffers(1, &this->scratch);
+			state.Forget(GL_BUFFER, this->scratch);
+		}
+	}
+
+	BufferArena(const BufferArena&) = delete;
+	BufferArena& operator=(const BufferArena&) = delete;
+
+	// Takes size bytes starting at a multiple of alignment (any alignment, sizeof(Vertex) makes the offset a whole number of vertices),
+	// creating a page if no free block is large enough, and uploads data into them unless it is nullptr
+	Handle Allocate(GLsizeiptr size, GLsizeiptr alignment = 4, const GLvoid* data = nullptr)
+	{
+		size = std::max<GLsizeiptr>(size, 1);
+		alignment = std::max<GLsizeiptr>(alignment, 1);
+		// Room for the worst padding before an aligned offset
+		const GLsizeiptr search = size + alignment - 1;
+		GLuint block = FindFree(search);
+		if (block == NONE)
+		{
+			if (!AddPage(std::max(this->pageSize, RoundUpSize(search))))
+			{
+				return INVALID_HANDLE;
+			}
+			block = FindFree(search);
+		}
+		RemoveFree(block);
+		block = Place(block, size, alignment);
+
+		Handle handle;
+		if (!this->unusedHandles.empty())
+		{
+			handle = this->unusedHandles.back();
+			this->unusedHandles.pop_back();
+			this->handles[handle] = block;
+		}
+		else
+		{
+			handle = static_cast<Handle>(this->handles.size());
+			this->handles.push_back(block);
+		}
+		this->blocks[block].handle = handle;
+
+		if (data != nullptr)
+		{
+			Upload(handle, data, size);
+		}
+		return handle;
+	}
+
+	// Gives the range back, its handle can be returned by a later Allocate
+	void Free(Handle handle)
+	{
+		if (!IsValid(handle))
+		{
+			return;
+		}
+		FreeBlock(this->handles[handle]);
+		this->handles[handle] = NONE;
+		this->unusedHandles.push_back(handle);
+	}
+
+	// Writes size bytes of data into an allocation, from offset bytes after its start
+	void Upload(Handle handle, const GLvoid* data, GLsizeiptr size, GLintptr offset = 0)
+	{
+		if (!IsValid(handle))
+		{
+			std::cout << "ERROR::BUFFER_ARENA::INVALID_HANDLE " << handle << std::endl;
+			return;
+		}
+		const Block& block = this->blocks[this->handles[handle]];
+		DirectStateAccess::BufferSubData(this->pages[block.page].buffer, block.offset + offset, std::min(size, block.size - offset), data);
+	}
+
+	// True if the handle is an allocation which has not been freed, INVALID_HANDLE never is
+	bool IsValid(Handle handle) const
+	{
+		return handle < this->handles.size() && this->handles[handle] != NONE;
+	}
+
+	// The buffer holding an allocation, 0 if the handle is not valid
+	GLuint GetBuffer(Handle handle) const
+	{
+		return IsValid(handle) ? this->pages[this->blocks[this->handles[handle]].page].buffer : 0;
+	}
+
+	// Where an allocation starts in its buffer, changes when Defragment moves it. 0 if the handle is not valid.
+	GLintptr GetOffset(Handle handle) const
+	{
+		return IsValid(handle) ? this->blocks[this->handles[handle]].offset : 0;
+	}
+
+	// The size of an allocation, 0 if the handle is not valid
+	GLsizeiptr GetSize(Handle handle) const
+	{
+		return IsValid(handle) ? this->blocks[this->handles[handle]].size : 0;
+	}
+
+	// Moves allocations until about budget bytes have been copied, or until there is nothing left to gain.
+	// Returns the number of allocations moved, their offsets (and maybe their buffers) have changed.
+	unsigned int Defragment(GLsizeiptr budget)
+	{
+		ReleaseEmptyPages();
+		unsigned int moved = 0;
+		GLsizeiptr copied = 0;
+		Slide(budget, moved, copied);
+		while (copied < budget)
+		{
+			const GLsizeiptr size = Evacuate();
+			if (size == 0)
+			{
+				break;
+			}
+			copied += size;
+			moved++;
+		}
+		ReleaseEmptyPages();
+		this->moves += moved;
+		this->movedBytes += copied;
+		return moved;
+	}
+
+	Statistics GetStatistics() const
+	{
+		Statistics statistics = { 0, 0, 0, 0, 0, 0, 0, this->moves, this->movedBytes };
+		for (const Page& page : this->pages)
+		{
+			if (page.buffer == 0)
+			{
+				continue;
+			}
+			statistics.pages++;
+			statistics.capacity += page.size;
+			for (GLuint index = page.first; index != NONE; index = this->blocks[index].next)
+			{
+				const Block& block = this->blocks[index];
+				if (block.handle == NONE)
+				{
+					statistics.freeBlocks++;
+					statistics.freeBytes += block.size;
+					statistics.largestFree = std::max(statistics.largestFree, block.size);
+				}
+				else
+				{
+					statistics.allocations++;
+					statistics.allocated += block.size;
+				}
+			}
+		}
+		return statistics;
+	}
+
+	// The part of the free bytes which is not in the largest free block, from 0 (one free block) to almost 1 (only tiny blocks)
+	static double GetFragmentation(const Statistics& statistics)
+	{
+		return statistics.freeBytes > 0 ? 1.0 - static_cast<double>(statistics.largestFree) / statistics.freeBytes : 0.0;
+	}
+
+	// The part of the pages used by allocations
+	static double GetOccupancy(const Statistics& statistics)
+	{
+		return statistics.capacity > 0 ? static_cast<double>(statistics.allocated) / statistics.capacity : 0.0;
+	}
+
+	void PrintStatistics(const std::string& name) const
+	{
+		const Statistics statistics = GetStatistics();
+		const double megabyte = 1024.0 * 1024.0;
+		std::cout << "BUFFER::ARENA " << name << " " << statistics.allocations << " allocations, " << statistics.allocated / megabyte << " MB in "
+			<< statistics.pages << " pages of " << statistics.capacity / megabyte << " MB (" << GetOccupancy(statistics) * 100.0 << "% occupancy), "
+			<< statistics.freeBlocks << " free blocks, largest " << statistics.largestFree / megabyte << " MB ("
+			<< GetFragmentation(statistics) * 100.0 << "% fragmentation), " << statistics.moves << " moves of "
+			<< statistics.movedBytes / megabyte << " MB" << std::endl;
+	}
+
+private:
+	static const GLuint NONE = 0xFFFFFFFF;
+	// 16 lists per power of two, sizes below 16 bytes have a list each
+	static const int SL_LOG2 = 4;
+	static const int SL_COUNT = 1 << SL_LOG2;
+	// Up to 2^43 bytes
+	static const int FL_COUNT = 40;
+
+	// A range of a page, free or allocated. The blocks of a page are linked in the order of their offsets,
+	// the free blocks are also linked in the list of their size.
+	struct Block
+	{
+		GLuint page;
+		GLintptr offset;
+		GLsizeiptr size;
+		// The alignment asked for, kept to move the block
+		GLsizeiptr alignment;
+		// NONE if the block is free
+		Handle handle;
+		GLuint previous;
+		GLuint next;
+		GLuint previousFree;
+		GLuint nextFree;
+	};
+
+	struct Page
+	{
+		// 0 once the page has been released
+		GLuint buffer;
+		GLsizeiptr size;
+		GLuint first;
+	};
+
+	GLsizeiptr pageSize;
+	std::vector<Page> pages;
+	std::vector<Block> blocks;
+	std::vector<GLuint> unusedBlocks;
+	// The block of every handle
+	std::vector<GLuint> handles;
+	std::vector<Handle> unusedHandles;
+	// The first free block of every list, and a bit for every list which is not empty
+	GLuint freeLists[FL_COUNT][SL_COUNT];
+	std::uint64_t firstLevel;
+	std::uint32_t secondLevel[FL_COUNT];
+	// Where an allocation is copied to when it moves to a place overlapping its old one
+	GLuint scratch;
+	GLsizeiptr scratchSize;
+	unsigned int moves;
+	GLsizeiptr movedBytes;
+
+	static int FloorLog2(GLsizeiptr size)
+	{
+		int log2 = 0;
+		while ((size >> (log2 + 1)) != 0)
+		{
+			log2++;
+		}
+		return log2;
+	}
+
+	static int LowestBit(std::uint64_t bits)
+	{
+		int bit = 0;
+		while ((bits & 1) == 0)
+		{
+			bits >>= 1;
+			bit++;
+		}
+		return bit;
+	}
+
+	static GLintptr RoundUp(GLintptr offset, GLsizeiptr alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	// The list of a size
+	static void Mapping(GLsizeiptr size, int& fl, int& sl)
+	{
+		if (size < SL_COUNT)
+		{
+			fl = 0;
+			sl = static_cast<int>(size);
+			return;
+		}
+		const int log2 = FloorLog2(size);
+		fl = log2 - SL_LOG2 + 1;
+		sl = static_cast<int>((size >> (log2 - SL_LOG2)) - SL_COUNT);
+	}
+
+	// The smallest size whose list only holds blocks of at least size bytes
+	static GLsizeiptr RoundUpSize(GLsizeiptr size)
+	{
+		return size < SL_COUNT ? size : size + (GLsizeiptr(1) << (FloorLog2(size) - SL_LOG2)) - 1;
+	}
+
+	// A free block of at least size bytes, NONE if there is none
+	GLuint FindFree(GLsizeiptr size) const
+	{
+		int fl, sl;
+		Mapping(RoundUpSize(size), fl, sl);
+		if (fl >= FL_COUNT)
+		{
+			return NONE;
+		}
+		std::uint32_t secondBits = this->secondLevel[fl] & (~std::uint32_t(0) << sl);
+		if (secondBits == 0)
+		{
+			const std::uint64_t firstBits = fl + 1 < FL_COUNT ? this->firstLevel & (~std::uint64_t(0) << (fl + 1)) : 0;
+			if (firstBits == 0)
+			{
+				return NONE;
+			}
+			fl = LowestBit(firstBits);
+			secondBits = this->secondLevel[fl];
+		}
+		return this->freeLists[fl][LowestBit(secondBits)];
+	}
+
+	void InsertFree(GLuint index)
+	{
+		Block& block = this->blocks[index];
+		int fl, sl;
+		Mapping(block.size, fl, sl);
+		block.handle = NONE;
+		block.previousFree = NONE;
+		block.nextFree = this->freeLists[fl][sl];
+		if (block.nextFree != NONE)
+		{
+			this->blocks[block.nextFree].previousFree = index;
+		}
+		this->freeLists[fl][sl] = index;
+		this->firstLevel |= std::uint64_t(1) << fl;
+		this->secondLevel[fl] |= std::uint32_t(1) << sl;
+	}
+
+	void RemoveFree(GLuint index)
+	{
+		const Block& block = this->blocks[index];
+		int fl, sl;
+		Mapping(block.size, fl, sl);
+		if (block.previousFree != NONE)
+		{
+			this->blocks[block.previousFree].nextFree = block.nextFree;
+		}
+		else
+		{
+			this->freeLists[fl][sl] = block.nextFree;
+			if (block.nextFree == NONE)
+			{
+				this->secondLevel[fl] &= ~(std::uint32_t(1) << sl);
+				if (this->secondLevel[fl] == 0)
+				{
+					this->firstLevel &= ~(std::uint64_t(1) << fl);
+				}
+			}
+		}
+		if (block.nextFree != NONE)
+		{
+			this->blocks[block.nextFree].previousFree = block.previousFree;
+		}
+	}
+
+	GLuint NewBlock(GLuint page, GLintptr offset, GLsizeiptr size)
+	{
+		const Block block = { page, offset, size, 1, NONE, NONE, NONE, NONE, NONE };
+		if (!this->unusedBlocks.empty())
+		{
+			const GLuint index = this->unusedBlocks.back();
+			this->unusedBlocks.pop_back();
+			this->blocks[index] = block;
+			return index;
+		}
+		this->blocks.push_back(block);
+		return static_cast<GLuint>(this->blocks.size() - 1);
+	}
+
+	// Puts a new block right after the block previous in its page
+	void LinkAfter(GLuint previous, GLuint index)
+	{
+		const GLuint next = this->blocks[previous].next;
+		this->blocks[index].previous = previous;
+		this->blocks[index].next = next;
+		this->blocks[previous].next = index;
+		if (next != NONE)
+		{
+			this->blocks[next].previous = index;
+		}
+	}
+
+	// Takes a block out of its page, its index can be reused
+	void Unlink(GLuint index)
+	{
+		const Block block = this->blocks[index];
+		if (block.previous != NONE)
+		{
+			this->blocks[block.previous].next = block.next;
+		}
+		else
+		{
+			this->pages[block.page].first = block.next;
+		}
+		if (block.next != NONE)
+		{
+			this->blocks[block.next].previous = block.previous;
+		}
+		this->unusedBlocks.push_back(index);
+	}
+
+	// Turns a block taken out of the free lists into an allocation of size bytes at an aligned offset.
+	// The space before and after the allocation goes back to the free lists.
+	GLuint Place(GLuint index, GLsizeiptr size, GLsizeiptr alignment)
+	{
+		const GLintptr aligned = RoundUp(this->blocks[index].offset, alignment);
+		const GLsizeiptr padding = aligned - this->blocks[index].offset;
+		if (padding > 0)
+		{
+			// The padding keeps the index of the block, which may be the first of its page
+			const GLuint allocation = NewBlock(this->blocks[index].page, aligned, this->blocks[index].size - padding);
+			LinkAfter(index, allocation);
+			this->blocks[index].size = padding;
+			InsertFree(index);
+			index = allocation;
+		}
+		if (this->blocks[index].size > size)
+		{
+			const GLuint rest = NewBlock(this->blocks[index].page, this->blocks[index].offset + size, this->blocks[index].size - size);
+			LinkAfter(index, rest);
+			this->blocks[index].size = size;
+			InsertFree(rest);
+		}
+		this->blocks[index].alignment = alignment;
+		return index;
+	}
+
+	// Frees a block, merging it with the free blocks around it
+	void FreeBlock(GLuint index)
+	{
+		const GLuint previous = this->blocks[index].previous;
+		if (previous != NONE && this->blocks[previous].handle == NONE)
+		{
+			RemoveFree(previous);
+			this->blocks[previous].size += this->blocks[index].size;
+			Unlink(index);
+			index = previous;
+		}
+		const GLuint next = this->blocks[index].next;
+		if (next != NONE && this->blocks[next].handle == NONE)
+		{
+			RemoveFree(next);
+			this->blocks[index].size += this->blocks[next].size;
+			Unlink(next);
+		}
+		InsertFree(index);
+	}
+
+	bool AddPage(GLsizeiptr size)
+	{
+		// The size of a page never changes, its store is immutable, only written by uploads and copies (GL_DYNAMIC_STORAGE_BIT)
+		Page page = { DirectStateAccess::CreateBuffer(), size, NONE };
+		// Errors left by earlier calls are cleared first, so the error checked below can only come from creating the store
+		while (glGetError() != GL_NO_ERROR)
+		{
+		}
+		DirectStateAccess::BufferStorage(page.buffer, size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+		const GLenum error = glGetError();
+		if (error != GL_NO_ERROR)
+		{
+			std::cout << "ERROR::BUFFER_ARENA::" << (error == GL_OUT_OF_MEMORY ? "OUT_OF_MEMORY" : "PAGE_NOT_CREATED")
+				<< " creating a page of " << size << " bytes" << std::endl;
+			glDeleteBuffers(1, &page.buffer);
+			GLStateCache::Global().Forget(GL_BUFFER, page.buffer);
+			return false;
+		}
+
+		// Reuse the place of a released page
+		GLuint index = 0;
+		while (index < this->pages.size() && this->pages[index].buffer != 0)
+		{
+			index++;
+		}
+		if (index == this->pages.size())
+		{
+			this->pages.push_back(page);
+		}
+		else
+		{
+			this->pages[index] = page;
+		}
+		this->pages[index].first = NewBlock(index, 0, size);
+		InsertFree(this->pages[index].first);
+		return true;
+	}
+
+	// Deletes the buffers of the pages without allocations
+	void ReleaseEmptyPages()
+	{
+		for (Page& page : this->pages)
+		{
+			if (page.buffer != 0 && this->blocks[page.first].handle == NONE && this->blocks[page.first].next == NONE)
+			{
+				RemoveFree(page.first);
+				Unlink(page.first);
+				glDeleteBuffers(1, &page.buffer);
+				GLStateCache::Global().Forget(GL_BUFFER, page.buffer);
+				page.buffer = 0;
+				page.first = NONE;
+			}
+		}
+	}
+
+	// Moves every allocation following a free block to the start of that free block, until budget bytes have been copied.
+	// The pages are compact once this copies less than the budget.
+	void Slide(GLsizeiptr budget, unsigned int& moved, GLsizeiptr& copied)
+	{
+		for (GLuint page = 0; page < this->pages.size() && copied < budget; ++page)
+		{
+			if (this->pages[page].buffer == 0)
+			{
+				continue;
+			}
+			const GLuint buffer = this->pages[page].buffer;
+			for (GLuint gap = this->pages[page].first; gap != NONE && copied < budget; gap = this->blocks[gap].next)
+			{
+				const GLuint index = this->blocks[gap].next;
+				if (this->blocks[gap].handle != NONE || index == NONE)
+				{
+					continue;
+				}
+				const Block block = this->blocks[index];
+				const GLintptr destination = RoundUp(this->blocks[gap].offset, block.alignment);
+				if (destination >= block.offset)
+				{
+					// The gap is only the padding of the allocation
+					continue;
+				}
+
+				if (destination + block.size > block.offset)
+				{
+					// A buffer cannot be copied into a range overlapping the source, the data goes through the scratch buffer
+					if (this->scratchSize < block.size)
+					{
+						if (this->scratch == 0)
+						{
+							this->scratch = DirectStateAccess::CreateBuffer();
+						}
+						this->scratchSize = std::max(block.size, this->scratchSize * 2);
+						DirectStateAccess::BufferData(this->scratch, this->scratchSize, nullptr, GL_STREAM_COPY);
+					}
+					DirectStateAccess::CopyBufferSubData(buffer, this->scratch, block.offset, 0, block.size);
+					DirectStateAccess::CopyBufferSubData(this->scratch, buffer, 0, destination, block.size);
+				}
+				else
+				{
+					DirectStateAccess::CopyBufferSubData(buffer, buffer, block.offset, destination, block.size);
+				}
+
+				// The free block keeps the padding before the new offset, and the space left after the allocation becomes free
+				const GLintptr end = block.offset + block.size;
+				RemoveFree(gap);
+				this->blocks[gap].size = destination - this->blocks[gap].offset;
+				this->blocks[index].offset = destination;
+				if (this->blocks[gap].size > 0)
+				{
+					InsertFree(gap);
+				}
+				else
+				{
+					Unlink(gap);
+				}
+				const GLuint rest = NewBlock(block.page, destination + block.size, end - destination - block.size);
+				LinkAfter(index, rest);
+				// Merges the new free block with the next one if it is free, the walk goes on from it
+				this->blocks[rest].handle = block.handle;
+				FreeBlock(rest);
+				gap = index;
+				copied += block.size;
+				moved++;
+			}
+		}
+	}
+
+	// Moves the last allocation of the last page into another page, if the other pages have room for everything of the last page.
+	// Returns the size of the allocation moved, 0 if nothing can be moved.
+	GLsizeiptr Evacuate()
+	{
+		GLuint last = NONE;
+		GLsizeiptr used = 0, otherFree = 0;
+		for (GLuint page = 0; page < this->pages.size(); ++page)
+		{
+			if (this->pages[page].buffer != 0)
+			{
+				if (last != NONE)
+				{
+					otherFree += this->pages[last].size - used;
+				}
+				last = page;
+				used = 0;
+				for (GLuint index = this->pages[page].first; index != NONE; index = this->blocks[index].next)
+				{
+					used += this->blocks[index].handle != NONE ? this->blocks[index].size : 0;
+				}
+			}
+		}
+		if (last == NONE || used == 0 || used > otherFree)
+		{
+			return 0;
+		}
+
+		// The free blocks of the last page leave the lists while searching, so the place found is in another page
+		GLuint allocation = NONE;
+		for (GLuint index = this->pages[last].first; index != NONE; index = this->blocks[index].next)
+		{
+			if (this->blocks[index].handle == NONE)
+			{
+				RemoveFree(index);
+			}
+			else
+			{
+				allocation = index;
+			}
+		}
+		const Block block = this->blocks[allocation];
+		GLuint destination = FindFree(block.size + block.alignment - 1);
+		for (GLuint index = this->pages[last].first; index != NONE; index = this->blocks[index].next)
+		{
+			if (this->blocks[index].handle == NONE)
+			{
+				InsertFree(index);
+			}
+		}
+		if (destination == NONE)
+		{
+			return 0;
+		}
+
+		RemoveFree(destination);
+		destination = Place(destination, block.size, block.alignment);
+		DirectStateAccess::CopyBufferSubData(this->pages[last].buffer, this->pages[this->blocks[destination].page].buffer,
+			block.offset, this->blocks[destination].offset, block.size);
+		this->blocks[destination].handle = block.handle;
+		this->handles[block.handle] = destination;
+		FreeBlock(allocation);
+		return block.size;
+	}
+};
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef DIRECT_STATE_ACCESS_H
+#define DIRECT_STATE_ACCESS_H
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "GLStateCache.h"
+
+// DIRECT STATE ACCESS
+// Before OpenGL 4.5 an object can only be edited while it is bound: glBindBuffer then glBufferData, glBindVertexArray then glVertexAttribPointer.
+// Every edit changes the bindings, so code loading a mesh has to bind, edit and unbind, and anything it forgets to restore
+// (the vertex array bound while an element buffer is bound, for example) silently changes what the next draw uses.
+// The binds also cost driver calls, which adds up when thousands of objects are created at startup.
+// Direct state access (OpenGL 4.5 or ARB_direct_state_access) edits objects by their name, without binding them:
+// glCreateBuffers, glNamedBufferData, glNamedBufferSubData, glMapNamedBufferRange, glCopyNamedBufferSubData,
+// glCreateVertexArrays, glVertexArrayElementBuffer, and glVertexArrayVertexBuffer with glVertexArrayAttribFormat (see VertexLayout.h).
+// These functions use it when the context has it, and otherwise bind the object through the state cache and edit it the old way.
+// Without direct state access the buffers are edited through GL_COPY_WRITE_BUFFER and GL_COPY_READ_BUFFER,
+// which are not part of the vertex arrays, so only the vertex array edits change the bindings seen by draws.
+// NOTE: glGenBuffers only reserves a name, the object is created when it is first bound: direct state access functions
+//		 cannot be used on it until then. Objects edited through these functions have to be created by CreateBuffer or CreateVertexArray.
+//
+// Usage:
+//		GLuint buffer = DirectStateAccess::CreateBuffer();
+//		DirectStateAccess::BufferData(buffer, size, data, GL_STATIC_DRAW);		whatever is bound stays bound
+class DirectStateAccess
+{
+public:
+	// True if the context edits objects without binding them
+	static bool IsSupported()
+	{
+		return GLEW_VERSION_4_5 || GLEW_ARB_direct_state_access;
+	}
+
+	// Uses the binding path even if the context has direct state access, to compare both. Call before creating any object.
+	static void SetEnabled(bool enabled)
+	{
+		Enabled() = enabled;
+	}
+
+	// True if direct state access is used
+	static bool IsEnabled()
+	{
+		return Enabled() && IsSupported();
+	}
+
+	static GLuint CreateBuffer()
+	{
+		GLuint buffer;
+		if (IsEnabled())
+		{
+			glCreateBuffers(1, &buffer);
+		}
+		else
+		{
+			glGenBuffers(1, &buffer);
+			GLStateCache::Global().BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		}
+		return buffer;
+	}
+
+	// Gives the buffer a new store of size bytes, filled with data unless it is nullptr
+	static void BufferData(GLuint buffer, GLsizeiptr size, const GLvoid* data, GLenum usage)
+	{
+		if (IsEnabled())
+		{
+			glNamedBufferData(buffer, size, data, usage);
+		}
+		else
+		{
+			GLStateCache::Global().BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			glBufferData(GL_COPY_WRITE_BUFFER, size, data, usage);
+		}
+	}
+
+	// Gives the buffer a store which cannot be resized or replaced, see glBufferStorage. Needs OpenGL 4.4 or ARB_buffer_storage,
+	// without them the store is created by glBufferData, which allows everything the flags can ask for except persistent mapping.
+	// ARB_direct_state_access only has glNamedBufferStorage when buffer storage is supported as well, so both paths check for it.
+	static void BufferStorage(GLuint buffer, GLsizeiptr size, const GLvoid* data, GLbitfield flags)
+	{
+		if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)
+		{
+			if (IsEnabled())
+			{
+				glNamedBufferStorage(buffer, size, data, flags);
+			}
+			else
+			{
+				GLStateCache::Global().BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+				glBufferStorage(GL_COPY_WRITE_BUFFER, size, data, flags);
+			}
+		}
+		else
+		{
+			BufferData(buffer, size, data, (flags & GL_MAP_WRITE_BIT) != 0 ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+		}
+	}
+
+	static void BufferSubData(GLuint buffer, GLintptr offset, GLsizeiptr size, const GLvoid* data)
+	{
+		if (IsEnabled())
+		{
+			glNamedBufferSubData(buffer, offset, size, data);
+		}
+		else
+		{
+			GLStateCache::Global().BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+		}
+	}
+
+	// Copies size bytes from a buffer to another one (or to another place of the same buffer, the ranges cannot overlap) on the GPU
+	static void CopyBufferSubData(GLuint source, GLuint destination, GLintptr sourceOffset, GLintptr destinationOffset, GLsizeiptr size)
+	{
+		if (IsEnabled())
+		{
+			glCopyNamedBufferSubData(source, destination, sourceOffset, destinationOffset, size);
+		}
+		else
+		{
+			GLStateCache& state = GLStateCache::Global();
+			state.BindBuffer(GL_COPY_READ_BUFFER, source);
+			state.BindBuffer(GL_COPY_WRITE_BUFFER, destination);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sourceOffset, destinationOffset, size);
+		}
+	}
+
+	static void* MapBufferRange(GLuint buffer, GLintptr offset, GLsizeiptr length, GLbitfield access)
+	{
+		if (IsEnabled())
+		{
+			return glMapNamedBufferRange(buffer, offset, length, access);
+		}
+		GLStateCache::Global().BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		return glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, length, access);
+	}
+
+	// The offset is relative to the start of the mapped range
+	static void FlushMappedBufferRange(GLuint buffer, GLintptr offset, GLsizeiptr length)
+	{
+		if (IsEnabled())
+		{
+			glFlushMappedNamedBufferRange(buffer, offset, length);
+		}
+		else
+		{
+			GLStateCache::Global().BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, offset, length);
+		}
+	}
+
+	static void UnmapBuffer(GLuint buffer)
+	{
+		if (IsEnabled())
+		{
+			glUnmapNamedBuffer(buffer);
+		}
+		else
+		{
+			GLStateCache::Global().BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		}
+	}
+
+	// Without direct state access the new vertex array is left bound, it only exists once it has been bound
+	static GLuint CreateVertexArray()
+	{
+		GLuint vertexArray;
+		if (IsEnabled())
+		{
+			glCreateVertexArrays(1, &vertexArray);
+		}
+		else
+		{
+			glGenVertexArrays(1, &vertexArray);
+			GLStateCache::Global().BindVertexArray(vertexArray);
+		}
+		return vertexArray;
+	}
+
+	// The buffer the indices of the draws are read from. Without direct state access the vertex array is left bound.
+	static void VertexArrayElementBuffer(GLuint vertexArray, GLuint buffer)
+	{
+		if (IsEnabled())
+		{
+			glVertexArrayElementBuffer(vertexArray, buffer);
+		}
+		else
+		{
+			GLStateCache& state = GLStateCache::Global();
+			state.BindVertexArray(vertexArray);
+			state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+		}
+	}
+
+private:
+	static bool& Enabled()
+	{
+		static bool enabled = true;
+		return enabled;
+	}
+};
+
+#endif
@@ -0,0 +1,110 @@
+// Generated by ShaderBake --embed from the shader permutation list, do not edit.
+// Run ShaderBake again (it runs after building the ShaderBake project) after changing the shaders.
+#ifndef EMBEDDED_SHADERS_H
+#define EMBEDDED_SHADERS_H
+
+#include "ShaderSource.h"
+
+namespace EmbeddedShaders
+{
+	constexpr ShaderCode core_vs = { "core.vs",
+R"glsl(// NOTE: before proceeding further, it is recommended you learn about the programmable graphics pipeline.
+// To know more about the programmable graphics pipeline please visit this website:
+// http://duriansoftware.com/joe/An-intro-to-modern-OpenGL.-Chapter-1:-The-Graphics-Pipeline.html
+
+// The vertex shader is used to transform the attributes of vertices such as color, texture, position
+// and the direction from the original color space to the display space. It allows the original objects
+// to be distorted or reshaped in any manner
+
+#version 330 core
+
+// Vertex attribute for position, which is at location 0
+layout (location = 0) in vec3 position;
+// Vertex attribute for color, which is at location 1
+layout (location = 1) in vec3 color;
+
+// The output color from vertex shader which will feed into fragment shader
+out vec3 ourColor;
+
+#ifdef QUANTIZED_POSITION
+// The positions are stored as 16 bit integers normalized to [-1, 1] inside the bounding box of the mesh (see VertexQuantize.h),
+// the scale and the offset of the box bring them back to the original coordinates
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+#endif
+
+#ifdef INSTANCED
+// Per instance attributes, they advance once per instance instead of once per vertex (see InstanceStream.h):
+// the offset of the instance in xyz and its scale in w, and a color multiplying the color of the vertex
+layout (location = 2) in vec4 instanceTransform;
+layout (location = 3) in vec4 instanceColor;
+#endif
+
+#ifdef OBJECT_UNIFORMS
+// The same values for a single object, set with glUniform before every draw
+uniform vec4 objectTransform;
+uniform vec4 objectColor;
+#endif
+
+#ifdef OBJECT_BLOCK
+// The same values read from a uniform block, every draw attaches its own part of a buffer to it (see UniformBuffer.h)
+layout (std140) uniform Object
+{
+	vec4 objectTransform;
+	vec4 objectColor;
+};
+#endif
+
+void main()
+{
+	// gl_Position is inbuilt vertex shader output variable of type vec4.
+	// In our case we store the position of the vertex in the variable
+#ifdef QUANTIZED_POSITION
+	vec3 vertexPosition = position * positionScale + positionOffset;
+#else
+	vec3 vertexPosition = position;
+#endif
+
+#ifdef INSTANCED
+	gl_Position = vec4(vertexPosition * instanceTransform.w + instanceTransform.xyz, 1.0);
+	ourColor = color * instanceColor.rgb;
+#elif defined(OBJECT_UNIFORMS) || defined(OBJECT_BLOCK)
+	gl_Position = vec4(vertexPosition * objectTransform.w + objectTransform.xyz, 1.0);
+	ourColor = color * objectColor.rgb;
+#else
+	gl_Position = vec4(vertexPosition, 1.0);
+	// store the color in ourColor output variable
+	ourColor = color;
+#endif
+})glsl"
+		, 2607, 0x723bab4998fe72f9ULL };
+	constexpr ShaderCode core_frag = { "core.frag",
+R"glsl(// NOTE: before proceeding further, it is recommended you learn about the programmable graphics pipeline.
+// To know more about the programmable graphics pipeline please visit this website:
+// http://duriansoftware.com/joe/An-intro-to-modern-OpenGL.-Chapter-1:-The-Graphics-Pipeline.html
+
+// The fragment shader is a shader that processes the fragment generated by the rasterization
+// into a set of colors and single depth value
+
+#version 330 core
+
+// The input for fragment shader, which is received from fragment
+// NOTE: Please make sure the variable names for input (in our case vec3 ourColor) matches exactly with
+//		 the output from the vertex shader
+in vec3 ourColor;
+
+// output variable for the color, this is used to display the final result on the screen
+// after performing necessary operations on it.
+out vec4 color;
+
+void main()
+{
+	// In this case we simply copy the input color to the output variable without any modifications.
+	color = vec4(ourColor, 1.0f);
+})glsl"
+		, 976, 0x2c63380efb6380faULL };
+}
+
+// File numbers in compiler messages: 892563 = core.vs, 961964 = core.frag
+
+#endif
@@ -0,0 +1,336 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+// GL STATE CACHE
+// OpenGL keeps its state until it is changed, but every call changing it still goes through the driver,
+// which validates it and often marks a lot of internal state as dirty, even when the new value is the one already set.
+// Binding the same program and vertex array again for every draw, and unbinding them after, costs CPU time for nothing.
+// The cache remembers the value of every state it sets and only calls OpenGL when the value actually changes:
+// the program in use, the vertex array, the buffers (also the indexed bindings of uniform and storage buffers),
+// the textures of every texture unit, the enabled capabilities, the blend and depth functions and the viewport.
+// It only works if every change of these states goes through it, a call made directly to OpenGL is not seen by the cache.
+// Call Invalidate() after code which changes the state directly, and Forget() after deleting an object.
+// The cache belongs to one context and has to be used from the thread of that context.
+//
+// Usage:
+//		GLStateCache& state = GLStateCache::Global();
+//		state.UseProgram(program);
+//		state.BindVertexArray(vertexArray);		does nothing if the vertex array is already bound
+class GLStateCache
+{
+public:
+	// Counts the calls sent to OpenGL and the ones dropped because they would not change anything
+	struct Statistics
+	{
+		unsigned int issued;
+		unsigned int filtered;
+	};
+
+	GLStateCache()
+		: statistics()
+	{
+		Invalidate();
+	}
+
+	GLStateCache(const GLStateCache&) = delete;
+	GLStateCache& operator=(const GLStateCache&) = delete;
+
+	// The cache of the context used by the application
+	static GLStateCache& Global()
+	{
+		static GLStateCache cache;
+		return cache;
+	}
+
+	// Forgets every value, the next call for every state is sent to OpenGL
+	void Invalidate()
+	{
+		this->program = UNKNOWN;
+		this->pipeline = UNKNOWN;
+		this->vertexArray = UNKNOWN;
+		this->buffers.clear();
+		this->indexedBuffers.clear();
+		this->activeTexture = UNKNOWN;
+		this->textures.clear();
+		this->capabilities.clear();
+		this->blendFunction = { { UNKNOWN, UNKNOWN } };
+		this->depthFunction = UNKNOWN;
+		this->depthMask = UNKNOWN;
+		this->viewport = { { -1, -1, -1, -1 } };
+	}
+
+	// Tells the cache an object was deleted, kind is GL_PROGRAM, GL_PROGRAM_PIPELINE, GL_VERTEX_ARRAY, GL_BUFFER or GL_TEXTURE.
+	// Deleting a bound object unbinds it, and its name can be given to a new object which would not be bound.
+	void Forget(GLenum kind, GLuint name)
+	{
+		switch (kind)
+		{
+		case GL_PROGRAM:
+			Clear(this->program, name);
+			break;
+		case GL_PROGRAM_PIPELINE:
+			Clear(this->pipeline, name);
+			break;
+		case GL_VERTEX_ARRAY:
+			if (this->vertexArray == name)
+			{
+				this->vertexArray = UNKNOWN;
+				GetBinding(this->buffers, GL_ELEMENT_ARRAY_BUFFER) = UNKNOWN;
+			}
+			break;
+		case GL_BUFFER:
+			for (Binding& binding : this->buffers)
+			{
+				Clear(binding.value, name);
+			}
+			for (IndexedBuffer& binding : this->indexedBuffers)
+			{
+				Clear(binding.buffer, name);
+			}
+			break;
+		case GL_TEXTURE:
+			for (Binding& binding : this->textures)
+			{
+				Clear(binding.value, name);
+			}
+			break;
+		}
+	}
+
+	void UseProgram(GLuint program)
+	{
+		if (Change(this->program, program))
+		{
+			glUseProgram(program);
+		}
+	}
+
+	void BindProgramPipeline(GLuint pipeline)
+	{
+		if (Change(this->pipeline, pipeline))
+		{
+			glBindProgramPipeline(pipeline);
+		}
+	}
+
+	// The element array buffer binding is part of the vertex array, so it changes with the vertex array
+	void BindVertexArray(GLuint vertexArray)
+	{
+		if (Change(this->vertexArray, vertexArray))
+		{
+			glBindVertexArray(vertexArray);
+			GetBinding(this->buffers, GL_ELEMENT_ARRAY_BUFFER) = UNKNOWN;
+		}
+	}
+
+	void BindBuffer(GLenum target, GLuint buffer)
+	{
+		if (Change(GetBinding(this->buffers, target), buffer))
+		{
+			glBindBuffer(target, buffer);
+		}
+	}
+
+	// Attaches a whole buffer to an indexed binding point (GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER...)
+	void BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+	{
+		// A size of 0 is not valid for glBindBufferRange, so it marks the bindings of whole buffers
+		BindIndexedBuffer(target, index, buffer, 0, 0);
+	}
+
+	// Attaches a part of a buffer to an indexed binding point
+	void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+	{
+		BindIndexedBuffer(target, index, buffer, offset, size);
+	}
+
+	// Binds a texture to a texture unit (0 for GL_TEXTURE0), changing the active texture unit only if needed
+	void BindTexture(GLuint unit, GLenum target, GLuint texture)
+	{
+		GLuint& binding = GetBinding(this->textures, static_cast<uint64_t>(unit) << 32 | target);
+		if (binding == texture)
+		{
+			this->statistics.filtered++;
+			return;
+		}
+		if (Change(this->activeTexture, unit))
+		{
+			glActiveTexture(GL_TEXTURE0 + unit);
+		}
+		binding = texture;
+		this->statistics.issued++;
+		glBindTexture(target, texture);
+	}
+
+	// glEnable or glDisable of a capability, for example GL_BLEND, GL_DEPTH_TEST or GL_CULL_FACE
+	void SetEnabled(GLenum capability, bool enabled)
+	{
+		if (Change(GetBinding(this->capabilities, capability), enabled ? 1u : 0u))
+		{
+			enabled ? glEnable(capability) : glDisable(capability);
+		}
+	}
+
+	void BlendFunc(GLenum source, GLenum destination)
+	{
+		if (Change(this->blendFunction, std::array<GLuint, 2>{ { source, destination } }))
+		{
+			glBlendFunc(source, destination);
+		}
+	}
+
+	void DepthFunc(GLenum function)
+	{
+		if (Change(this->depthFunction, function))
+		{
+			glDepthFunc(function);
+		}
+	}
+
+	void DepthMask(bool enabled)
+	{
+		if (Change(this->depthMask, enabled ? 1u : 0u))
+		{
+			glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+		}
+	}
+
+	void Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+	{
+		if (Change(this->viewport, std::array<GLint, 4>{ { x, y, width, height } }))
+		{
+			glViewport(x, y, width, height);
+		}
+	}
+
+	const Statistics& GetStatistics() const
+	{
+		return this->statistics;
+	}
+
+	// Call at the start of every frame to count the calls of that frame
+	void ResetStatistics()
+	{
+		this->statistics = Statistics();
+	}
+
+	void PrintStatistics() const
+	{
+		const unsigned int total = this->statistics.issued + this->statistics.filtered;
+		std::cout << "GL::STATE " << this->statistics.issued << " calls issued, " << this->statistics.filtered << " filtered ("
+			<< (total > 0 ? 100 * this->statistics.filtered / total : 0) << "% redundant)" << std::endl;
+	}
+
+private:
+	// The value of a state which has not been set through the cache, it never matches a real value
+	static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+	// A state with one value per target, unit or capability
+	struct Binding
+	{
+		uint64_t key;
+		GLuint value;
+	};
+
+	// The buffer attached to an indexed binding point, and the range of the buffer
+	struct IndexedBuffer
+	{
+		GLenum target;
+		GLuint index;
+		GLuint buffer;
+		GLintptr offset;
+		GLsizeiptr size;
+	};
+
+	GLuint program;
+	GLuint pipeline;
+	GLuint vertexArray;
+	std::vector<Binding> buffers;
+	std::vector<IndexedBuffer> indexedBuffers;
+	GLuint activeTexture;
+	std::vector<Binding> textures;
+	std::vector<Binding> capabilities;
+	std::array<GLuint, 2> blendFunction;
+	GLuint depthFunction;
+	GLuint depthMask;
+	std::array<GLint, 4> viewport;
+	Statistics statistics;
+
+	// Stores the new value of a state and returns true if it is different from the current one and has to be sent to OpenGL
+	template<typename T>
+	bool Change(T& current, const T& value)
+	{
+		if (current == value)
+		{
+			this->statistics.filtered++;
+			return false;
+		}
+		current = value;
+		this->statistics.issued++;
+		return true;
+	}
+
+	// Forgets the value of a state if it is the deleted object
+	static void Clear(GLuint& current, GLuint name)
+	{
+		if (current == name)
+		{
+			current = UNKNOWN;
+		}
+	}
+
+	// Returns the value stored for a key, states are only a handful of targets and units so a linear search is enough
+	static GLuint& GetBinding(std::vector<Binding>& bindings, uint64_t key)
+	{
+		for (Binding& binding : bindings)
+		{
+			if (binding.key == key)
+			{
+				return binding.value;
+			}
+		}
+		bindings.push_back(Binding{ key, UNKNOWN });
+		return bindings.back().value;
+	}
+
+	void BindIndexedBuffer(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+	{
+		IndexedBuffer* binding = nullptr;
+		for (IndexedBuffer& indexedBuffer : this->indexedBuffers)
+		{
+			if (indexedBuffer.target == target && indexedBuffer.index == index)
+			{
+				binding = &indexedBuffer;
+				break;
+			}
+		}
+		if (binding == nullptr)
+		{
+			this->indexedBuffers.push_back(IndexedBuffer{ target, index, UNKNOWN, 0, 0 });
+			binding = &this->indexedBuffers.back();
+		}
+
+		if (binding->buffer == buffer && binding->offset == offset && binding->size == size)
+		{
+			this->statistics.filtered++;
+			return;
+		}
+		binding->buffer = buffer;
+		binding->offset = offset;
+		binding->size = size;
+		this->statistics.issued++;
+		size == 0 ? glBindBufferBase(target, index, buffer) : glBindBufferRange(target, index, buffer, offset, size);
+		// Both functions also bind the buffer to the target itself
+		GetBinding(this->buffers, target) = buffer;
+	}
+};
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef INSTANCE_STREAM_H
+#define INSTANCE_STREAM_H
+
+#include <vector>
+#include <algorithm>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "VertexLayout.h"
+#include "VertexFormat.h"
+#include "StreamBuffer.h"
+
+// INSTANCED RENDERING
+// Drawing many copies of the same mesh with one draw call per copy costs a driver call, a uniform upload and validation
+// for every copy, and the CPU runs out of time long before the GPU does (tens of thousands of objects).
+// glDrawElementsInstanced draws all the copies (instances) in one call. What differs between them (their transform,
+// their color...) is read from per instance attributes: a vertex attribute with a divisor of 1 advances once per instance
+// instead of once per vertex, so instance i reads the i-th element of its buffer. In the shader gl_InstanceID is the instance.
+// The instance data changes every frame, so it is written into a streaming buffer (see StreamBuffer.h),
+// which gives every frame in flight its own region of the buffer.
+//
+// Usage, every frame:
+//		Instance* instances = stream.BeginFrame(count);		write stream.GetCount() instances
+//		stream.EndFrame();
+//		stream.Attach(vertexArray, instanceAttributes, 2);	the instance attributes start after the 2 vertex attributes
+//		state.BindVertexArray(vertexArray);
+// or, with the instance attributes added to a vertex format as binding point 1:
+//		stream.Attach(format, 1);
+//		format.Bind();
+// then
+//		glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr, stream.GetCount());
+//		stream.Fence();
+template <typename Instance>
+class InstanceStream
+{
+public:
+	// Creates a stream with room for capacity instances per frame, for the given number of frames in flight
+	InstanceStream(size_t capacity, int frames = 3, StreamBuffer::Strategy strategy = StreamBuffer::AUTOMATIC)
+		: stream(static_cast<GLsizeiptr>(capacity * sizeof(Instance)), frames, 4, strategy), capacity(capacity), count(0), offset(0)
+	{
+	}
+
+	InstanceStream(const InstanceStream&) = delete;
+	InstanceStream& operator=(const InstanceStream&) = delete;
+
+	// Moves to the next region and returns room for count instances, at most the capacity (see GetCount).
+	// Waits for the GPU only if it is still drawing with that region. Returns nullptr if the buffer cannot be written.
+	Instance* BeginFrame(size_t count)
+	{
+		this->stream.BeginFrame();
+		this->count = std::min(count, this->capacity);
+		const StreamBuffer::Allocation allocation = this->stream.Allocate(static_cast<GLsizeiptr>(this->count * sizeof(Instance)));
+		if (allocation.data == nullptr)
+		{
+			this->count = 0;
+		}
+		this->offset = allocation.offset;
+		return static_cast<Instance*>(allocation.data);
+	}
+
+	// Makes the instances of this frame visible to the GPU so they can be drawn
+	void EndFrame()
+	{
+		this->stream.EndFrame();
+	}
+
+	// Points the per instance attributes of a vertex array at the instances of this frame. The attributes take the locations
+	// from firstLocation on. The region changes every frame, so this is called every frame before drawing.
+	// firstInstance skips the first instances of the frame, for drivers without base instance (see MeshBatch.h).
+	// The vertex array is not bound if the context has direct state access, bind it before drawing.
+	template <size_t N>
+	void Attach(GLuint vertexArray, const VertexAttribute (&attributes)[N], GLuint firstLocation, GLuint firstInstance = 0) const
+	{
+		VertexLayout<Instance>::Apply(vertexArray, this->stream.GetBuffer(), attributes, this->offset + firstInstance * sizeof(Instance), firstLocation, 1);
+	}
+
+	// Points a binding point of a vertex format at the instances of this frame. The formats of the attributes were set
+	// when the binding point was added (with a divisor), only the buffer and the offset change (see VertexFormat.h).
+	void Attach(VertexFormat& format, GLuint binding, GLuint firstInstance = 0) const
+	{
+		format.BindVertexBuffer(binding, this->stream.GetBuffer(), this->offset + firstInstance * sizeof(Instance));
+	}
+
+	// Call after the last draw using this frame's instances, the region is reused once the GPU has passed this point
+	void Fence()
+	{
+		this->stream.Fence();
+	}
+
+	// The number of instances of this frame
+	GLsizei GetCount() const
+	{
+		return static_cast<GLsizei>(this->count);
+	}
+
+	size_t GetCapacity() const
+	{
+		return this->capacity;
+	}
+
+	GLuint GetBuffer() const
+	{
+		return this->stream.GetBuffer();
+	}
+
+private:
+	StreamBuffer stream;
+	size_t capacity;
+	// The instances of the current frame, and where they start in the buffer
+	size_t count;
+	GLintptr offset;
+};
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef MEMORY_BARRIERS_H
+#define MEMORY_BARRIERS_H
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+// MEMORY BARRIERS
+// Writes made by shaders to buffers (shader storage blocks) and images are not automatically visible to the commands that follow.
+// glMemoryBarrier makes them visible, but only for the kinds of access given in its bits: a buffer written by a compute shader
+// and then read as vertex data needs GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT, the same buffer read as indirect draw commands
+// needs GL_COMMAND_BARRIER_BIT, and so on. Issuing GL_ALL_BARRIER_BITS after every dispatch is correct but makes the GPU
+// wait for much more than needed.
+// MemoryBarrierTracker remembers which resources were written by shaders, and when a resource is about to be used
+// it asks for the one bit matching that use. Apply() then issues a single glMemoryBarrier with only the bits actually
+// needed, and nothing at all when no written resource is used.
+//
+// A resource stops being tracked once a barrier covered every way it is read: the bits given to Write, or all the bits
+// that apply to its kind (buffer or texture) when none are given, plus any other bit it was used with since.
+//
+// Usage:
+//		barriers.Write(GL_BUFFER, particles, GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);	after a dispatch writing the buffer
+//		barriers.Use(GL_BUFFER, particles, GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);	before drawing with it as vertex data
+//		barriers.Apply();											right before the draw or dispatch (Shader::Dispatch calls it)
+class MemoryBarrierTracker
+{
+public:
+	// Counts the barriers issued and the ones avoided
+	struct Statistics
+	{
+		// Calls to glMemoryBarrier, and the bits they used (all of them combined)
+		unsigned int barriers;
+		GLbitfield bits;
+		// Uses of resources which did not need a barrier
+		unsigned int skipped;
+	};
+
+	MemoryBarrierTracker()
+		: pending(0), statistics()
+	{
+	}
+
+	// The tracker shared by all the shaders
+	static MemoryBarrierTracker& Global()
+	{
+		static MemoryBarrierTracker tracker;
+		return tracker;
+	}
+
+	// Records that a shader wrote to a resource. kind is GL_BUFFER or GL_TEXTURE, name is the buffer or texture object.
+	// uses are the barrier bits of the ways the resource is read before it is written again, 0 for every way that applies to its kind.
+	void Write(GLenum kind, GLuint name, GLbitfield uses = 0)
+	{
+		const uint64_t key = GetKey(kind, name);
+		const GLbitfield consumers = uses != 0 ? uses : GetKindBits(kind);
+		for (Resource& resource : this->written)
+		{
+			if (resource.key == key)
+			{
+				// Barriers issued before this write do not cover it
+				resource.visible = 0;
+				resource.consumers = consumers;
+				return;
+			}
+		}
+		this->written.push_back(Resource{ key, 0, consumers });
+	}
+
+	// Declares how a resource is about to be used, barrier is the glMemoryBarrier bit of that use
+	// (GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT, GL_SHADER_STORAGE_BARRIER_BIT, GL_TEXTURE_FETCH_BARRIER_BIT...).
+	// The bit is only added to the next barrier if the resource was written by a shader and the bit was not issued since.
+	void Use(GLenum kind, GLuint name, GLbitfield barrier)
+	{
+		const uint64_t key = GetKey(kind, name);
+		for (Resource& resource : this->written)
+		{
+			if (resource.key == key && (resource.visible & barrier) != barrier)
+			{
+				// A use not announced by Write keeps the resource tracked until it is covered too
+				resource.consumers |= barrier;
+				this->pending |= barrier & ~resource.visible;
+				return;
+			}
+		}
+		this->statistics.skipped++;
+	}
+
+	// Stops tracking a resource, called when the buffer or texture is deleted (its name may be reused by a new object)
+	void Forget(GLenum kind, GLuint name)
+	{
+		const uint64_t key = GetKey(kind, name);
+		this->written.erase(std::remove_if(this->written.begin(), this->written.end(),
+			[key](const Resource& resource) { return resource.key == key; }), this->written.end());
+	}
+
+	// Issues the barrier needed by the uses declared since the last call, if any
+	void Apply()
+	{
+		if (this->pending == 0)
+		{
+			return;
+		}
+		glMemoryBarrier(this->pending);
+		this->statistics.barriers++;
+		this->statistics.bits |= this->pending;
+
+		// The barrier covers every write made so far, for the kinds of access in its bits
+		for (Resource& resource : this->written)
+		{
+			resource.visible |= this->pending;
+		}
+		// Resources visible to every way they are read no longer need tracking
+		this->written.erase(std::remove_if(this->written.begin(), this->written.end(),
+			[](const Resource& resource) { return (resource.visible & resource.consumers) == resource.consumers; }), this->written.end());
+		this->pending = 0;
+	}
+
+	// The number of written resources still waiting for a barrier
+	size_t GetTrackedCount() const
+	{
+		return this->written.size();
+	}
+
+	const Statistics& GetStatistics() const
+	{
+		return this->statistics;
+	}
+
+	void ResetStatistics()
+	{
+		this->statistics = Statistics();
+	}
+
+private:
+	// A resource written by a shader, the barrier bits issued since it was written, and the bits of the ways it is read
+	struct Resource
+	{
+		uint64_t key;
+		GLbitfield visible;
+		GLbitfield consumers;
+	};
+
+	std::vector<Resource> written;
+	// The bits the next barrier has to include
+	GLbitfield pending;
+	Statistics statistics;
+
+	// Buffers and textures have separate names, the kind keeps them apart
+	static uint64_t GetKey(GLenum kind, GLuint name)
+	{
+		return static_cast<uint64_t>(kind) << 32 | name;
+	}
+
+	// Every barrier bit of an access that can read a buffer or a texture
+	static GLbitfield GetKindBits(GLenum kind)
+	{
+		if (kind == GL_TEXTURE)
+		{
+			return GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT;
+		}
+		return GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT | GL_UNIFORM_BARRIER_BIT | GL_COMMAND_BARRIER_BIT
+			| GL_PIXEL_BUFFER_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT | GL_TRANSFORM_FEEDBACK_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT
+			| GL_SHADER_STORAGE_BARRIER_BIT | GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT | GL_QUERY_BUFFER_BARRIER_BIT;
+	}
+};
+
+#endif
@@ -0,0 +1,234 @@
+#ifndef MESH_BATCH_H
+#define MESH_BATCH_H
+
+#include <vector>
+#include <iostream>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "GLStateCache.h"
+#include "DirectStateAccess.h"
+#include "VertexLayout.h"
+#include "VertexFormat.h"
+#include "InstanceStream.h"
+
+// MULTI DRAW INDIRECT
+// Instancing draws many copies of one mesh in a call, but every different mesh still needs its own vertex array,
+// its own binds and its own draw call. Here all the static meshes of a vertex format share one vertex buffer and one index buffer:
+// a mesh is a range of indices (firstIndex, count) whose indices are relative to its first vertex (baseVertex).
+// The draws of a frame are recorded as DrawElementsIndirectCommand records, written into a buffer, and all of them
+// are submitted with one glMultiDrawElementsIndirect call, whatever the number of meshes.
+// The per draw data (transform, color...) are per instance attributes (see InstanceStream.h): every command gives
+// the first instance it reads (baseInstance), so draw i reads its own data without any state change between the draws.
+// glMultiDrawElementsIndirect and base instance need OpenGL 4.3 (or ARB_multi_draw_indirect and ARB_base_instance).
+// On a 3.3 context the commands are drawn one by one with glDrawElementsInstancedBaseVertex, pointing the instance attributes
+// at the data of every draw: still no vertex array or buffer binds between the draws, but one call per draw.
+// The vertex array is a VertexFormat with the vertices as binding point 0 and the per draw data as binding point 1,
+// so pointing the instance attributes at the data of a draw is a single glBindVertexBuffer (see VertexFormat.h).
+// NOTE: the draw index comes from the base instance, not from gl_DrawID, which needs OpenGL 4.6 (ARB_shader_draw_parameters).
+//
+// Usage:
+//		MeshBatch<Vertex> batch(vertexAttributes);
+//		GLuint mesh = batch.Add(vertices, indices);		for every mesh, then
+//		batch.Upload();
+//		every frame: write the per draw data into an InstanceStream, then
+//		batch.Draw(mesh, 1, instance);					for every object
+//		batch.Submit(stream, instanceAttributes, 2);
+template <typename Vertex>
+class MeshBatch
+{
+public:
+	// The layout of the records read by glMultiDrawElementsIndirect from GL_DRAW_INDIRECT_BUFFER
+	struct DrawElementsIndirectCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// Where a mesh is in the shared buffers
+	struct Mesh
+	{
+		GLuint firstIndex;
+		GLuint indexCount;
+		GLint baseVertex;
+		GLuint vertexCount;
+	};
+
+	// Counts the draws recorded and the draw calls made for them
+	struct Statistics
+	{
+		unsigned int draws;
+		unsigned int calls;
+	};
+
+	// Creates the shared buffers and a vertex format reading them with the given vertex attributes (locations 0 to N - 1)
+	template <size_t N>
+	explicit MeshBatch(const VertexAttribute (&attributes)[N])
+		: multiDrawIndirect(IsMultiDrawIndirectSupported()), statistics()
+	{
+		this->vertexBuffer = DirectStateAccess::CreateBuffer();
+		this->indexBuffer = DirectStateAccess::CreateBuffer();
+		this->indirectBuffer = DirectStateAccess::CreateBuffer();
+		this->format.template AddBinding<Vertex>(VERTEX_BINDING, attributes);
+		this->format.BindVertexBuffer(VERTEX_BINDING, this->vertexBuffer);
+		this->format.BindElementBuffer(this->indexBuffer);
+	}
+
+	~MeshBatch()
+	{
+		GLStateCache& state = GLStateCache::Global();
+		const GLuint buffers[] = { this->vertexBuffer, this->indexBuffer, this->indirectBuffer };
+		glDeleteBuffers(3, buffers);
+		for (GLuint buffer : buffers)
+		{
+			state.Forget(GL_BUFFER, buffer);
+		}
+	}
+
+	MeshBatch(const MeshBatch&) = delete;
+	MeshBatch& operator=(const MeshBatch&) = delete;
+
+	// True if the driver can draw all the commands in one call
+	static bool IsMultiDrawIndirectSupported()
+	{
+		return GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+	}
+
+	// Draws the commands one by one even if the driver could draw them in one call, to compare both
+	void SetMultiDrawIndirect(bool enabled)
+	{
+		this->multiDrawIndirect = enabled && IsMultiDrawIndirectSupported();
+	}
+
+	bool IsMultiDrawIndirect() const
+	{
+		return this->multiDrawIndirect;
+	}
+
+	// Appends a mesh to the shared buffers and returns its number. The indices are relative to the vertices of the mesh.
+	// The meshes are static: they are sent to the GPU by Upload, after adding all of them.
+	GLuint Add(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices)
+	{
+		const Mesh mesh = { static_cast<GLuint>(this->indices.size()), static_cast<GLuint>(indices.size()),
+			static_cast<GLint>(this->vertices.size()), static_cast<GLuint>(vertices.size()) };
+		this->vertices.insert(this->vertices.end(), vertices.begin(), vertices.end());
+		this->indices.insert(this->indices.end(), indices.begin(), indices.end());
+		this->meshes.push_back(mesh);
+		return static_cast<GLuint>(this->meshes.size() - 1);
+	}
+
+	// Sends the vertices and the indices of all the meshes to the GPU
+	void Upload()
+	{
+		DirectStateAccess::BufferData(this->vertexBuffer, this->vertices.size() * sizeof(Vertex), this->vertices.data(), GL_STATIC_DRAW);
+		DirectStateAccess::BufferData(this->indexBuffer, this->indices.size() * sizeof(GLuint), this->indices.data(), GL_STATIC_DRAW);
+	}
+
+	// Records a draw of instanceCount instances of a mesh, reading the per draw data of the instances from firstInstance on
+	// (counted from the start of the frame's instances)
+	void Draw(GLuint mesh, GLuint instanceCount, GLuint firstInstance)
+	{
+		const Mesh& range = this->meshes[mesh];
+		this->commands.push_back(DrawElementsIndirectCommand{ range.indexCount, instanceCount, range.firstIndex, range.baseVertex, firstInstance });
+	}
+
+	// Draws every command recorded since the last Submit, with the per draw data of the instance stream
+	// read by the attributes from firstLocation on. The instance attributes are added to the vertex format by the first Submit.
+	template <typename Instance, size_t N>
+	void Submit(const InstanceStream<Instance>& instances, const VertexAttribute (&attributes)[N], GLuint firstLocation, GLenum mode = GL_TRIANGLES)
+	{
+		if (this->commands.empty())
+		{
+			return;
+		}
+		this->statistics.draws += static_cast<unsigned int>(this->commands.size());
+		if (!this->format.HasBinding(INSTANCE_BINDING))
+		{
+			this->format.template AddBinding<Instance>(INSTANCE_BINDING, attributes, firstLocation, 1);
+		}
+		this->format.Bind();
+
+		if (this->multiDrawIndirect)
+		{
+			instances.Attach(this->format, INSTANCE_BINDING);
+			// Giving glBufferData the data allocates a new store every frame (orphaning),
+			// so the GPU can still read the commands of the previous frame while these are written.
+			// The draw reads the commands from the buffer bound to GL_DRAW_INDIRECT_BUFFER.
+			DirectStateAccess::BufferData(this->indirectBuffer, this->commands.size() * sizeof(DrawElementsIndirectCommand), this->commands.data(), GL_STREAM_DRAW);
+			GLStateCache::Global().BindBuffer(GL_DRAW_INDIRECT_BUFFER, this->indirectBuffer);
+			glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(this->commands.size()), 0);
+			this->statistics.calls++;
+		}
+		else
+		{
+			for (const DrawElementsIndirectCommand& command : this->commands)
+			{
+				instances.Attach(this->format, INSTANCE_BINDING, command.baseInstance);
+				glDrawElementsInstancedBaseVertex(mode, static_cast<GLsizei>(command.count), GL_UNSIGNED_INT,
+					reinterpret_cast<const GLvoid*>(command.firstIndex * sizeof(GLuint)), static_cast<GLsizei>(command.instanceCount), command.baseVertex);
+				this->statistics.calls++;
+			}
+		}
+		this->commands.clear();
+	}
+
+	GLuint GetVertexArray() const
+	{
+		return this->format.GetVertexArray();
+	}
+
+	const VertexFormat& GetFormat() const
+	{
+		return this->format;
+	}
+
+	const Mesh& GetMesh(GLuint mesh) const
+	{
+		return this->meshes[mesh];
+	}
+
+	size_t GetMeshCount() const
+	{
+		return this->meshes.size();
+	}
+
+	const Statistics& GetStatistics() const
+	{
+		return this->statistics;
+	}
+
+	void ResetStatistics()
+	{
+		this->statistics = Statistics();
+	}
+
+	void PrintStatistics() const
+	{
+		std::cout << "MESH::BATCH " << this->meshes.size() << " meshes, " << this->statistics.draws << " draws in " << this->statistics.calls
+			<< (this->multiDrawIndirect ? " multi draw indirect calls" : " draw calls") << std::endl;
+	}
+
+private:
+	// The binding points of the vertices and of the per draw data
+	static const GLuint VERTEX_BINDING = 0;
+	static const GLuint INSTANCE_BINDING = 1;
+
+	VertexFormat format;
+	GLuint vertexBuffer;
+	GLuint indexBuffer;
+	GLuint indirectBuffer;
+	bool multiDrawIndirect;
+	// The data of all the meshes, kept to upload them again
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+	std::vector<Mesh> meshes;
+	// The draws recorded since the last Submit
+	std::vector<DrawElementsIndirectCommand> commands;
+	Statistics statistics;
+};
+
+#endif
@@ -0,0 +1,345 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <type_traits>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "ShaderCache.h"
+
+// MESH OPTIMIZER
+// Drawn with glDrawArrays, a vertex shared by six triangles is stored six times and transformed six times.
+// With an index buffer (glDrawElements) every vertex is stored once, and the GPU keeps the last transformed vertices
+// in a small cache (the post-transform cache), so a vertex used again soon after is not transformed again.
+// How much that helps depends on the order of the triangles, so a mesh goes through these steps:
+//		Weld				turns a list of vertices (three per triangle) into unique vertices and indices, duplicates are found by hashing
+//		OptimizeVertexCache	orders the triangles so they reuse the vertices in the cache (Tipsify, Sander et al. 2007)
+//		OptimizeOverdraw	orders groups of triangles so the ones likely to hide the others are drawn first, keeping the cache order inside them
+//		OptimizeVertexFetch	orders the vertices in the order the triangles use them, so the vertex buffer is read from start to end
+// Optimize runs the last three. The steps can be run offline on the data of a file, or at runtime after loading it.
+// AnalyzeVertexCache measures the result by simulating the cache:
+//		ACMR (average cache miss ratio), vertices transformed per triangle: 3 without indices, about 0.5 to 0.7 at best
+//		ATVR (average transformed vertex ratio), vertices transformed per vertex of the mesh: 1 is the best possible
+//
+// Usage:
+//		std::vector<GLuint> indices = MeshOptimizer::Weld(vertices);
+//		MeshOptimizer::Optimize(vertices, indices, [](const Vertex& vertex) { return vertex.position; });
+class MeshOptimizer
+{
+public:
+	// The result of the cache simulation
+	struct Statistics
+	{
+		double acmr;
+		double atvr;
+		size_t triangles;
+		size_t vertices;
+	};
+
+	// Vertices in the simulated cache. Hardware caches hold between 16 and 32 vertices,
+	// ordering for a smaller cache than the real one costs little, the opposite costs a lot.
+	static const size_t CACHE_SIZE = 16;
+
+	// Replaces the vertices (three per triangle) with the unique ones, in the order they first appear, and returns the indices of the triangles.
+	// Vertices are compared byte by byte: padding bytes in the vertex have to be zero, and 0.0 and -0.0 are different vertices.
+	template <typename Vertex>
+	static std::vector<GLuint> Weld(std::vector<Vertex>& vertices)
+	{
+		static_assert(std::is_trivially_copyable<Vertex>::value, "Vertices are welded by comparing their bytes");
+
+		// Open addressing hash table of the unique vertices, at least twice as large as the number of vertices
+		size_t capacity = 1;
+		while (capacity < vertices.size() * 2)
+		{
+			capacity <<= 1;
+		}
+		std::vector<GLuint> table(capacity, static_cast<GLuint>(NONE));
+		std::vector<Vertex> unique;
+		std::vector<GLuint> indices(vertices.size());
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			size_t slot = static_cast<size_t>(ShaderCache::Hash(&vertices[i], sizeof(Vertex))) & (capacity - 1);
+			while (table[slot] != NONE && memcmp(&unique[table[slot]], &vertices[i], sizeof(Vertex)) != 0)
+			{
+				slot = (slot + 1) & (capacity - 1);
+			}
+			if (table[slot] == NONE)
+			{
+				table[slot] = static_cast<GLuint>(unique.size());
+				unique.push_back(vertices[i]);
+			}
+			indices[i] = table[slot];
+		}
+		vertices.swap(unique);
+		return indices;
+	}
+
+	// Runs the cache, overdraw and fetch optimizations. getPosition returns the position of a vertex as 3 floats (any type with operator[]).
+	template <typename Vertex, typename GetPosition>
+	static void Optimize(std::vector<Vertex>& vertices, std::vector<GLuint>& indices, GetPosition getPosition, size_t cacheSize = CACHE_SIZE)
+	{
+		OptimizeVertexCache(indices, vertices.size(), cacheSize);
+		OptimizeOverdraw(indices, vertices, getPosition, cacheSize);
+		OptimizeVertexFetch(vertices, indices);
+	}
+
+	// Tipsify: walks the mesh from vertex to vertex, emitting all the remaining triangles of the current vertex (its fan).
+	// The next vertex is one of the vertices just emitted which is still in the cache and will stay in it
+	// while its remaining triangles are emitted, the oldest one preferred. When there is none (a dead end),
+	// the walk goes back to the most recent vertex with triangles left, or else to the next one in the buffer.
+	// Runs in linear time, so it can be used on large meshes at load time.
+	static void OptimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount, size_t cacheSize = CACHE_SIZE)
+	{
+		const size_t triangleCount = indices.size() / 3;
+
+		// The triangles of every vertex: the triangles of vertex v are adjacency[firstTriangle[v]] to adjacency[firstTriangle[v + 1] - 1]
+		std::vector<GLuint> liveTriangles(vertexCount, 0);
+		for (size_t i = 0; i < triangleCount * 3; ++i)
+		{
+			liveTriangles[indices[i]]++;
+		}
+		std::vector<GLuint> firstTriangle(vertexCount + 1, 0);
+		for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+		{
+			firstTriangle[vertex + 1] = firstTriangle[vertex] + liveTriangles[vertex];
+		}
+		std::vector<GLuint> adjacency(triangleCount * 3);
+		std::vector<GLuint> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; ++i)
+		{
+			adjacency[filled[indices[i]]++] = static_cast<GLuint>(i / 3);
+		}
+
+		// A vertex is in the cache if fewer than cacheSize vertices entered the cache after it
+		std::vector<size_t> timestamps(vertexCount, 0);
+		size_t time = cacheSize + 1;
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<GLuint> deadEnds;
+		std::vector<GLuint> candidates;
+		std::vector<GLuint> ordered;
+		ordered.reserve(triangleCount * 3);
+		size_t cursor = 0;
+
+		GLuint vertex = SkipDeadEnd(deadEnds, liveTriangles, cursor);
+		while (vertex != NONE)
+		{
+			candidates.clear();
+			for (GLuint i = firstTriangle[vertex]; i < firstTriangle[vertex + 1]; ++i)
+			{
+				const GLuint triangle = adjacency[i];
+				if (emitted[triangle])
+				{
+					continue;
+				}
+				emitted[triangle] = true;
+				for (size_t corner = 0; corner < 3; ++corner)
+				{
+					const GLuint index = indices[triangle * 3 + corner];
+					ordered.push_back(index);
+					deadEnds.push_back(index);
+					candidates.push_back(index);
+					liveTriangles[index]--;
+					if (time - timestamps[index] > cacheSize)
+					{
+						timestamps[index] = time++;
+					}
+				}
+			}
+
+			// The candidate which stays in the cache while its remaining triangles (up to 2 new vertices each) are emitted,
+			// and which entered the cache the earliest
+			GLuint next = NONE;
+			size_t bestPriority = 0;
+			for (GLuint candidate : candidates)
+			{
+				const size_t age = time - timestamps[candidate];
+				if (liveTriangles[candidate] > 0 && age + 2 * liveTriangles[candidate] <= cacheSize && age > bestPriority)
+				{
+					bestPriority = age;
+					next = candidate;
+				}
+			}
+			vertex = next != NONE ? next : SkipDeadEnd(deadEnds, liveTriangles, cursor);
+		}
+
+		// Indices which do not make a whole triangle are kept at the end
+		ordered.insert(ordered.end(), indices.begin() + triangleCount * 3, indices.end());
+		indices.swap(ordered);
+	}
+
+	// Splits the triangles, in their cache order, into clusters starting where none of the vertices of a triangle is in the cache,
+	// so moving a cluster costs almost nothing in cache misses. The clusters are then sorted by how much they face outward
+	// from the center of the mesh: those are the most likely to hide the rest of the mesh, and are drawn first
+	// so the hidden pixels fail the depth test instead of being shaded.
+	template <typename Vertex, typename GetPosition>
+	static void OptimizeOverdraw(std::vector<GLuint>& indices, const std::vector<Vertex>& vertices, GetPosition getPosition, size_t cacheSize = CACHE_SIZE)
+	{
+		struct Cluster
+		{
+			size_t start;
+			size_t end;
+			// Sum of the triangle centers weighted by their area, sum of the triangle normals (which have the length of twice their area)
+			double center[3];
+			double normal[3];
+			double area;
+			double sortKey;
+		};
+
+		const size_t triangleCount = indices.size() / 3;
+		std::vector<Cluster> clusters;
+		std::vector<size_t> timestamps(vertices.size(), 0);
+		size_t time = cacheSize + 1;
+		double meshCenter[3] = { 0.0, 0.0, 0.0 };
+		double meshArea = 0.0;
+		for (size_t triangle = 0; triangle < triangleCount; ++triangle)
+		{
+			size_t misses = 0;
+			for (size_t corner = 0; corner < 3; ++corner)
+			{
+				const GLuint index = indices[triangle * 3 + corner];
+				if (time - timestamps[index] > cacheSize)
+				{
+					timestamps[index] = time++;
+					misses++;
+				}
+			}
+			if (misses == 3 || clusters.empty())
+			{
+				clusters.push_back(Cluster{ triangle, triangle, { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 }, 0.0, 0.0 });
+			}
+			Cluster& cluster = clusters.back();
+			cluster.end = triangle + 1;
+
+			double corners[3][3];
+			for (size_t corner = 0; corner < 3; ++corner)
+			{
+				const auto position = getPosition(vertices[indices[triangle * 3 + corner]]);
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					corners[corner][axis] = position[axis];
+				}
+			}
+			const double u[3] = { corners[1][0] - corners[0][0], corners[1][1] - corners[0][1], corners[1][2] - corners[0][2] };
+			const double v[3] = { corners[2][0] - corners[0][0], corners[2][1] - corners[0][1], corners[2][2] - corners[0][2] };
+			const double normal[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+			const double area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]) * 0.5;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				const double center = (corners[0][axis] + corners[1][axis] + corners[2][axis]) / 3.0;
+				cluster.center[axis] += center * area;
+				cluster.normal[axis] += normal[axis];
+				meshCenter[axis] += center * area;
+			}
+			cluster.area += area;
+			meshArea += area;
+		}
+
+		for (Cluster& cluster : clusters)
+		{
+			const double length = std::sqrt(cluster.normal[0] * cluster.normal[0] + cluster.normal[1] * cluster.normal[1] + cluster.normal[2] * cluster.normal[2]);
+			for (int axis = 0; axis < 3 && cluster.area > 0.0 && meshArea > 0.0 && length > 0.0; ++axis)
+			{
+				cluster.sortKey += (cluster.center[axis] / cluster.area - meshCenter[axis] / meshArea) * cluster.normal[axis] / length;
+			}
+		}
+		std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+		std::vector<GLuint> ordered;
+		ordered.reserve(indices.size());
+		for (const Cluster& cluster : clusters)
+		{
+			ordered.insert(ordered.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+		}
+		ordered.insert(ordered.end(), indices.begin() + triangleCount * 3, indices.end());
+		indices.swap(ordered);
+	}
+
+	// Moves the vertices into the order the indices first use them, and removes the vertices no triangle uses
+	template <typename Vertex>
+	static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+	{
+		std::vector<GLuint> remap(vertices.size(), static_cast<GLuint>(NONE));
+		std::vector<Vertex> ordered;
+		ordered.reserve(vertices.size());
+		for (GLuint& index : indices)
+		{
+			if (remap[index] == NONE)
+			{
+				remap[index] = static_cast<GLuint>(ordered.size());
+				ordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		vertices.swap(ordered);
+	}
+
+	// Simulates a first in first out cache of cacheSize vertices, like the post-transform cache of the GPU
+	static Statistics AnalyzeVertexCache(const std::vector<GLuint>& indices, size_t vertexCount, size_t cacheSize = CACHE_SIZE)
+	{
+		std::vector<size_t> timestamps(vertexCount, 0);
+		std::vector<bool> used(vertexCount, false);
+		size_t time = cacheSize + 1;
+		size_t misses = 0;
+		size_t usedCount = 0;
+		for (GLuint index : indices)
+		{
+			if (time - timestamps[index] > cacheSize)
+			{
+				timestamps[index] = time++;
+				misses++;
+			}
+			if (!used[index])
+			{
+				used[index] = true;
+				usedCount++;
+			}
+		}
+
+		Statistics statistics;
+		statistics.triangles = indices.size() / 3;
+		statistics.vertices = usedCount;
+		statistics.acmr = statistics.triangles > 0 ? static_cast<double>(misses) / statistics.triangles : 0.0;
+		statistics.atvr = usedCount > 0 ? static_cast<double>(misses) / usedCount : 0.0;
+		return statistics;
+	}
+
+	static void PrintStatistics(const std::string& name, const Statistics& statistics)
+	{
+		std::cout << "MESH::OPTIMIZE " << name << ": " << statistics.triangles << " triangles, " << statistics.vertices << " vertices, ACMR "
+			<< statistics.acmr << ", ATVR " << statistics.atvr << std::endl;
+	}
+
+private:
+	static const GLuint NONE = 0xFFFFFFFF;
+
+	// The most recent vertex with triangles left, or else the first one in the buffer, NONE when every triangle is emitted
+	static GLuint SkipDeadEnd(std::vector<GLuint>& deadEnds, const std::vector<GLuint>& liveTriangles, size_t& cursor)
+	{
+		while (!deadEnds.empty())
+		{
+			const GLuint vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[vertex] > 0)
+			{
+				return vertex;
+			}
+		}
+		for (; cursor < liveTriangles.size(); ++cursor)
+		{
+			if (liveTriangles[cursor] > 0)
+			{
+				return static_cast<GLuint>(cursor);
+			}
+		}
+		return NONE;
+	}
+};
+
+#endif
@@ -2,153 +2,1243 @@
 #define SHADER_H
 
 #include <string>
-#include <fstream>
-#include <sstream>
 #include <iostream>
+#include <vector>
+#include <cstring>
+#include <memory>
+#include <chrono>
+#include <algorithm>
 
 #define GLEW_STATIC
 #include <GL/glew.h>
 
+#include "ShaderCache.h"
+#include "ShaderSource.h"
+#include "ShaderPreprocessor.h"
+#include "ShaderWatcher.h"
+#include "ShaderReflection.h"
+#include "ShaderArchive.h"
+#include "MemoryBarriers.h"
+#include "ShaderDiagnostics.h"
+#include "GLStateCache.h"
+
+// SHADER
+// A Shader owns its program object: the program is deleted when the Shader is destroyed, so it must be destroyed
+// while the OpenGL context still exists. A Shader can be moved but not copied, a copy would delete the same program twice.
+// To share one program between several parts of the application, ask ShaderRegistry for it instead of creating a Shader,
+// the registry builds every combination of sources and defines only once.
 class Shader
 {
 public:
-	GLuint shaderProgram;
+	// Allows the driver to compile and link shaders on its own background threads.
+	// Call this once after GLEW has been initialized. Without GL_KHR_parallel_shader_compile (or the ARB version)
+	// the asynchronous mode below still defers the status checks, but the driver may do the work on the main thread.
+	static void EnableParallelCompile()
+	{
+		// 0xFFFFFFFF lets the driver pick the number of threads
+		if (GLEW_KHR_parallel_shader_compile)
+		{
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		}
+		else if (GLEW_ARB_parallel_shader_compile)
+		{
+			glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		}
+	}
 	
 	// Constructor generates the shader on the fly
-	Shader(const GLchar* vertexPath, const GLchar* fragmentPath)
+	// If async is true, the shaders are only submitted to the driver here. Asking for the compile or link status
+	// forces the driver to finish the work, so those checks are delayed until IsReady() reports the program is done.
+	// This way many programs can be compiling at the same time while the application keeps starting up.
+	Shader(const GLchar* vertexPath, const GLchar* fragmentPath, bool async = false)
+		: Shader(vertexPath, fragmentPath, std::vector<std::string>(), async)
 	{
-		//Retrieve the vertex/fragment source code from filePath
-		std::string vertexCode;
-		std::string fragmentCode;
-		std::ifstream vShaderFile;
-		std::ifstream fShaderFile;
-		// ensures ifstream objects can throw exceptions:
-		vShaderFile.exceptions(std::ifstream::badbit);
-		fShaderFile.exceptions(std::ifstream::badbit);
-		try
-		{
-			// Open files
-			vShaderFile.open(vertexPath);
-			fShaderFile.open(fragmentPath);
-			std::stringstream vShaderStream, fShaderStream;
-			// Read file's buffer contents into streams
-			vShaderStream << vShaderFile.rdbuf();
-			fShaderStream << fShaderFile.rdbuf();
-			// close file handlers
-			vShaderFile.close();
-			fShaderFile.close();
-			// Convert stream into string
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
-		}
-		catch (std::ifstream::failure e)
-		{
-			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-		}
-		// Covert the strings into C strings
-		const GLchar* vertexShaderCode = vertexCode.c_str();
-		const GLchar* fragmentShaderCode = fragmentCode.c_str();
-		
-		//Compile shaders
-		// Create variables for the shader objects
-		GLuint vertexShader, fragmentShader;
-		// Create two variables check the status of the compilation of the shaders
-		// These variables will be reused while checking states of all different shaders and linking
-		GLint success;
-		GLchar infoLog[512];
-		
-		// Vertex Shader
-
-		// Create an empty shader object, providing what type of shader we will be compiling
-		vertexShader = glCreateShader(GL_VERTEX_SHADER);
-		// Set the source code in the shader (in our case vertexShader, the object created above)
-		// to the source code in the array of the strings (in our case vertexShaderSource)
-		// The second parameter is count, which is the count for the number of string in the array (in our case, 1).
-		// The next parameter is the reference to the actual source code string (in our case vertexShaderSource)
-		// The last parameter is the length of the string of the source code. If the value of the length is NULL,
+	}
+
+	// PERMUTATIONS
+	// Creates a variant of the shader with the given preprocessor defines, for example { "FOG", "LIGHT_COUNT 4" }.
+	// Every define is inserted as "#define FOG" right after the #version line of both files,
+	// so one source file can be compiled with different features turned on and off using #ifdef.
+	// Every combination of defines is a separate program, with its own entry in the program binary cache.
+	Shader(const GLchar* vertexPath, const GLchar* fragmentPath, const std::vector<std::string>& defines, bool async = false)
+		: linked(false)
+	{
+		// Remember where the sources came from, so they can be watched for changes
+		this->stages = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+		this->paths = { vertexPath, fragmentPath };
+		this->defines = defines;
+		LoadFiles(async);
+	}
+
+	// COMPUTE SHADERS
+	// Creates a program with a single stage, a compute shader (GL_COMPUTE_SHADER, OpenGL 4.3 or GL_ARB_compute_shader):
+	//		Shader particles(GL_COMPUTE_SHADER, "particles.comp");
+	// A compute shader does not draw anything, it runs a number of work groups (Dispatch) which read and write buffers and images.
+	// Defines, the program binary cache, hot reload and the uniform functions work the same as for the other shaders.
+	Shader(GLenum stage, const GLchar* path, const std::vector<std::string>& defines = std::vector<std::string>(), bool async = false)
+		: linked(false)
+	{
+		this->stages = { stage };
+		this->paths = { path };
+		this->defines = defines;
+		LoadFiles(async);
+	}
+
+	// ARCHIVE
+	// Creates the shader from an archive baked by the ShaderBake tool, see ShaderArchive.h. Nothing is read from the files:
+	// if the archive holds a program binary made by this driver the program is ready right away, together with its reflection tables,
+	// otherwise the preprocessed sources stored in the archive are compiled.
+	// Permutations missing from the archive (or a closed archive) are read from the files as usual.
+	Shader(const ShaderArchive& archive, const GLchar* vertexPath, const GLchar* fragmentPath, const std::vector<std::string>& defines, bool async = false)
+		: linked(false)
+	{
+		this->stages = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+		this->paths = { vertexPath, fragmentPath };
+		this->defines = defines;
+
+		const ShaderArchive::Entry* entry = archive.Find(vertexPath, fragmentPath, defines);
+		if (entry == nullptr)
+		{
+			if (archive.IsOpen())
+			{
+				std::cout << "SHADER::ARCHIVE::ENTRY_NOT_FOUND " << vertexPath << " " << fragmentPath << ", reading the files" << std::endl;
+			}
+			LoadFiles(async);
+			return;
+		}
+
+		// The included files are not known without preprocessing, hot reload starts with the two main files
+		this->dependencies = this->paths;
+		this->build.submitTime = std::chrono::high_resolution_clock::now();
+
+		if (entry->binaryLength > 0 && archive.GetDriver() == ShaderCache::DriverHash())
+		{
+			// The binary is handed to the driver straight from the mapped file
+			this->build.program = glCreateProgram();
+			glProgramBinary(this->build.program, entry->binaryFormat, archive.GetData(entry->binaryOffset), entry->binaryLength);
+			GLint success;
+			glGetProgramiv(this->build.program, GL_LINK_STATUS, &success);
+			if (success && this->reflection.Read(archive.GetData(entry->reflectionOffset), entry->reflectionLength))
+			{
+				this->build.linked = true;
+				this->build.cacheStatus = ShaderCache::HIT;
+				this->build.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - this->build.submitTime).count();
+				ShaderDiagnostics::Global().Add({ GetName(), entry->definesLength > 0 ? std::string(archive.GetData(entry->definesOffset), entry->definesLength) : std::string(),
+					"ARCHIVE", this->build.milliseconds * 1000.0, true, std::string() });
+				this->shaderProgram = this->build.program;
+				this->cacheStatus = this->build.cacheStatus;
+				this->linked = true;
+				LoadUniforms();
+				return;
+			}
+			// The driver rejected the binary, compile the sources instead
+			glDeleteProgram(this->build.program);
+			this->build = Build();
+		}
+
+		// The sources are compiled straight from the mapped file as well
+		const ShaderCode vertexCode = { vertexPath, archive.GetData(entry->vertexOffset), entry->vertexLength, entry->vertexHash };
+		const ShaderCode fragmentCode = { fragmentPath, archive.GetData(entry->fragmentOffset), entry->fragmentLength, entry->fragmentHash };
+		Submit(this->build, this->stages, { vertexCode, fragmentCode }, this->defines);
+		Start(async);
+	}
+
+	// EMBEDDED SOURCES
+	// Creates the shader from sources compiled into the program, see EmbeddedShaders.h:
+	//		Shader shader(EmbeddedShaders::core_vs, EmbeddedShaders::core_frag, std::vector<std::string>());
+	// The program does not depend on the working directory, and no file is opened or hashed.
+	// Debug builds still read the files when they exist, so hot reload keeps working while the shaders are being edited.
+	Shader(const ShaderCode& vertexCode, const ShaderCode& fragmentCode, const std::vector<std::string>& defines, bool async = false)
+		: linked(false)
+	{
+		this->stages = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+		this->paths = { vertexCode.path, fragmentCode.path };
+		this->defines = defines;
+#ifdef _DEBUG
+		if (ShaderSource::Exists(vertexCode.path) && ShaderSource::Exists(fragmentCode.path))
+		{
+			LoadFiles(async);
+			return;
+		}
+#endif
+		this->dependencies = this->paths;
+		Submit(this->build, this->stages, { vertexCode, fragmentCode }, this->defines);
+		Start(async);
+	}
+
+	// Same as above for a program with a single stage, a compute shader:
+	//		Shader particles(GL_COMPUTE_SHADER, particlesCode);
+	Shader(GLenum stage, const ShaderCode& code, const std::vector<std::string>& defines = std::vector<std::string>(), bool async = false)
+		: linked(false)
+	{
+		this->stages = { stage };
+		this->paths = { code.path };
+		this->defines = defines;
+#ifdef _DEBUG
+		if (ShaderSource::Exists(code.path))
+		{
+			LoadFiles(async);
+			return;
+		}
+#endif
+		this->dependencies = this->paths;
+		Submit(this->build, this->stages, { code }, this->defines);
+		Start(async);
+	}
+
+	~Shader()
+	{
+		// The current program is the program of the build, see Start and Update
+		Discard(this->reload);
+		Discard(this->build);
+	}
+
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
+
+	// The moved-from Shader is left without a program, it can only be destroyed or assigned to
+	Shader(Shader&& other)
+		: shaderProgram(0), linked(false)
+	{
+		*this = std::move(other);
+	}
+
+	Shader& operator=(Shader&& other)
+	{
+		if (this != &other)
+		{
+			Discard(this->reload);
+			Discard(this->build);
+			this->shaderProgram = other.shaderProgram;
+			this->cacheStatus = other.cacheStatus;
+			this->reflection = std::move(other.reflection);
+			this->uniforms = std::move(other.uniforms);
+			this->uniformValues = std::move(other.uniformValues);
+			this->blockBindings = std::move(other.blockBindings);
+			std::copy(other.workGroupSize, other.workGroupSize + 3, this->workGroupSize);
+			this->build = std::move(other.build);
+			this->reload = std::move(other.reload);
+			this->linked = other.linked;
+			this->stages = std::move(other.stages);
+			this->paths = std::move(other.paths);
+			this->defines = std::move(other.defines);
+			this->dependencies = std::move(other.dependencies);
+			this->reloadDependencies = std::move(other.reloadDependencies);
+			this->watcher = std::move(other.watcher);
+
+			other.shaderProgram = 0;
+			other.build = Build();
+			other.reload = Build();
+			other.linked = false;
+		}
+		return *this;
+	}
+
+	// The program object, 0 after the Shader has been moved from
+	GLuint GetProgram() const
+	{
+		return this->shaderProgram;
+	}
+
+	// Whether the program was loaded from the program binary cache or had to be compiled
+	ShaderCache::Result GetCacheStatus() const
+	{
+		return this->cacheStatus;
+	}
+
+	// The key of a program in the program binary cache, built from everything that affects the compiled result:
+	// the source code of every stage and the defines.
+	// The sources come with their hashes, so only the (short) defines are hashed here.
+	// The driver is checked separately by the cache, so a driver update invalidates the entry instead of creating a new one.
+	static uint64_t GetCacheKey(const std::vector<ShaderCode>& codes, const std::vector<std::string>& defines)
+	{
+		uint64_t key = ShaderCache::Hash(nullptr, 0);	// The starting value of the hash
+		for (const ShaderCode& code : codes)
+		{
+			key = ShaderCache::Hash(&code.hash, sizeof(code.hash), key);
+		}
+		return ShaderCache::Hash(GetDefineCode(defines), key);
+	}
+
+	// The lines inserted after the #version line, one #define for every define of a permutation
+	static std::string GetDefineCode(const std::vector<std::string>& defines)
+	{
+		std::string defineCode;
+		for (const std::string& define : defines)
+		{
+			defineCode += "#define " + define + "\n";
+		}
+		return defineCode;
+	}
+
+	// Returns true once the program has finished compiling and linking successfully and can be used for drawing.
+	// In the asynchronous mode this does not block: while the driver is still working it returns false,
+	// so the render loop can skip the draws that use this shader (or draw them with a fallback shader) until it is ready.
+	// Without GL_KHR_parallel_shader_compile the driver cannot be asked whether it is done without waiting for it,
+	// so the first call only returns false and gives the driver until the next call (usually the next frame), which waits.
+	bool IsReady()
+	{
+		if (!this->linked && Poll(this->build) && this->build.linked)
+		{
+			this->linked = true;
+			LoadInterface();
+		}
+		return this->linked;
+	}
+
+	// Returns true while the program has been submitted but its result has not been checked yet
+	bool IsPending() const
+	{
+		return this->build.pending;
+	}
+
+	// The defines this variant was compiled with
+	const std::vector<std::string>& GetDefines() const
+	{
+		return this->defines;
+	}
+
+	// Every file this shader was built from, a change to any of them affects this shader
+	const std::vector<std::string>& GetDependencies() const
+	{
+		return this->dependencies;
+	}
+
+	// How long it took from submitting the program to knowing it linked (or to loading it from the program binary cache)
+	double GetCompileMilliseconds() const
+	{
+		return this->build.milliseconds;
+	}
+
+	// HOT RELOAD
+	// Starts watching the files of this shader, and every file they include. When one of them changes on disk,
+	// the new sources are compiled in the background and replace the current program once they link successfully.
+	// If the new sources have errors, they are printed and the current program keeps running.
+	void EnableHotReload()
+	{
+		std::vector<std::string> stagePaths = this->paths;
+		// Runs on the watcher thread: forget the old file contents, expand the files again and watch their new dependencies.
+		// Files which did not change give the same expansions as before without doing the work again.
+		auto load = [stagePaths](std::vector<std::string>& paths)
+		{
+			ShaderPreprocessor& preprocessor = ShaderPreprocessor::Global();
+			preprocessor.Invalidate(paths);
+			paths.clear();
+			std::vector<ShaderWatcher::Source> sources;
+			for (const std::string& stagePath : stagePaths)
+			{
+				std::shared_ptr<const ShaderPreprocessor::Expansion> source = preprocessor.Expand(stagePath);
+				for (const std::string& file : source->files)
+				{
+					if (std::find(paths.begin(), paths.end(), file) == paths.end())
+					{
+						paths.push_back(file);
+					}
+				}
+				sources.push_back(ShaderWatcher::Source{ source->code, source->hash });
+			}
+			return sources;
+		};
+		this->watcher.reset(new ShaderWatcher(this->dependencies, load));
+	}
+
+	// Call once per frame at a point where no draw is using the shader, for example at the start of the frame.
+	// While the files do not change this only reads an atomic flag.
+	// A reload which gives uniform values to the new program leaves that program in use.
+	void Update()
+	{
+		if (this->watcher && this->watcher->HasChanges())
+		{
+			// The hashes come from the watcher thread, and so do the files the new sources include
+			const std::vector<ShaderWatcher::Source> sources = this->watcher->TakeSources(this->reloadDependencies);
+			// A newer edit replaces a reload that is still compiling
+			Discard(this->reload);
+			std::vector<ShaderCode> codes;
+			for (size_t i = 0; i < sources.size(); ++i)
+			{
+				codes.push_back(ShaderCode{ this->paths[i].c_str(), sources[i].code->data(), sources[i].code->size(), sources[i].hash });
+			}
+			Submit(this->reload, this->stages, codes, this->defines);
+		}
+
+		if (this->reload.program != 0 && Poll(this->reload))
+		{
+			if (this->reload.linked)
+			{
+				// Swap the new program in, the old one is no longer needed (nor its shaders, if it was still pending).
+				// The uniforms the new program still has, with the same type, keep the values set on the old one, see LoadUniforms.
+				Discard(this->build);
+				this->build = this->reload;
+				this->dependencies = this->reloadDependencies;
+				this->shaderProgram = this->build.program;
+				this->cacheStatus = this->build.cacheStatus;
+				this->linked = true;
+				LoadInterface();
+				std::cout << "SHADER::RELOADED " << GetName() << std::endl;
+			}
+			else
+			{
+				std::cout << "ERROR::SHADER::RELOAD_FAILED, keeping the previous program" << std::endl;
+				glDeleteProgram(this->reload.program);
+			}
+			this->reload = Build();
+		}
+	}
+
+	// Uses the current shader
+	void Use()
+	{
+		// Install the program object specified, as a part of the current rendering state. In our case shaderProgram
+		// The program object has different executables previously attached to it using glAttachShader and glLinkProgram.
+		// The program object will run on the respective processor depending on the type of shader objects
+		// that have been compiled and linked to the program object
+		// In our case the shaderProgram has a vertex shader and a fragment shader attached,
+		// Meaning those will run on the vertex processor and the fragment processor respectively.
+		// The call goes through the state cache, so using the program already in use costs nothing.
+		GLStateCache::Global().UseProgram(this->shaderProgram);
+	}
+
+	// UNIFORMS
+	// Uniforms are global variables of a shader which keep their value until they are changed again.
+	// Looking up the location of a uniform by its name (glGetUniformLocation) is slow, so every active uniform
+	// is looked up once after linking and stored in a table. GetUniform returns the index of a uniform in that table,
+	// which should be stored and passed to the Set functions below instead of the name.
+	// Every Set function keeps a copy of the last value and only calls glUniform when the value actually changed.
+	// Every Set function only accepts uniforms of its GLSL type (SetInt also takes bools, samplers and images, SetIVec bool vectors),
+	// anything else would make glUniform fail, so it is rejected with an error instead.
+	// NOTE: like glUniform, the Set functions change the program that is currently in use, so call Use() first.
+
+	// Counts how many uniform uploads were sent to the driver and how many were skipped because the value did not change
+	struct UniformStatistics
+	{
+		unsigned int issued;
+		unsigned int elided;
+	};
+
+	// The counters are shared by all shaders, call ResetUniformStatistics() at the start of every frame
+	static UniformStatistics& GetUniformStatistics()
+	{
+		static UniformStatistics statistics = { 0, 0 };
+		return statistics;
+	}
+
+	static void ResetUniformStatistics()
+	{
+		GetUniformStatistics() = { 0, 0 };
+	}
+
+	// Returns the index of the uniform with the given name, or -1 if the program has no active uniform with that name
+	GLint GetUniform(const std::string& name) const
+	{
+		return GetUniform(ShaderReflection::Id(name.c_str()));
+	}
+
+	// Same as above using the id of the name, which can be computed at compile time: GetUniform(ShaderReflection::Id("color"))
+	GLint GetUniform(uint32_t id) const
+	{
+		for (size_t i = 0; i < this->uniforms.size(); ++i)
+		{
+			if (this->uniforms[i].id == id)
+			{
+				return static_cast<GLint>(i);
+			}
+		}
+		return -1;
+	}
+
+	// Everything the linked program uses: attributes, uniforms, uniform blocks and storage blocks
+	const ShaderReflection& GetReflection() const
+	{
+		return this->reflection;
+	}
+
+	void SetInt(GLint uniform, GLint value)
+	{
+		if (UpdateUniform(uniform, GL_INT, &value, sizeof(value)))
+		{
+			glUniform1i(this->uniforms[uniform].location, value);
+		}
+	}
+
+	void SetUInt(GLint uniform, GLuint value)
+	{
+		if (UpdateUniform(uniform, GL_UNSIGNED_INT, &value, sizeof(value)))
+		{
+			glUniform1ui(this->uniforms[uniform].location, value);
+		}
+	}
+
+	void SetIVec2(GLint uniform, GLint x, GLint y)
+	{
+		const GLint value[] = { x, y };
+		if (UpdateUniform(uniform, GL_INT_VEC2, value, sizeof(value)))
+		{
+			glUniform2iv(this->uniforms[uniform].location, 1, value);
+		}
+	}
+
+	void SetIVec3(GLint uniform, GLint x, GLint y, GLint z)
+	{
+		const GLint value[] = { x, y, z };
+		if (UpdateUniform(uniform, GL_INT_VEC3, value, sizeof(value)))
+		{
+			glUniform3iv(this->uniforms[uniform].location, 1, value);
+		}
+	}
+
+	void SetIVec4(GLint uniform, GLint x, GLint y, GLint z, GLint w)
+	{
+		const GLint value[] = { x, y, z, w };
+		if (UpdateUniform(uniform, GL_INT_VEC4, value, sizeof(value)))
+		{
+			glUniform4iv(this->uniforms[uniform].location, 1, value);
+		}
+	}
+
+	void SetUVec2(GLint uniform, GLuint x, GLuint y)
+	{
+		const GLuint value[] = { x, y };
+		if (UpdateUniform(uniform, GL_UNSIGNED_INT_VEC2, value, sizeof(value)))
+		{
+			glUniform2uiv(this->uniforms[uniform].location, 1, value);
+		}
+	}
+
+	void SetUVec3(GLint uniform, GLuint x, GLuint y, GLuint z)
+	{
+		const GLuint value[] = { x, y, z };
+		if (UpdateUniform(uniform, GL_UNSIGNED_INT_VEC3, value, sizeof(value)))
+		{
+			glUniform3uiv(this->uniforms[uniform].location, 1, value);
+		}
+	}
+
+	void SetUVec4(GLint uniform, GLuint x, GLuint y, GLuint z, GLuint w)
+	{
+		const GLuint value[] = { x, y, z, w };
+		if (UpdateUniform(uniform, GL_UNSIGNED_INT_VEC4, value, sizeof(value)))
+		{
+			glUniform4uiv(this->uniforms[uniform].location, 1, value);
+		}
+	}
+
+	void SetFloat(GLint uniform, GLfloat value)
+	{
+		if (UpdateUniform(uniform, GL_FLOAT, &value, sizeof(value)))
+		{
+			glUniform1f(this->uniforms[uniform].location, value);
+		}
+	}
+
+	void SetVec2(GLint uniform, GLfloat x, GLfloat y)
+	{
+		const GLfloat value[] = { x, y };
+		if (UpdateUniform(uniform, GL_FLOAT_VEC2, value, sizeof(value)))
+		{
+			glUniform2fv(this->uniforms[uniform].location, 1, value);
+		}
+	}
+
+	void SetVec3(GLint uniform, GLfloat x, GLfloat y, GLfloat z)
+	{
+		const GLfloat value[] = { x, y, z };
+		if (UpdateUniform(uniform, GL_FLOAT_VEC3, value, sizeof(value)))
+		{
+			glUniform3fv(this->uniforms[uniform].location, 1, value);
+		}
+	}
+
+	void SetVec4(GLint uniform, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+	{
+		const GLfloat value[] = { x, y, z, w };
+		if (UpdateUniform(uniform, GL_FLOAT_VEC4, value, sizeof(value)))
+		{
+			glUniform4fv(this->uniforms[uniform].location, 1, value);
+		}
+	}
+
+	// The matrix is given as 9 floats in column major order, the order OpenGL expects
+	void SetMat3(GLint uniform, const GLfloat* value)
+	{
+		if (UpdateUniform(uniform, GL_FLOAT_MAT3, value, 9 * sizeof(GLfloat)))
+		{
+			glUniformMatrix3fv(this->uniforms[uniform].location, 1, GL_FALSE, value);
+		}
+	}
+
+	// The matrix is given as 16 floats in column major order, the order OpenGL expects
+	void SetMat4(GLint uniform, const GLfloat* value)
+	{
+		if (UpdateUniform(uniform, GL_FLOAT_MAT4, value, 16 * sizeof(GLfloat)))
+		{
+			glUniformMatrix4fv(this->uniforms[uniform].location, 1, GL_FALSE, value);
+		}
+	}
+
+	// Connects a uniform block of the program to a binding point, the buffer attached to that binding point
+	// (glBindBufferRange, see UniformRing) provides the data of the block.
+	// The binding is remembered and given again to the new program after a reload.
+	// Returns false if the program has no uniform block with that name.
+	bool BindUniformBlock(uint32_t id, GLuint binding)
+	{
+		for (BlockBinding& blockBinding : this->blockBindings)
+		{
+			if (blockBinding.id == id && !blockBinding.storage)
+			{
+				blockBinding.binding = binding;
+				return ApplyBlockBinding(blockBinding);
+			}
+		}
+		this->blockBindings.push_back(BlockBinding{ id, binding, false });
+		return ApplyBlockBinding(this->blockBindings.back());
+	}
+
+	// Same as BindUniformBlock for a shader storage block, the buffer attached with glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, ...)
+	// is the one the shader reads and writes
+	bool BindStorageBlock(uint32_t id, GLuint binding)
+	{
+		for (BlockBinding& blockBinding : this->blockBindings)
+		{
+			if (blockBinding.id == id && blockBinding.storage)
+			{
+				blockBinding.binding = binding;
+				return ApplyBlockBinding(blockBinding);
+			}
+		}
+		this->blockBindings.push_back(BlockBinding{ id, binding, true });
+		return ApplyBlockBinding(this->blockBindings.back());
+	}
+
+	// The size of a work group of a compute shader, as declared in the shader with
+	//		layout (local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+	// All three are 0 for shaders without a compute stage
+	const GLint* GetWorkGroupSize() const
+	{
+		return this->workGroupSize;
+	}
+
+	// Runs the compute shader for the given number of work groups in each dimension, the shader has to be in use (Use()).
+	// The memory barriers needed by the resources declared with MemoryBarrierTracker::Use are issued first,
+	// call MemoryBarrierTracker::Write for the resources the shader writes after the dispatch.
+	void Dispatch(GLuint groupsX, GLuint groupsY = 1, GLuint groupsZ = 1)
+	{
+		MemoryBarrierTracker::Global().Apply();
+		glDispatchCompute(groupsX, groupsY, groupsZ);
+	}
+
+	// Runs the compute shader for at least the given number of invocations in each dimension,
+	// rounding up to whole work groups. The shader has to check for the invocations past the end itself.
+	void DispatchInvocations(GLuint countX, GLuint countY = 1, GLuint countZ = 1)
+	{
+		const GLuint counts[] = { countX, countY, countZ };
+		GLuint groups[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			const GLuint size = this->workGroupSize[i] > 0 ? static_cast<GLuint>(this->workGroupSize[i]) : 1;
+			groups[i] = (counts[i] + size - 1) / size;
+		}
+		Dispatch(groups[0], groups[1], groups[2]);
+	}
+
+	// Sets the source code of a shader object, inserting the defines and the file number right after the #version line.
+	// The source is not copied: glShaderSource accepts an array of strings which are joined together by the driver,
+	// so we pass three pieces: the file up to the end of its #version line, the defines, and the rest of the file.
+	static void SetShaderSource(GLuint shader, const ShaderCode& code, const std::string& defineCode)
+	{
+		// Find the end of the #version line, #version has to come before anything else except comments
+		const char* begin = code.code;
+		const char* end = code.code + code.length;
+		size_t split = 0;
+		const char* versionName = "#version";
+		const char* version = std::search(begin, end, versionName, versionName + 8);
+		if (version != end)
+		{
+			split = std::find(version, end, '\n') - begin;
+			split = split == code.length ? code.length : split + 1;
+		}
+
+		// "#line N F" tells the compiler the next line is line N of file F (see ShaderPreprocessor::GetFileNumber),
+		// so the line numbers in the error messages still match the file even though we inserted lines
+		const int line = static_cast<int>(std::count(begin, begin + split, '\n')) + 1;
+		const int number = code.path != nullptr ? ShaderPreprocessor::GetFileNumber(code.path) : 0;
+		const std::string header = defineCode + "#line " + std::to_string(line) + " " + std::to_string(number) + "\n";
+
+		// The array of the strings, and the length of each one.
+		// Passing the lengths means the strings do not have to be copied or searched for a terminating null character.
+		const GLchar* strings[] = { begin, header.data(), begin + split };
+		const GLint lengths[] = { static_cast<GLint>(split), static_cast<GLint>(header.size()), static_cast<GLint>(code.length - split) };
+
+		// The first parameter is the shader object
+		// The second parameter is count, which is the count for the number of string in the array (in our case, 3).
+		// The next parameter is the reference to the array of strings
+		// The last parameter is the length of each string of the source code. If the value of the length is NULL,
 		// the program assumes that the string will end with a null character, if the value is anything other than NULL,
 		// it points to an array containing a string length for each of the corresponding elements of the string.
-		glShaderSource(vertexShader, 1, &vertexShaderCode, NULL);
-		// Compiles the source code that has been stored in the shader object which is passed as the parameter
-		glCompileShader(vertexShader);
-		
-		// Returns the status of the of the parameter for the specified object file
-		// First parameter is the shader object which is to be queried
-		// Second object is object parameter we want to check for. Some of the examples are GL_SHADER_TYPE, GL_COMPILE_STATUS etc.
-		// Third parameter is the where the return value for the query has been stored
-		// In our case we will be checking the parameter GL_COMPILE_STATUS, which checks whether the vertex shader compilation
-		// was successful or not
-		glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-
-		// Check if the compilation was successful or not
-		if (!success)
+		glShaderSource(shader, 3, strings, lengths);
+	}
+
+private:
+	// The pipeline cache builds separable stages with the same diagnostics, see GetStageName
+	friend class ShaderPipelineCache;
+
+	GLuint shaderProgram;
+	ShaderCache::Result cacheStatus;
+
+	// An entry of the uniform table
+	struct Uniform
+	{
+		// The hash of the name, see ShaderReflection::Id
+		uint32_t id;
+		// The location used by glUniform
+		GLint location;
+		// The GLSL type, for example GL_FLOAT_VEC3
+		GLenum type;
+		// Where the last value set is stored in uniformValues, and how many bytes it uses
+		size_t offset;
+		size_t size;
+		// False until a value has been set, the first Set is always sent to the driver
+		bool initialized;
+	};
+
+	// The interface of the linked program
+	ShaderReflection reflection;
+	// The uniform table, and a copy of the last value of every uniform
+	std::vector<Uniform> uniforms;
+	std::vector<unsigned char> uniformValues;
+
+	// The binding point chosen for a uniform block or a shader storage block
+	struct BlockBinding
+	{
+		uint32_t id;
+		GLuint binding;
+		bool storage;
+	};
+	std::vector<BlockBinding> blockBindings;
+
+	// The work group size of a compute shader
+	GLint workGroupSize[3] = { 0, 0, 0 };
+
+	bool ApplyBlockBinding(const BlockBinding& blockBinding) const
+	{
+		if (blockBinding.storage)
 		{
-			// If compilation had failed,
-			// get the information log using the function glGetShaderInfoLog of the required shader object
-			// The first parameter is the shader object whose information log we want,
-			// the second parameter is the size of the buffer for storing the info log
-			// the third parameter is the length of the string of returned (if not terminated by null charater)
-			// the fourth parater is the char array where the infolog will be stored
-			glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-		}
-
-		// Fragment Shader
-
-		// Follow the same steps for the fragment shader as we did for the vertex shader above.
-		// Changing the shader objects and parameters to point to fragment shader instead of the vertex shader
-		fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragmentShader, 1, &fragmentShaderCode, NULL);
-		glCompileShader(fragmentShader);
-		// Print compile errors if any
-		glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-		if (!success)
+			const ShaderReflection::Resource* block = this->reflection.FindStorageBlock(blockBinding.id);
+			if (block != nullptr)
+			{
+				glShaderStorageBlockBinding(this->shaderProgram, block->location, blockBinding.binding);
+			}
+			return block != nullptr;
+		}
+		const ShaderReflection::Resource* block = this->reflection.FindUniformBlock(blockBinding.id);
+		if (block == nullptr)
+		{
+			return false;
+		}
+		glUniformBlockBinding(this->shaderProgram, block->location, blockBinding.binding);
+		return true;
+	}
+
+	// Returns how many bytes the value of a uniform of the given type uses, 0 for types the Set functions do not support
+	static size_t GetUniformSize(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_FLOAT: case GL_INT: case GL_UNSIGNED_INT: case GL_BOOL:
+			return 4;
+		case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: case GL_BOOL_VEC2:
+			return 8;
+		case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: case GL_BOOL_VEC3:
+			return 12;
+		case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: case GL_BOOL_VEC4: case GL_FLOAT_MAT2:
+			return 16;
+		case GL_FLOAT_MAT3:
+			return 36;
+		case GL_FLOAT_MAT4:
+			return 64;
+		default:
+			return IsOpaqueType(type) ? 4 : 0;
+		}
+	}
+
+	// Reads the interface of the program after it has been linked, and builds the uniform table from it
+	void LoadInterface()
+	{
+		this->reflection.Load(this->shaderProgram);
+		LoadUniforms();
+
+		// Asking a program without a compute stage for its work group size is an error
+		if (this->stages.size() == 1 && this->stages[0] == GL_COMPUTE_SHADER)
+		{
+			glGetProgramiv(this->shaderProgram, GL_COMPUTE_WORK_GROUP_SIZE, this->workGroupSize);
+		}
+	}
+
+	// Builds the uniform table from the reflection tables.
+	// After a hot reload the table still describes the previous program: the values set on it are given to the new program
+	// for every uniform with the same name and type, so samplers and constants set once do not go back to 0.
+	void LoadUniforms()
+	{
+		std::vector<Uniform> previousUniforms;
+		std::vector<unsigned char> previousValues;
+		previousUniforms.swap(this->uniforms);
+		previousValues.swap(this->uniformValues);
+		for (const ShaderReflection::Resource& resource : this->reflection.uniforms)
 		{
-			glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+			// Uniforms inside uniform blocks have no location, they are set through buffers instead
+			if (resource.location < 0)
+			{
+				continue;
+			}
+			Uniform uniform;
+			uniform.id = resource.id;
+			uniform.location = resource.location;
+			uniform.type = resource.type;
+			uniform.offset = this->uniformValues.size();
+			uniform.size = GetUniformSize(uniform.type);
+			uniform.initialized = false;
+			this->uniformValues.resize(uniform.offset + uniform.size);
+			this->uniforms.push_back(uniform);
 		}
 
-		// Shader Program, Linking the shaders
+		for (Uniform& uniform : this->uniforms)
+		{
+			for (const Uniform& previous : previousUniforms)
+			{
+				if (previous.id == uniform.id && previous.type == uniform.type && previous.initialized)
+				{
+					memcpy(this->uniformValues.data() + uniform.offset, previousValues.data() + previous.offset, uniform.size);
+					uniform.initialized = true;
+					// glUniform changes the program in use
+					Use();
+					SendUniform(uniform);
+					break;
+				}
+			}
+		}
+
+		for (const BlockBinding& blockBinding : this->blockBindings)
+		{
+			ApplyBlockBinding(blockBinding);
+		}
+	}
+
+	// True if a uniform of the given type can be set by the Set function of setType:
+	// glUniform1i also sets bools, samplers (the texture unit) and images (the image unit), glUniform2i... bool vectors
+	static bool IsSetCompatible(GLenum type, GLenum setType)
+	{
+		switch (setType)
+		{
+		case GL_INT: return type == GL_INT || type == GL_BOOL || IsOpaqueType(type);
+		case GL_INT_VEC2: return type == GL_INT_VEC2 || type == GL_BOOL_VEC2;
+		case GL_INT_VEC3: return type == GL_INT_VEC3 || type == GL_BOOL_VEC3;
+		case GL_INT_VEC4: return type == GL_INT_VEC4 || type == GL_BOOL_VEC4;
+		default: return type == setType;
+		}
+	}
+
+	// True for the samplers and images of every dimension and component type, their value is the unit they read from
+	static bool IsOpaqueType(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_1D_SHADOW: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_CUBE_SHADOW:
+		case GL_SAMPLER_1D_ARRAY: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_CUBE_MAP_ARRAY:
+		case GL_SAMPLER_1D_ARRAY_SHADOW: case GL_SAMPLER_2D_ARRAY_SHADOW: case GL_SAMPLER_CUBE_MAP_ARRAY_SHADOW:
+		case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+		case GL_SAMPLER_BUFFER: case GL_SAMPLER_2D_RECT: case GL_SAMPLER_2D_RECT_SHADOW:
+		case GL_INT_SAMPLER_1D: case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_3D: case GL_INT_SAMPLER_CUBE:
+		case GL_INT_SAMPLER_1D_ARRAY: case GL_INT_SAMPLER_2D_ARRAY: case GL_INT_SAMPLER_CUBE_MAP_ARRAY:
+		case GL_INT_SAMPLER_2D_MULTISAMPLE: case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+		case GL_INT_SAMPLER_BUFFER: case GL_INT_SAMPLER_2D_RECT:
+		case GL_UNSIGNED_INT_SAMPLER_1D: case GL_UNSIGNED_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_3D: case GL_UNSIGNED_INT_SAMPLER_CUBE:
+		case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_CUBE_MAP_ARRAY:
+		case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE: case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+		case GL_UNSIGNED_INT_SAMPLER_BUFFER: case GL_UNSIGNED_INT_SAMPLER_2D_RECT:
+		case GL_IMAGE_1D: case GL_IMAGE_2D: case GL_IMAGE_3D: case GL_IMAGE_CUBE: case GL_IMAGE_2D_RECT: case GL_IMAGE_BUFFER:
+		case GL_IMAGE_1D_ARRAY: case GL_IMAGE_2D_ARRAY: case GL_IMAGE_CUBE_MAP_ARRAY:
+		case GL_IMAGE_2D_MULTISAMPLE: case GL_IMAGE_2D_MULTISAMPLE_ARRAY:
+		case GL_INT_IMAGE_1D: case GL_INT_IMAGE_2D: case GL_INT_IMAGE_3D: case GL_INT_IMAGE_CUBE: case GL_INT_IMAGE_2D_RECT: case GL_INT_IMAGE_BUFFER:
+		case GL_INT_IMAGE_1D_ARRAY: case GL_INT_IMAGE_2D_ARRAY: case GL_INT_IMAGE_CUBE_MAP_ARRAY:
+		case GL_INT_IMAGE_2D_MULTISAMPLE: case GL_INT_IMAGE_2D_MULTISAMPLE_ARRAY:
+		case GL_UNSIGNED_INT_IMAGE_1D: case GL_UNSIGNED_INT_IMAGE_2D: case GL_UNSIGNED_INT_IMAGE_3D: case GL_UNSIGNED_INT_IMAGE_CUBE:
+		case GL_UNSIGNED_INT_IMAGE_2D_RECT: case GL_UNSIGNED_INT_IMAGE_BUFFER:
+		case GL_UNSIGNED_INT_IMAGE_1D_ARRAY: case GL_UNSIGNED_INT_IMAGE_2D_ARRAY: case GL_UNSIGNED_INT_IMAGE_CUBE_MAP_ARRAY:
+		case GL_UNSIGNED_INT_IMAGE_2D_MULTISAMPLE: case GL_UNSIGNED_INT_IMAGE_2D_MULTISAMPLE_ARRAY:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// Sends the stored value of a uniform to the program in use, with the glUniform function of its type
+	void SendUniform(const Uniform& uniform) const
+	{
+		const void* value = this->uniformValues.data() + uniform.offset;
+		const GLfloat* floats = static_cast<const GLfloat*>(value);
+		const GLint* ints = static_cast<const GLint*>(value);
+		const GLuint* uints = static_cast<const GLuint*>(value);
+		switch (uniform.type)
+		{
+		case GL_FLOAT: glUniform1fv(uniform.location, 1, floats); break;
+		case GL_FLOAT_VEC2: glUniform2fv(uniform.location, 1, floats); break;
+		case GL_FLOAT_VEC3: glUniform3fv(uniform.location, 1, floats); break;
+		case GL_FLOAT_VEC4: glUniform4fv(uniform.location, 1, floats); break;
+		case GL_FLOAT_MAT3: glUniformMatrix3fv(uniform.location, 1, GL_FALSE, floats); break;
+		case GL_FLOAT_MAT4: glUniformMatrix4fv(uniform.location, 1, GL_FALSE, floats); break;
+		case GL_UNSIGNED_INT: glUniform1uiv(uniform.location, 1, uints); break;
+		case GL_UNSIGNED_INT_VEC2: glUniform2uiv(uniform.location, 1, uints); break;
+		case GL_UNSIGNED_INT_VEC3: glUniform3uiv(uniform.location, 1, uints); break;
+		case GL_UNSIGNED_INT_VEC4: glUniform4uiv(uniform.location, 1, uints); break;
+		case GL_INT_VEC2: case GL_BOOL_VEC2: glUniform2iv(uniform.location, 1, ints); break;
+		case GL_INT_VEC3: case GL_BOOL_VEC3: glUniform3iv(uniform.location, 1, ints); break;
+		case GL_INT_VEC4: case GL_BOOL_VEC4: glUniform4iv(uniform.location, 1, ints); break;
+		default:
+			// The Set functions only set ints, bools, samplers and images besides the types above
+			glUniform1iv(uniform.location, 1, ints);
+			break;
+		}
+	}
+
+	// Compares the new value of a uniform with the last one set and stores it.
+	// setType is the type the calling Set function sends (GL_FLOAT_VEC3 for SetVec3...).
+	// Returns true if the value changed and has to be sent to the driver.
+	bool UpdateUniform(GLint uniform, GLenum setType, const void* value, size_t size)
+	{
+		if (uniform < 0 || uniform >= static_cast<GLint>(this->uniforms.size()))
+		{
+			return false;
+		}
+
+		Uniform& entry = this->uniforms[uniform];
+		if (!IsSetCompatible(entry.type, setType) || entry.size != size)
+		{
+			const ShaderReflection::Resource* resource = this->reflection.FindUniform(entry.id);
+			std::cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH " << (resource != nullptr ? this->reflection.GetName(*resource) : "")
+				<< " has the type 0x" << std::hex << entry.type << ", it was set as 0x" << setType << std::dec << std::endl;
+			return false;
+		}
+		unsigned char* current = this->uniformValues.data() + entry.offset;
+		if (entry.initialized && memcmp(current, value, size) == 0)
+		{
+			GetUniformStatistics().elided++;
+			return false;
+		}
+
+		memcpy(current, value, size);
+		entry.initialized = true;
+		GetUniformStatistics().issued++;
+		return true;
+	}
+
+	// Everything needed to compile a program in the background and check the result later
+	struct Build
+	{
+		GLuint program = 0;
+		// The shader objects waiting to be checked, one per stage, empty once they have been deleted
+		std::vector<GLuint> shaders;
+		// The key of this program in the program binary cache
+		uint64_t cacheKey = 0;
+		ShaderCache::Result cacheStatus = ShaderCache::DISABLED;
+		// True while the compile and link results have not been checked yet
+		bool pending = false;
+		// True once Poll has given the driver a call of time, see Poll
+		bool polled = false;
+		// True if the program linked successfully
+		bool linked = false;
+		// When the build was submitted, and how long it took until the result was known
+		std::chrono::high_resolution_clock::time_point submitTime;
+		double milliseconds = 0.0;
+		// For the diagnostics: the files of the stages and the defines, separated by ';'
+		std::vector<std::string> files;
+		std::string permutation;
+		// The time spent in glCompileShader for every stage and in glLinkProgram, Finish adds the time waiting for the results
+		std::vector<double> compileMicroseconds;
+		double linkMicroseconds = 0.0;
+	};
+
+	// The build of the current program, and of the new program while a hot reload is compiling
+	Build build, reload;
+	// True once the current program has been checked and linked successfully
+	bool linked;
+
+	// The stages of the program (vertex and fragment, or compute) and the files their sources were read from
+	std::vector<GLenum> stages;
+	std::vector<std::string> paths;
+	// The preprocessor defines inserted into every source
+	std::vector<std::string> defines;
+	// Every file the sources were built from: the files of the stages, and the files they include.
+	// The files of the reload being compiled replace them once it is swapped in.
+	std::vector<std::string> dependencies, reloadDependencies;
+	// The watcher looking at the files when hot reload is enabled
+	std::unique_ptr<ShaderWatcher> watcher;
+
+	// The files of the shader, for messages
+	std::string GetName() const
+	{
+		std::string name;
+		for (const std::string& path : this->paths)
+		{
+			name += (name.empty() ? "" : " ") + path;
+		}
+		return name;
+	}
+
+	// Reads and preprocesses the files of the stages, then starts building the program
+	void LoadFiles(bool async)
+	{
+		//Retrieve the vertex/fragment source code from filePath
+		// All the files are read at the same time, each one with a single read straight into its string,
+		// then the preprocessor replaces their #include lines with the included files
+		ShaderPreprocessor& preprocessor = ShaderPreprocessor::Global();
+		preprocessor.Preload(this->paths);
+
+		// The expansions own the code the ShaderCode entries point to, they are kept until the sources are submitted
+		std::vector<std::shared_ptr<const ShaderPreprocessor::Expansion>> sources;
+		std::vector<ShaderCode> codes;
+		this->dependencies.clear();
+		for (const std::string& path : this->paths)
+		{
+			sources.push_back(preprocessor.Expand(path));
+			codes.push_back(ShaderCode{ path.c_str(), sources.back()->code->data(), sources.back()->code->size(), sources.back()->hash });
+
+			// Every file the program was built from, including the included ones
+			for (const std::string& file : sources.back()->files)
+			{
+				if (std::find(this->dependencies.begin(), this->dependencies.end(), file) == this->dependencies.end())
+				{
+					this->dependencies.push_back(file);
+				}
+			}
+		}
+
+		Submit(this->build, this->stages, codes, this->defines);
+		Start(async);
+	}
+
+	// Takes the program of the submitted build
+	void Start(bool async)
+	{
+		this->shaderProgram = this->build.program;
+		this->cacheStatus = this->build.cacheStatus;
+
+		// In the blocking mode we check the result right away.
+		// A pending asynchronous build is left alone, it is checked by the first IsReady() call.
+		if (!async && this->build.pending)
+		{
+			Finish(this->build);
+		}
+		if (!this->build.pending)
+		{
+			IsReady();
+		}
+	}
+
+	static bool IsParallelCompileSupported()
+	{
+		return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+	}
+
+	// Creates the program object of the build and starts compiling and linking the given sources.
+	// Nothing here waits for the driver, the result is checked by Poll/Finish.
+	// stages and codes give the type and the source of every stage, for example GL_VERTEX_SHADER and GL_FRAGMENT_SHADER.
+	static void Submit(Build& build, const std::vector<GLenum>& stages, const std::vector<ShaderCode>& codes, const std::vector<std::string>& defines)
+	{
+		build.submitTime = std::chrono::high_resolution_clock::now();
+		for (const ShaderCode& code : codes)
+		{
+			build.files.push_back(code.path);
+		}
+		for (size_t i = 0; i < defines.size(); ++i)
+		{
+			build.permutation += (i > 0 ? ";" : "") + defines[i];
+		}
 
 		// Create a program object using the glCreateProgram
-		this->shaderProgram = glCreateProgram();
-		// Attach the shader objects (vertexShader & fragmentShader) to the program object (shaderProgram)
-		glAttachShader(this->shaderProgram, vertexShader);
-		glAttachShader(this->shaderProgram, fragmentShader);
+		build.program = glCreateProgram();
+
+		const std::string defineCode = GetDefineCode(defines);
+		build.cacheKey = GetCacheKey(codes, defines);
+
+		// Try to load the linked program straight from the cache, skipping compilation and linking entirely
+		build.cacheStatus = ShaderCache::Load(build.program, build.cacheKey);
+		if (build.cacheStatus == ShaderCache::HIT)
+		{
+			build.linked = true;
+			build.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - build.submitTime).count();
+			ShaderDiagnostics::Global().Add({ GetFileNames(build), build.permutation, "CACHE", build.milliseconds * 1000.0, true, std::string() });
+			return;
+		}
+		
+		//Compile shaders
+		// NOTE: The shader objects are stored in the build (shaders),
+		//		 so their status can be checked later by Finish()
+		// The same steps are followed for every stage, for example the vertex shader and then the fragment shader
+		for (size_t i = 0; i < stages.size(); ++i)
+		{
+			// Create an empty shader object, providing what type of shader we will be compiling
+			GLuint shader = glCreateShader(stages[i]);
+			// Set the source code in the shader (the object created above), see SetShaderSource above
+			SetShaderSource(shader, codes[i], defineCode);
+			// Compiles the source code that has been stored in the shader object which is passed as the parameter
+			// Drivers without background compilation do all the work in this call, so it is timed
+			const auto compileStart = std::chrono::high_resolution_clock::now();
+			glCompileShader(shader);
+			build.compileMicroseconds.push_back(std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - compileStart).count());
+
+			// Shader Program, Linking the shaders
+
+			// Attach the shader object (for example vertexShader & fragmentShader) to the program object (shaderProgram)
+			glAttachShader(build.program, shader);
+			build.shaders.push_back(shader);
+		}
+		// Tell the driver we want to read the linked program back, so it keeps the binary around after linking
+		if (build.cacheStatus != ShaderCache::DISABLED)
+		{
+			glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
 		// Links the program object
 		// If any shader objects are attached to the program object, they will be used to create an executable,
 		// which will be run on the respective programmable processor (vertex shader will run on the the vertex programmable processor)
-		glLinkProgram(this->shaderProgram);
+		// NOTE: Linking does not have to wait for the compilation to finish, the driver will chain the work together
+		const auto linkStart = std::chrono::high_resolution_clock::now();
+		glLinkProgram(build.program);
+		build.linkMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - linkStart).count();
+
+		build.pending = true;
+	}
+
+	// Returns true once the result of the build is known, without waiting for the driver when possible
+	static bool Poll(Build& build)
+	{
+		if (build.pending)
+		{
+			// GL_COMPLETION_STATUS_KHR can be queried without waiting for the driver
+			if (IsParallelCompileSupported())
+			{
+				GLint completed = GL_FALSE;
+				glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &completed);
+				if (!completed)
+				{
+					return false;
+				}
+			}
+			// Otherwise the status can only be read by waiting, so the first poll lets the driver work until the next one
+			else if (!build.polled)
+			{
+				build.polled = true;
+				return false;
+			}
+			Finish(build);
+		}
+		return true;
+	}
+
+	// Throws away a build and its program, used when a hot reload is replaced by a newer one and when the Shader is destroyed
+	static void Discard(Build& build)
+	{
+		for (GLuint shader : build.shaders)
+		{
+			glDeleteShader(shader);
+		}
+		glDeleteProgram(build.program);
+		GLStateCache::Global().Forget(GL_PROGRAM, build.program);
+		build = Build();
+	}
+
+	// Checks the compile and link status of the submitted shaders, prints the errors if any,
+	// and frees the shader objects. Querying the status waits for the driver if it has not finished yet.
+	// Every stage and the link are recorded in ShaderDiagnostics, with their timings and complete logs.
+	static void Finish(Build& build)
+	{
+		// Create a variable to check the status of the compilation of the shaders
+		// This variable will be reused while checking states of all different shaders and linking
+		GLint success;
+
+		// Print compile errors if any, for every stage
+		for (size_t i = 0; i < build.shaders.size(); ++i)
+		{
+			const GLuint shader = build.shaders[i];
+			// Returns the status of the of the parameter for the specified object file
+			// First parameter is the shader object which is to be queried
+			// Second object is object parameter we want to check for. Some of the examples are GL_SHADER_TYPE, GL_COMPILE_STATUS etc.
+			// Third parameter is the where the return value for the query has been stored
+			// In our case we will be checking the parameter GL_COMPILE_STATUS, which checks whether the compilation
+			// was successful or not. If the driver is still compiling, this waits for it, so the wait is timed as well.
+			const auto waitStart = std::chrono::high_resolution_clock::now();
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+			const double microseconds = build.compileMicroseconds[i]
+				+ std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - waitStart).count();
+
+			// The whole information log, warnings included, see ShaderDiagnostics::GetInfoLog
+			GLint type = 0;
+			glGetShaderiv(shader, GL_SHADER_TYPE, &type);
+			const std::string infoLog = ShaderDiagnostics::GetInfoLog(shader, false);
+
+			// Check if the compilation was successful or not
+			if (!success)
+			{
+				std::cout << "ERROR::SHADER::" << GetStageName(type) << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+				// The errors start with the number of the file, then the line, for example 48213:12(1)
+				std::cout << "Files: " << ShaderPreprocessor::Global().GetSourceNames() << std::endl;
+			}
+			ShaderDiagnostics::Global().Add({ build.files[i], build.permutation, GetStageName(type), microseconds, success != GL_FALSE, infoLog });
+		}
 
 		// Print linking errors if any
 		// Similar to gtGetShaderiv, glGetProgramiv checks whether the link of the program object was successful or not
 		// and stores the result in the return value parameter (in our case success, which is again being reused)
-		glGetProgramiv(this->shaderProgram, GL_LINK_STATUS, &success);
+		const auto waitStart = std::chrono::high_resolution_clock::now();
+		glGetProgramiv(build.program, GL_LINK_STATUS, &success);
+		const double linkMicroseconds = build.linkMicroseconds
+			+ std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - waitStart).count();
+		const std::string infoLog = ShaderDiagnostics::GetInfoLog(build.program, true);
 
 		// Check whether the linking was successful or not
 		if (!success)
 		{
-			// Similar to glGetShaderInfoLog, glGetProgramInfoLog provides the information about the program object,
-			// the parameters are the same as glGetShaderProgram passing in the program object instead of the shader object
-			// infoLog variable is reused here as well
-			glGetProgramInfoLog(this->shaderProgram, 512, NULL, infoLog);
 			std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
 		}
+		else if (build.cacheStatus != ShaderCache::DISABLED)
+		{
+			// Store the freshly linked program so the next run can skip compilation
+			ShaderCache::Save(build.program, build.cacheKey);
+		}
+		ShaderDiagnostics::Global().Add({ GetFileNames(build), build.permutation, "LINK", linkMicroseconds, success != GL_FALSE, infoLog });
+		build.linked = success != GL_FALSE;
+		build.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - build.submitTime).count();
+
 		// Delete the shaders as they're linked into our program now and no longer necessery
-		glDeleteShader(vertexShader);
-		glDeleteShader(fragmentShader);
+		for (GLuint shader : build.shaders)
+		{
+			glDeleteShader(shader);
+		}
+		build.shaders.clear();
+		build.pending = false;
+	}
 
+	// The files of a build separated by spaces, for the diagnostics
+	static std::string GetFileNames(const Build& build)
+	{
+		std::string names;
+		for (const std::string& file : build.files)
+		{
+			names += (names.empty() ? "" : " ") + file;
+		}
+		return names;
 	}
-	// Uses the current shader
-	void Use()
+
+	// The name of a stage in error messages
+	static const char* GetStageName(GLint stage)
 	{
-		// Install the program object specified, as a part of the current rendering state. In our case shaderProgram
-		// The program object has different executables previously attached to it using glAttachShader and glLinkProgram.
-		// The program object will run on the respective processor depending on the type of shader objects
-		// that have been compiled and linked to the program object
-		// In our case the shaderProgram has a vertex shader and a fragment shader attached,
-		// Meaning those will run on the vertex processor and the fragment processor respectively.
-		glUseProgram(this->shaderProgram);
+		switch (stage)
+		{
+		case GL_VERTEX_SHADER: return "VERTEX";
+		case GL_FRAGMENT_SHADER: return "FRAGMENT";
+		case GL_GEOMETRY_SHADER: return "GEOMETRY";
+		case GL_COMPUTE_SHADER: return "COMPUTE";
+		default: return "STAGE";
+		}
 	}
 };
 
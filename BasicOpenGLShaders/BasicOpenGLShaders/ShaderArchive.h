@@ -0,0 +1,346 @@
+#ifndef SHADER_ARCHIVE_H
+#define SHADER_ARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "ShaderCache.h"
+#include "ShaderReflection.h"
+
+// SHADER ARCHIVE
+// Loose shader files cost a file read and a compile for every shader on every run. The ShaderBake tool
+// (see the ShaderBake project) runs at build time instead: it preprocesses every permutation listed in a file,
+// compiles and links it to make sure it is valid, and writes everything into a single archive:
+//		- an index of the permutations, sorted by the hash of the files and defines
+//		- the preprocessed sources and their hashes
+//		- the reflection tables of the linked program
+//		- the program binary, if the driver supports them
+// At runtime the archive is memory mapped, so opening it is one system call and the data of a shader is only read
+// (paged in) when that shader is created. A Shader created from an archive entry never touches the filesystem.
+// The program binaries only work with the driver that baked them, for any other driver the stored sources are compiled.
+class ShaderArchive
+{
+public:
+	// An entry of the index. All the offsets are from the start of the file.
+	struct Entry
+	{
+		// The hash of the permutation, see PermutationHash
+		uint64_t key;
+		// The hashes of the preprocessed sources
+		uint64_t vertexHash;
+		uint64_t fragmentHash;
+		uint32_t vertexOffset, vertexLength;
+		uint32_t fragmentOffset, fragmentLength;
+		// The defines, separated by ';', used to make sure the entry is the permutation asked for
+		uint32_t definesOffset, definesLength;
+		// The tables written by ShaderReflection::Write
+		uint32_t reflectionOffset, reflectionLength;
+		// The program binary, binaryLength is 0 if the driver did not give one
+		uint32_t binaryOffset, binaryLength;
+		GLenum binaryFormat;
+		uint32_t padding;
+	};
+
+	ShaderArchive()
+		: data(nullptr), size(0)
+	{
+	}
+
+	~ShaderArchive()
+	{
+		Close();
+	}
+
+	ShaderArchive(const ShaderArchive&) = delete;
+	ShaderArchive& operator=(const ShaderArchive&) = delete;
+
+	// The defines of a permutation sorted, each one once. The order of the #define lines does not change the program,
+	// so { "A", "B" } and { "B", "A" } are the same permutation and have to be built and stored only once.
+	static std::vector<std::string> SortDefines(std::vector<std::string> defines)
+	{
+		std::sort(defines.begin(), defines.end());
+		defines.erase(std::unique(defines.begin(), defines.end()), defines.end());
+		return defines;
+	}
+
+	// The hash identifying a permutation: both files and the sorted defines, each followed by a separator
+	// so that moving characters from one name to the next gives a different hash
+	static uint64_t PermutationHash(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines)
+	{
+		uint64_t hash = ShaderCache::Hash(vertexPath + "|" + fragmentPath + "|");
+		for (const std::string& define : SortDefines(defines))
+		{
+			hash = ShaderCache::Hash(define + ";", hash);
+		}
+		return hash;
+	}
+
+	// Maps an archive written by ShaderArchiveWriter into memory, returns false if it is missing or not valid
+	bool Open(const std::string& path)
+	{
+		Close();
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		HANDLE mapping = GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0 ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+		if (mapping != NULL)
+		{
+			this->data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			this->size = this->data != nullptr ? static_cast<size_t>(fileSize.QuadPart) : 0;
+			// The view keeps the file mapped after the handles are closed
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+#else
+		int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (file < 0)
+		{
+			return false;
+		}
+		struct stat info;
+		if (fstat(file, &info) == 0 && info.st_size > 0)
+		{
+			void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			if (mapped != MAP_FAILED)
+			{
+				this->data = static_cast<const char*>(mapped);
+				this->size = static_cast<size_t>(info.st_size);
+			}
+		}
+		// The mapping stays valid after the file is closed
+		close(file);
+#endif
+		if (this->data == nullptr)
+		{
+			return false;
+		}
+		if (!Validate())
+		{
+			std::cout << "ERROR::SHADER::ARCHIVE::INVALID " << path << std::endl;
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void Close()
+	{
+		if (this->data != nullptr)
+		{
+#ifdef _WIN32
+			UnmapViewOfFile(this->data);
+#else
+			munmap(const_cast<char*>(this->data), this->size);
+#endif
+		}
+		this->data = nullptr;
+		this->size = 0;
+	}
+
+	bool IsOpen() const
+	{
+		return this->data != nullptr;
+	}
+
+	// The hash of the driver which baked the program binaries, see ShaderCache::DriverHash
+	uint64_t GetDriver() const
+	{
+		return IsOpen() ? GetHeader().driver : 0;
+	}
+
+	// Returns the entry of a permutation, or nullptr if the archive does not have it
+	const Entry* Find(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines) const
+	{
+		if (!IsOpen())
+		{
+			return nullptr;
+		}
+		const uint64_t key = PermutationHash(vertexPath, fragmentPath, defines);
+		const Entry* begin = GetEntries();
+		const Entry* end = begin + GetHeader().entryCount;
+		const Entry* found = std::lower_bound(begin, end, key, [](const Entry& entry, uint64_t value) { return entry.key < value; });
+		if (found == end || found->key != key)
+		{
+			return nullptr;
+		}
+
+		// Compare the defines too, two permutations with the same hash must not be mixed up
+		const std::vector<std::string> sorted = SortDefines(defines);
+		std::string joined;
+		for (size_t i = 0; i < sorted.size(); ++i)
+		{
+			joined += (i > 0 ? ";" : "") + sorted[i];
+		}
+		if (joined.size() != found->definesLength || joined.compare(0, joined.size(), GetData(found->definesOffset), found->definesLength) != 0)
+		{
+			return nullptr;
+		}
+		return found;
+	}
+
+	// Returns a pointer into the mapped archive
+	const char* GetData(uint32_t offset) const
+	{
+		return this->data + offset;
+	}
+
+private:
+	// "GLSA" stored as a little endian integer
+	static const uint32_t MAGIC = 0x41534C47;
+	// Increased whenever the layout of the archive or of the reflection tables changes, older archives are ignored
+	static const uint32_t VERSION = 2;
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t driver;
+		uint32_t entryCount;
+		uint32_t padding;
+	};
+
+	const char* data;
+	size_t size;
+
+	friend class ShaderArchiveWriter;
+
+	const Header& GetHeader() const
+	{
+		return *reinterpret_cast<const Header*>(this->data);
+	}
+
+	const Entry* GetEntries() const
+	{
+		return reinterpret_cast<const Entry*>(this->data + sizeof(Header));
+	}
+
+	// Checks the header and that every block of every entry is inside the file, so a damaged archive cannot make us read past its end
+	bool Validate() const
+	{
+		if (this->size < sizeof(Header) || GetHeader().magic != MAGIC || GetHeader().version != VERSION
+			|| (this->size - sizeof(Header)) / sizeof(Entry) < GetHeader().entryCount)
+		{
+			return false;
+		}
+		for (uint32_t i = 0; i < GetHeader().entryCount; ++i)
+		{
+			const Entry& entry = GetEntries()[i];
+			const uint32_t blocks[][2] = { { entry.vertexOffset, entry.vertexLength }, { entry.fragmentOffset, entry.fragmentLength },
+				{ entry.definesOffset, entry.definesLength }, { entry.reflectionOffset, entry.reflectionLength }, { entry.binaryOffset, entry.binaryLength } };
+			for (const uint32_t* block : blocks)
+			{
+				if (static_cast<uint64_t>(block[0]) + block[1] > this->size)
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+};
+
+// Collects the permutations baked by the ShaderBake tool and writes them into an archive
+class ShaderArchiveWriter
+{
+public:
+	// Adds a permutation with its preprocessed sources, its reflection tables (ShaderReflection::Write)
+	// and its program binary, which can be empty
+	void Add(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines,
+		const std::string& vertexCode, const std::string& fragmentCode, const std::string& reflection, GLenum binaryFormat, const std::vector<char>& binary)
+	{
+		Permutation permutation;
+		permutation.key = ShaderArchive::PermutationHash(vertexPath, fragmentPath, defines);
+		const std::vector<std::string> sorted = ShaderArchive::SortDefines(defines);
+		for (size_t i = 0; i < sorted.size(); ++i)
+		{
+			permutation.defines += (i > 0 ? ";" : "") + sorted[i];
+		}
+		permutation.vertexCode = vertexCode;
+		permutation.fragmentCode = fragmentCode;
+		permutation.reflection = reflection;
+		permutation.binaryFormat = binaryFormat;
+		permutation.binary = binary;
+		this->permutations.push_back(permutation);
+	}
+
+	// Writes the archive, driver is the ShaderCache::DriverHash of the driver which made the binaries
+	bool Write(const std::string& path, uint64_t driver)
+	{
+		// The index is sorted by key so the archive can be searched with a binary search
+		std::sort(this->permutations.begin(), this->permutations.end(), [](const Permutation& a, const Permutation& b) { return a.key < b.key; });
+
+		ShaderArchive::Header header = { ShaderArchive::MAGIC, ShaderArchive::VERSION, driver, static_cast<uint32_t>(this->permutations.size()), 0 };
+		std::vector<ShaderArchive::Entry> entries(this->permutations.size());
+		std::string blocks;
+		const size_t start = sizeof(header) + entries.size() * sizeof(ShaderArchive::Entry);
+		for (size_t i = 0; i < this->permutations.size(); ++i)
+		{
+			const Permutation& permutation = this->permutations[i];
+			ShaderArchive::Entry& entry = entries[i];
+			entry = ShaderArchive::Entry();
+			entry.key = permutation.key;
+			entry.vertexHash = ShaderCache::Hash(permutation.vertexCode);
+			entry.fragmentHash = ShaderCache::Hash(permutation.fragmentCode);
+			AddBlock(blocks, start, permutation.vertexCode.data(), permutation.vertexCode.size(), entry.vertexOffset, entry.vertexLength);
+			AddBlock(blocks, start, permutation.fragmentCode.data(), permutation.fragmentCode.size(), entry.fragmentOffset, entry.fragmentLength);
+			AddBlock(blocks, start, permutation.defines.data(), permutation.defines.size(), entry.definesOffset, entry.definesLength);
+			AddBlock(blocks, start, permutation.reflection.data(), permutation.reflection.size(), entry.reflectionOffset, entry.reflectionLength);
+			AddBlock(blocks, start, permutation.binary.data(), permutation.binary.size(), entry.binaryOffset, entry.binaryLength);
+			entry.binaryFormat = permutation.binaryFormat;
+		}
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cout << "ERROR::SHADER::ARCHIVE::FILE_NOT_SUCCESFULLY_WRITTEN " << path << std::endl;
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ShaderArchive::Entry));
+		file.write(blocks.data(), blocks.size());
+		return file.good();
+	}
+
+private:
+	struct Permutation
+	{
+		uint64_t key;
+		std::string defines;
+		std::string vertexCode, fragmentCode;
+		std::string reflection;
+		GLenum binaryFormat;
+		std::vector<char> binary;
+	};
+
+	std::vector<Permutation> permutations;
+
+	// Appends a block of data, every block starts at a multiple of 8 bytes so it can be read in place
+	static void AddBlock(std::string& blocks, size_t start, const char* data, size_t length, uint32_t& offset, uint32_t& blockLength)
+	{
+		blocks.resize((blocks.size() + 7) / 8 * 8, '\0');
+		offset = static_cast<uint32_t>(start + blocks.size());
+		blockLength = static_cast<uint32_t>(length);
+		blocks.append(data, length);
+	}
+};
+
+#endif
@@ -0,0 +1,227 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstdio>
+#include <cstddef>
+#include <iostream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+// PROGRAM BINARY CACHE
+// Compiling and linking GLSL is by far the slowest part of creating a shader. Once a program has been linked,
+// OpenGL 4.1 (or the GL_ARB_get_program_binary extension) lets us read the linked program back as an opaque,
+// driver specific blob using glGetProgramBinary, and hand that blob back to the driver on the next run using glProgramBinary.
+// Loading the blob skips the GLSL compiler entirely.
+// The blob is only valid for the exact same driver, so every cache entry stores a hash of the vendor, renderer and version
+// strings. If the driver changes (update, different GPU) the entry is treated as invalid and is simply rebuilt.
+// For more information on program binaries please visit this site:
+// https://www.khronos.org/opengl/wiki/Shader_Compilation#Binary_upload
+class ShaderCache
+{
+public:
+	// The result of trying to load a program from the cache
+	enum Result
+	{
+		// The cache is not available (no extension, no binary formats) and the program was compiled normally
+		DISABLED,
+		// No entry was found for these sources, the program was compiled and written to the cache
+		MISS,
+		// The program was loaded straight from the cache, no compilation happened
+		HIT,
+		// An entry was found but was written by a different driver (or was rejected by the driver),
+		// the program was compiled and the entry was rewritten
+		INVALIDATED
+	};
+
+	// Hashes a block of memory using the 64 bit FNV-1a hash.
+	// Passing in the result of a previous call as the last parameter allows several blocks to be combined into one key.
+	static uint64_t Hash(const void* data, size_t length, uint64_t hash = 14695981039346656037ULL)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < length; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	static uint64_t Hash(const std::string& text, uint64_t hash = 14695981039346656037ULL)
+	{
+		return Hash(text.data(), text.size(), hash);
+	}
+
+	// Hash of the strings which identify the driver. A program binary is only valid for the driver that produced it.
+	static uint64_t DriverHash()
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+		for (GLenum name : names)
+		{
+			const GLubyte* value = glGetString(name);
+			if (value != nullptr)
+			{
+				hash = Hash(std::string(reinterpret_cast<const char*>(value)), hash);
+			}
+		}
+		return hash;
+	}
+
+	// Checks whether the driver can give us program binaries at all.
+	// Some drivers expose the extension but report zero binary formats, in which case there is nothing to cache.
+	static bool IsSupported()
+	{
+		if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+		{
+			return false;
+		}
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		return formats > 0;
+	}
+
+	// The folder, relative to the working directory, where the cache entries are written
+	static std::string& Directory()
+	{
+		static std::string directory = "shader_cache";
+		return directory;
+	}
+
+	// Builds the file name of the cache entry for the given key, one file per program
+	static std::string GetPath(uint64_t key)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+		return Directory() + "/" + name;
+	}
+
+	// Tries to fill the (not yet linked) program object with the binary stored for this key.
+	// Returns HIT if the program is linked and ready to be used, otherwise the caller has to compile the program.
+	static Result Load(GLuint program, uint64_t key)
+	{
+		if (!IsSupported())
+		{
+			return DISABLED;
+		}
+
+		std::ifstream file(GetPath(key), std::ios::binary);
+		if (!file.is_open())
+		{
+			return MISS;
+		}
+
+		Header header;
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!file || header.magic != MAGIC || header.key != key || header.driver != DriverHash())
+		{
+			return INVALIDATED;
+		}
+
+		std::vector<char> binary(header.length);
+		file.read(binary.data(), header.length);
+		if (!file)
+		{
+			return INVALIDATED;
+		}
+
+		// Hand the blob back to the driver, this replaces glAttachShader + glLinkProgram
+		glProgramBinary(program, header.format, binary.data(), header.length);
+
+		// The driver is allowed to reject a binary at any time (for example after an update that kept the version string),
+		// so we always check the link status and fall back to compiling if it failed
+		GLint success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		return success ? HIT : INVALIDATED;
+	}
+
+	// Reads the binary of a linked program back from the driver and writes it into the cache.
+	// The program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set to GL_TRUE.
+	static void Save(GLuint program, uint64_t key)
+	{
+		if (!IsSupported())
+		{
+			return;
+		}
+
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+		{
+			return;
+		}
+
+		Header header;
+		header.magic = MAGIC;
+		header.key = key;
+		header.driver = DriverHash();
+
+		std::vector<char> binary(length);
+		GLsizei written = 0;
+		glGetProgramBinary(program, length, &written, &header.format, binary.data());
+		header.length = static_cast<uint32_t>(written);
+
+		MakeDirectory();
+		std::ofstream file(GetPath(key), std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cout << "ERROR::SHADER::CACHE::FILE_NOT_SUCCESFULLY_WRITTEN" << std::endl;
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(binary.data(), written);
+	}
+
+	// Deletes the entry of a key, the next program with this key is compiled again
+	static void Remove(uint64_t key)
+	{
+		std::remove(GetPath(key).c_str());
+	}
+
+	// Overwrites the driver hash stored in the entry of a key, as if the entry had been written by another driver.
+	// The next Load of the key returns INVALIDATED, this measures what a driver update costs (see VertexBenchmark --cache).
+	static bool MarkStale(uint64_t key)
+	{
+		std::fstream file(GetPath(key), std::ios::binary | std::ios::in | std::ios::out);
+		const uint64_t driver = ~DriverHash();
+		file.seekp(offsetof(Header, driver));
+		file.write(reinterpret_cast<const char*>(&driver), sizeof(driver));
+		return static_cast<bool>(file);
+	}
+
+private:
+	// "GLPB" stored as a little endian integer, used to recognize our own files
+	static const uint32_t MAGIC = 0x42504C47;
+
+	// The header written in front of every binary blob
+	struct Header
+	{
+		uint32_t magic;
+		GLenum format;
+		uint64_t key;
+		uint64_t driver;
+		uint32_t length;
+		uint32_t padding = 0;
+	};
+
+	static void MakeDirectory()
+	{
+#ifdef _WIN32
+		_mkdir(Directory().c_str());
+#else
+		mkdir(Directory().c_str(), 0755);
+#endif
+	}
+};
+
+#endif
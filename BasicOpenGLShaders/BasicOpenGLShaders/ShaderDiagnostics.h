@@ -0,0 +1,211 @@
+#ifndef SHADER_DIAGNOSTICS_H
+#define SHADER_DIAGNOSTICS_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+// SHADER DIAGNOSTICS
+// Every compile and link of every shader is recorded here: which file and permutation, which stage,
+// how long it took and whether it worked, together with the complete log of the driver.
+// The records answer "which shaders make the startup slow" (PrintSlowest) and can be written to a JSON file (Export)
+// to be compared between runs or collected by a build server.
+// When fail on error is enabled, the first shader that does not compile or link ends the program with EXIT_FAILURE,
+// so an automated build fails instead of carrying on with an invalid program. The process ends with std::_Exit,
+// without destructors: hot reload threads may still be running and the static objects may still be in use. Define SHADER_FAIL_ON_ERROR
+// in the build (for example on the build server) to enable it from the start, or call SetFailOnError.
+class ShaderDiagnostics
+{
+public:
+	// One compile, link or cache load
+	struct Record
+	{
+		// The file of the stage, or all the files of the program for a link
+		std::string file;
+		// The defines of the permutation, separated by ';'
+		std::string permutation;
+		// "VERTEX", "FRAGMENT", "COMPUTE"... for a compile, "LINK" for a link,
+		// "CACHE" or "ARCHIVE" for a program loaded from a program binary
+		std::string stage;
+		// The time the application waited for this step. In the asynchronous mode the driver works in the background,
+		// only the time spent submitting the work and reading its result is counted.
+		double microseconds;
+		bool success;
+		// The complete log of the driver, empty if it had nothing to say
+		std::string log;
+	};
+
+	// The diagnostics shared by all the shaders, it can be used from any thread
+	static ShaderDiagnostics& Global()
+	{
+		static ShaderDiagnostics diagnostics;
+		return diagnostics;
+	}
+
+	ShaderDiagnostics()
+#ifdef SHADER_FAIL_ON_ERROR
+		: failOnError(true)
+#else
+		: failOnError(false)
+#endif
+	{
+	}
+
+	// Ends the program with EXIT_FAILURE as soon as a shader fails to compile or link
+	void SetFailOnError(bool failOnError)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->failOnError = failOnError;
+	}
+
+	void Add(const Record& record)
+	{
+		bool fail = false;
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->records.push_back(record);
+			fail = !record.success && this->failOnError;
+		}
+		// The process ends without holding the lock and without running destructors, see above
+		if (fail)
+		{
+			std::cout << "ERROR::SHADER::DIAGNOSTICS::FAIL_ON_ERROR " << record.file << " (" << record.stage << ") failed, exiting" << std::endl;
+			std::cout.flush();
+			std::_Exit(EXIT_FAILURE);
+		}
+	}
+
+	std::vector<Record> GetRecords()
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		return this->records;
+	}
+
+	// Reads the complete information log of a shader or program object.
+	// GL_INFO_LOG_LENGTH gives the size of the log including the terminating null character, so nothing is cut off.
+	static std::string GetInfoLog(GLuint object, bool program)
+	{
+		GLint length = 0;
+		program ? glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length) : glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+		if (length <= 1)
+		{
+			return std::string();
+		}
+		std::string log(length, '\0');
+		GLsizei written = 0;
+		program ? glGetProgramInfoLog(object, length, &written, &log[0]) : glGetShaderInfoLog(object, length, &written, &log[0]);
+		log.resize(written);
+		return log;
+	}
+
+	// Prints the programs which took the longest to build, adding up all of their stages
+	void PrintSlowest(size_t count)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		// The compiles of a program are recorded right before its link, so every link (or program binary) record
+		// closes a program made of the records since the previous one
+		struct Program
+		{
+			std::string name;
+			double microseconds;
+			std::string stages;
+		};
+		std::vector<Program> programs;
+		std::vector<const Record*> stages;
+		for (const Record& record : this->records)
+		{
+			stages.push_back(&record);
+			if (record.stage != "LINK" && record.stage != "CACHE" && record.stage != "ARCHIVE")
+			{
+				continue;
+			}
+
+			Program program = { record.file + (record.permutation.empty() ? "" : " [" + record.permutation + "]"), 0.0, std::string() };
+			for (const Record* stage : stages)
+			{
+				program.microseconds += stage->microseconds;
+				char time[64];
+				snprintf(time, sizeof(time), "%s%s %.0f us", program.stages.empty() ? "" : ", ", stage->stage.c_str(), stage->microseconds);
+				program.stages += time;
+			}
+			programs.push_back(program);
+			stages.clear();
+		}
+
+		std::sort(programs.begin(), programs.end(), [](const Program& a, const Program& b) { return a.microseconds > b.microseconds; });
+		std::cout << "SHADER::DIAGNOSTICS slowest " << std::min(count, programs.size()) << " of " << programs.size() << " programs" << std::endl;
+		for (size_t i = 0; i < programs.size() && i < count; ++i)
+		{
+			std::cout << "  " << programs[i].microseconds << " us " << programs[i].name << " (" << programs[i].stages << ")" << std::endl;
+		}
+	}
+
+	// Writes every record into a JSON file, as an array of objects with the fields of Record
+	bool Export(const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		std::ofstream file(path, std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cout << "ERROR::SHADER::DIAGNOSTICS::FILE_NOT_SUCCESFULLY_WRITTEN " << path << std::endl;
+			return false;
+		}
+
+		file << "[\n";
+		for (size_t i = 0; i < this->records.size(); ++i)
+		{
+			const Record& record = this->records[i];
+			file << "  { \"file\": " << Quote(record.file) << ", \"permutation\": " << Quote(record.permutation)
+				<< ", \"stage\": " << Quote(record.stage) << ", \"microseconds\": " << record.microseconds
+				<< ", \"success\": " << (record.success ? "true" : "false") << ", \"log\": " << Quote(record.log) << " }"
+				<< (i + 1 < this->records.size() ? ",\n" : "\n");
+		}
+		file << "]\n";
+		return file.good();
+	}
+
+private:
+	std::mutex mutex;
+	std::vector<Record> records;
+	bool failOnError;
+
+	// Puts a string between quotes, escaping the characters JSON does not allow as they are
+	static std::string Quote(const std::string& text)
+	{
+		std::string quoted = "\"";
+		for (char character : text)
+		{
+			switch (character)
+			{
+			case '"': quoted += "\\\""; break;
+			case '\\': quoted += "\\\\"; break;
+			case '\n': quoted += "\\n"; break;
+			case '\r': quoted += "\\r"; break;
+			case '\t': quoted += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(character) < 0x20)
+				{
+					char escaped[8];
+					snprintf(escaped, sizeof(escaped), "\\u%04x", character);
+					quoted += escaped;
+				}
+				else
+				{
+					quoted += character;
+				}
+			}
+		}
+		return quoted + "\"";
+	}
+};
+
+#endif
@@ -0,0 +1,269 @@
+#ifndef SHADER_PIPELINE_H
+#define SHADER_PIPELINE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <iostream>
+#include <chrono>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "Shader.h"
+
+// SEPARABLE PROGRAMS AND PROGRAM PIPELINES
+// A Shader links one vertex stage and one fragment stage into a single program, so every combination of a vertex shader
+// and a fragment shader is compiled and linked again: N vertex shaders used with M fragment shaders cost N x M links.
+// With separate shader objects (OpenGL 4.1 or GL_ARB_separate_shader_objects) every stage is linked on its own into
+// a separable program, and a program pipeline object combines one program per stage when drawing.
+// Every stage is then compiled once (N + M compiles), and a pipeline is only a small object pointing at the stages.
+// The cache below builds every stage once and every pipeline once per pair of stages.
+//
+// Usage:
+//		GLuint vertex = pipelines.GetStage(GL_VERTEX_SHADER, "core.vs");
+//		GLuint fragment = pipelines.GetStage(GL_FRAGMENT_SHADER, "core.frag");
+//		pipelines.Use(pipelines.GetPipeline(vertex, fragment));
+// NOTE: uniforms of a stage are set with glProgramUniform on the stage program, glUniform would change the program in use.
+class ShaderPipelineCache
+{
+public:
+	// Counts the work done by the cache, to compare with the N x M links needed without pipelines
+	struct Statistics
+	{
+		// Stages compiled (or loaded from the program binary cache), and pipelines created
+		unsigned int vertexStages;
+		unsigned int fragmentStages;
+		unsigned int compiles;
+		unsigned int pipelines;
+		// How many times a stage or a pipeline was asked for and already existed
+		unsigned int reused;
+	};
+
+	ShaderPipelineCache()
+		: statistics()
+	{
+	}
+
+	~ShaderPipelineCache()
+	{
+		for (const auto& entry : this->pipelines)
+		{
+			glDeleteProgramPipelines(1, &entry.second);
+			GLStateCache::Global().Forget(GL_PROGRAM_PIPELINE, entry.second);
+		}
+		for (const auto& entry : this->stages)
+		{
+			glDeleteProgram(entry.second->program);
+			GLStateCache::Global().Forget(GL_PROGRAM, entry.second->program);
+		}
+	}
+
+	ShaderPipelineCache(const ShaderPipelineCache&) = delete;
+	ShaderPipelineCache& operator=(const ShaderPipelineCache&) = delete;
+
+	// Returns true if the driver supports program pipelines, otherwise Shader has to be used instead
+	static bool IsSupported()
+	{
+		return GLEW_VERSION_4_1 || GLEW_ARB_separate_shader_objects;
+	}
+
+	// Returns the separable program of one stage (GL_VERTEX_SHADER or GL_FRAGMENT_SHADER) built from the file with the given defines.
+	// The program is built the first time it is asked for. Returns 0 if it failed to compile.
+	GLuint GetStage(GLenum type, const std::string& path, const std::vector<std::string>& defines = std::vector<std::string>())
+	{
+		uint64_t key = ShaderCache::Hash(&type, sizeof(type));
+		key = ShaderCache::Hash(path + "|", key);
+		for (const std::string& define : defines)
+		{
+			key = ShaderCache::Hash(define + ";", key);
+		}
+
+		auto found = this->stages.find(key);
+		if (found != this->stages.end())
+		{
+			this->statistics.reused++;
+			return found->second->program;
+		}
+
+		std::unique_ptr<Stage> stage(new Stage());
+		stage->type = type;
+		stage->path = path;
+		stage->defines = defines;
+		BuildStage(*stage);
+		if (stage->program != 0)
+		{
+			stage->reflection.Load(stage->program);
+		}
+
+		GLuint program = stage->program;
+		(type == GL_VERTEX_SHADER ? this->statistics.vertexStages : this->statistics.fragmentStages)++;
+		this->stages[key] = std::move(stage);
+		return program;
+	}
+
+	// Returns the pipeline using the two stage programs returned by GetStage, creating it the first time.
+	// Returns 0 if one of the stages failed to build.
+	GLuint GetPipeline(GLuint vertexStage, GLuint fragmentStage)
+	{
+		if (vertexStage == 0 || fragmentStage == 0)
+		{
+			return 0;
+		}
+
+		const uint64_t key = static_cast<uint64_t>(vertexStage) << 32 | fragmentStage;
+		auto found = this->pipelines.find(key);
+		if (found != this->pipelines.end())
+		{
+			this->statistics.reused++;
+			return found->second;
+		}
+
+		// A pipeline does not compile or link anything, it only records which program runs each stage
+		GLuint pipeline;
+		glGenProgramPipelines(1, &pipeline);
+		glUseProgramStages(pipeline, GL_VERTEX_SHADER_BIT, vertexStage);
+		glUseProgramStages(pipeline, GL_FRAGMENT_SHADER_BIT, fragmentStage);
+		this->pipelines[key] = pipeline;
+		this->statistics.pipelines++;
+		return pipeline;
+	}
+
+	// Uses a pipeline for the following draws.
+	// A program installed with glUseProgram takes priority over the bound pipeline, so it is removed first.
+	static void Use(GLuint pipeline)
+	{
+		GLStateCache& state = GLStateCache::Global();
+		state.UseProgram(0);
+		state.BindProgramPipeline(pipeline);
+	}
+
+	// The interface of a stage program returned by GetStage, or nullptr if the cache did not build it
+	const ShaderReflection* GetReflection(GLuint stageProgram) const
+	{
+		for (const auto& entry : this->stages)
+		{
+			if (entry.second->program == stageProgram)
+			{
+				return &entry.second->reflection;
+			}
+		}
+		return nullptr;
+	}
+
+	const Statistics& GetStatistics() const
+	{
+		return this->statistics;
+	}
+
+	// Prints the work done compared to linking every combination into its own program
+	void PrintStatistics() const
+	{
+		std::cout << "SHADER::PIPELINES " << this->statistics.vertexStages << " vertex stages, " << this->statistics.fragmentStages
+			<< " fragment stages: " << this->statistics.compiles << " compiles, " << this->statistics.pipelines << " pipelines, "
+			<< this->statistics.reused << " reused (every combination as its own program would need "
+			<< this->statistics.vertexStages * this->statistics.fragmentStages << " links)" << std::endl;
+	}
+
+private:
+	struct Stage
+	{
+		GLenum type;
+		std::string path;
+		std::vector<std::string> defines;
+		GLuint program;
+		ShaderCache::Result cacheStatus;
+		ShaderReflection reflection;
+	};
+
+	// Stages keyed by the hash of their type, file and defines, pipelines keyed by their two stage programs
+	std::unordered_map<uint64_t, std::unique_ptr<Stage>> stages;
+	std::unordered_map<uint64_t, GLuint> pipelines;
+	Statistics statistics;
+
+	// Compiles one stage and links it into a separable program, or loads it from the program binary cache
+	void BuildStage(Stage& stage)
+	{
+		std::shared_ptr<const ShaderPreprocessor::Expansion> source = ShaderPreprocessor::Global().Expand(stage.path);
+
+		std::string defineCode;
+		for (const std::string& define : stage.defines)
+		{
+			defineCode += "#define " + define + "\n";
+		}
+
+		std::string permutation;
+		for (size_t i = 0; i < stage.defines.size(); ++i)
+		{
+			permutation += (i > 0 ? ";" : "") + stage.defines[i];
+		}
+
+		// The separable flag is part of the key, a separable program cannot replace a regular one
+		uint64_t cacheKey = ShaderCache::Hash(&source->hash, sizeof(source->hash));
+		cacheKey = ShaderCache::Hash(defineCode, cacheKey);
+		cacheKey = ShaderCache::Hash("separable " + std::to_string(stage.type), cacheKey);
+
+		// The program has to be marked as separable before it is linked or loaded from a binary
+		auto start = std::chrono::high_resolution_clock::now();
+		stage.program = glCreateProgram();
+		glProgramParameteri(stage.program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+		stage.cacheStatus = ShaderCache::Load(stage.program, cacheKey);
+		if (stage.cacheStatus == ShaderCache::HIT)
+		{
+			ShaderDiagnostics::Global().Add({ stage.path, permutation, "CACHE", GetMicroseconds(start), true, std::string() });
+		}
+		else
+		{
+			GLuint shader = glCreateShader(stage.type);
+			const ShaderCode code = { stage.path.c_str(), source->code->data(), source->code->size(), source->hash };
+			Shader::SetShaderSource(shader, code, defineCode);
+			start = std::chrono::high_resolution_clock::now();
+			glCompileShader(shader);
+			this->statistics.compiles++;
+
+			GLint success;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+			const double compileMicroseconds = GetMicroseconds(start);
+			std::string infoLog = ShaderDiagnostics::GetInfoLog(shader, false);
+			if (!success)
+			{
+				std::cout << "ERROR::SHADER::PIPELINE::COMPILATION_FAILED " << stage.path << "\n" << infoLog << std::endl;
+				std::cout << "Files: " << ShaderPreprocessor::Global().GetSourceNames() << std::endl;
+			}
+			ShaderDiagnostics::Global().Add({ stage.path, permutation, Shader::GetStageName(stage.type), compileMicroseconds, success != GL_FALSE, infoLog });
+
+			glAttachShader(stage.program, shader);
+			if (stage.cacheStatus != ShaderCache::DISABLED)
+			{
+				glProgramParameteri(stage.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			}
+			start = std::chrono::high_resolution_clock::now();
+			glLinkProgram(stage.program);
+			glDetachShader(stage.program, shader);
+			glDeleteShader(shader);
+
+			glGetProgramiv(stage.program, GL_LINK_STATUS, &success);
+			infoLog = ShaderDiagnostics::GetInfoLog(stage.program, true);
+			ShaderDiagnostics::Global().Add({ stage.path, permutation, "LINK", GetMicroseconds(start), success != GL_FALSE, infoLog });
+			if (!success)
+			{
+				std::cout << "ERROR::SHADER::PIPELINE::LINKING_FAILED " << stage.path << "\n" << infoLog << std::endl;
+				glDeleteProgram(stage.program);
+				stage.program = 0;
+			}
+			else if (stage.cacheStatus != ShaderCache::DISABLED)
+			{
+				ShaderCache::Save(stage.program, cacheKey);
+			}
+		}
+	}
+
+	// The time since start, for the diagnostics
+	static double GetMicroseconds(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+};
+
+#endif
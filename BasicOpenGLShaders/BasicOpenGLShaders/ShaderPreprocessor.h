@@ -0,0 +1,297 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <iostream>
+#include <algorithm>
+
+#include "ShaderSource.h"
+#include "ShaderCache.h"
+
+// SHADER #include PREPROCESSOR
+// GLSL has no #include, so code shared by several shaders would have to be copied into every file.
+// The preprocessor replaces every line of the form
+//		#include "lighting.glsl"
+// with the contents of that file (relative to the folder of the file doing the include), before the code is given to OpenGL.
+// Every file gets a number, and "#line" directives are inserted around the included code so the compiler
+// reports errors with the number of the file and the line inside that file, for example "48213:14(3): error: ...".
+// The number is derived from the path alone (see GetFileNumber), so the expanded code, and with it the key of the
+// program binary cache, is the same whatever order the files are loaded in. GetSourceNames() returns which file has which number.
+//
+// Files are read once and remembered, and so is the expanded code of every file, keyed by the hash of its contents
+// and of everything it includes. Expanding a file again after an unrelated file changed is just a lookup.
+// A file without includes is not copied at all: its expansion shares the string the file was read into,
+// and the number of the file after its #version line is passed separately by Shader::SetShaderSource.
+// Every expansion also lists all the files it depends on: every Shader watches the files of its own expansions (see Shader::EnableHotReload),
+// so a change to a shared file only reloads the shaders including it.
+class ShaderPreprocessor
+{
+public:
+	// The result of expanding a file
+	struct Expansion
+	{
+		// The code with every #include replaced, the text of the file itself when it has no includes
+		std::shared_ptr<const std::string> code;
+		// Hash of the code
+		uint64_t hash;
+		// Every file the code was built from: the file itself and everything it includes, directly or not
+		std::vector<std::string> files;
+	};
+
+	// The preprocessor shared by all the shaders, it can be used from any thread
+	static ShaderPreprocessor& Global()
+	{
+		static ShaderPreprocessor preprocessor;
+		return preprocessor;
+	}
+
+	// Reads several files at the same time, so the following calls to Expand find them already loaded
+	void Preload(const std::vector<std::string>& paths)
+	{
+		std::vector<std::string> texts;
+		ShaderSource::LoadAll(paths, texts);
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+		for (size_t i = 0; i < paths.size(); ++i)
+		{
+			StoreFile(paths[i], std::move(texts[i]));
+		}
+	}
+
+	// Returns the code of the file with all of its includes expanded
+	std::shared_ptr<const Expansion> Expand(const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		std::vector<std::string> stack;
+		return ExpandFile(path, stack);
+	}
+
+	// Forgets the contents of the files, so they are read again the next time they are needed.
+	// Called when the files changed on disk.
+	void Invalidate(const std::vector<std::string>& paths)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		for (const std::string& path : paths)
+		{
+			auto found = this->files.find(path);
+			if (found != this->files.end())
+			{
+				found->second.loaded = false;
+			}
+		}
+	}
+
+	// Describes which number the compiler uses for which file, for example "48213 = core.vs, 907114 = lighting.glsl"
+	std::string GetSourceNames()
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		std::string names;
+		for (size_t i = 0; i < this->names.size(); ++i)
+		{
+			names += (i > 0 ? ", " : "") + std::to_string(GetFileNumber(this->names[i])) + " = " + this->names[i];
+		}
+		return names;
+	}
+
+	// The number of a file in "#line" directives: a hash of its path, kept under a million so it stays readable in the logs.
+	// Two files may end up with the same number, which only makes the error messages ambiguous, not the code wrong.
+	static int GetFileNumber(const std::string& path)
+	{
+		return static_cast<int>(ShaderCache::Hash(path) % 1000000);
+	}
+
+private:
+	// An #include line found in a file
+	struct Include
+	{
+		// Where the line starts and ends in the text of the file (including the new line character)
+		size_t begin, end;
+		// The number of the #include line in the file
+		int line;
+		// The path of the included file
+		std::string path;
+	};
+
+	struct File
+	{
+		// Shared with the expansion of the file when it has no includes
+		std::shared_ptr<const std::string> text;
+		uint64_t hash;
+		// The number of the file in "#line" directives, see GetFileNumber
+		int number;
+		// The includes found in the text
+		std::vector<Include> includes;
+		// False once the file has been invalidated and has to be read again
+		bool loaded;
+	};
+
+	std::mutex mutex;
+	std::unordered_map<std::string, File> files;
+	// The file names, in the order they were first read
+	std::vector<std::string> names;
+	// Expanded code, keyed by the hash of the file and of the expansions of everything it includes.
+	// Only the most recent expansion of every file is kept, the older ones are dropped when a file is expanded again after an edit.
+	std::unordered_map<uint64_t, std::shared_ptr<const Expansion>> expansions;
+	// The key of the most recent expansion of every file
+	std::unordered_map<std::string, uint64_t> latestKeys;
+
+	// Stores the text of a file and finds its #include lines
+	File& StoreFile(const std::string& path, std::string contents)
+	{
+		auto found = this->files.find(path);
+		if (found == this->files.end())
+		{
+			found = this->files.emplace(path, File()).first;
+			found->second.number = GetFileNumber(path);
+			this->names.push_back(path);
+		}
+
+		File& file = found->second;
+		file.text = std::make_shared<const std::string>(std::move(contents));
+		file.hash = ShaderCache::Hash(*file.text);
+		file.loaded = true;
+		file.includes.clear();
+
+		// The folder of the file, the included paths are relative to it
+		size_t slash = path.find_last_of("/\\");
+		std::string folder = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+		const std::string& text = *file.text;
+		int line = 1;
+		for (size_t begin = 0; begin < text.size(); ++line)
+		{
+			size_t end = text.find('\n', begin);
+			end = end == std::string::npos ? text.size() : end + 1;
+
+			// Skip the indentation, then check for #include "name"
+			size_t start = text.find_first_not_of(" \t", begin);
+			if (start < end && text.compare(start, 8, "#include") == 0)
+			{
+				size_t open = text.find('"', start + 8);
+				size_t close = open < end ? text.find('"', open + 1) : std::string::npos;
+				if (close < end)
+				{
+					file.includes.push_back(Include{ begin, end, line, folder + text.substr(open + 1, close - open - 1) });
+				}
+				else
+				{
+					std::cout << "ERROR::SHADER::PREPROCESSOR::INVALID_INCLUDE " << path << ":" << line << std::endl;
+				}
+			}
+			begin = end;
+		}
+		return file;
+	}
+
+	File& GetFile(const std::string& path)
+	{
+		auto found = this->files.find(path);
+		if (found != this->files.end() && found->second.loaded)
+		{
+			return found->second;
+		}
+		std::string text;
+		ShaderSource::Load(path, text);
+		return StoreFile(path, std::move(text));
+	}
+
+	// Expands a file, stack holds the files currently being expanded to detect files including themselves
+	std::shared_ptr<const Expansion> ExpandFile(const std::string& path, std::vector<std::string>& stack)
+	{
+		if (std::find(stack.begin(), stack.end(), path) != stack.end())
+		{
+			std::cout << "ERROR::SHADER::PREPROCESSOR::RECURSIVE_INCLUDE " << path << std::endl;
+			std::shared_ptr<Expansion> empty = std::make_shared<Expansion>();
+			empty->code = std::make_shared<const std::string>();
+			empty->hash = ShaderCache::Hash(*empty->code);
+			return empty;
+		}
+
+		File& file = GetFile(path);
+		// Copy what we need, expanding the includes may add files to the map
+		const int number = file.number;
+		const uint64_t fileHash = file.hash;
+		const std::vector<Include> includes = file.includes;
+
+		// Expand the includes first, the key of this expansion depends on theirs
+		stack.push_back(path);
+		std::vector<std::shared_ptr<const Expansion>> children;
+		uint64_t key = ShaderCache::Hash(path, fileHash);
+		for (const Include& include : includes)
+		{
+			children.push_back(ExpandFile(include.path, stack));
+			key = ShaderCache::Hash(&children.back()->hash, sizeof(uint64_t), key);
+		}
+		stack.pop_back();
+
+		auto found = this->expansions.find(key);
+		if (found != this->expansions.end())
+		{
+			SetLatest(path, key);
+			return found->second;
+		}
+
+		std::shared_ptr<Expansion> expansion = std::make_shared<Expansion>();
+		expansion->files.push_back(path);
+		const std::shared_ptr<const std::string> text = GetFile(path).text;
+		if (includes.empty())
+		{
+			// Nothing to replace, the expansion is the text of the file
+			expansion->code = text;
+			expansion->hash = fileHash;
+		}
+		else
+		{
+			// Build the code: the text between the includes is copied as it is, every #include line is replaced
+			// by "#line 1 <included file>", the included code, and "#line <next line> <this file>" to continue counting here
+			std::string code;
+			size_t copied = 0;
+			for (size_t i = 0; i < includes.size(); ++i)
+			{
+				const Include& include = includes[i];
+				code.append(*text, copied, include.begin - copied);
+				code += "#line 1 " + std::to_string(this->files[include.path].number) + "\n";
+				code += *children[i]->code;
+				code += "\n#line " + std::to_string(include.line + 1) + " " + std::to_string(number) + "\n";
+				copied = include.end;
+
+				for (const std::string& dependency : children[i]->files)
+				{
+					if (std::find(expansion->files.begin(), expansion->files.end(), dependency) == expansion->files.end())
+					{
+						expansion->files.push_back(dependency);
+					}
+				}
+			}
+			code.append(*text, copied, std::string::npos);
+			expansion->hash = ShaderCache::Hash(code);
+			expansion->code = std::make_shared<const std::string>(std::move(code));
+		}
+
+		this->expansions[key] = expansion;
+		SetLatest(path, key);
+		return expansion;
+	}
+
+	// Makes an expansion the most recent one of its file, and drops the previous one from the cache.
+	// The previous code stays alive as long as a Shader still holds it.
+	void SetLatest(const std::string& path, uint64_t key)
+	{
+		auto found = this->latestKeys.find(path);
+		if (found == this->latestKeys.end())
+		{
+			this->latestKeys.emplace(path, key);
+		}
+		else if (found->second != key)
+		{
+			this->expansions.erase(found->second);
+			found->second = key;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,327 @@
+#ifndef SHADER_REFLECTION_H
+#define SHADER_REFLECTION_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "GLStateCache.h"
+
+// SHADER REFLECTION
+// After a program has been linked, OpenGL can tell us everything the program uses: its vertex attributes (inputs),
+// its uniforms, its uniform blocks and its shader storage blocks, with their locations, types and sizes.
+// ShaderReflection asks for all of that once and stores it in small arrays sorted by a hash of the name (the id).
+// The ids can be computed at compile time with ShaderReflection::Id("position"), so code running every frame
+// never has to compare or hash strings.
+class ShaderReflection
+{
+public:
+	// 32 bit FNV-1a hash of a name, constexpr so Id("color") is computed by the compiler
+	static constexpr uint32_t Id(const char* name)
+	{
+		uint32_t hash = 2166136261u;
+		while (*name != '\0')
+		{
+			hash = (hash ^ static_cast<unsigned char>(*name++)) * 16777619u;
+		}
+		return hash;
+	}
+
+	// A vertex attribute, uniform or block of the program
+	struct Resource
+	{
+		uint32_t id;
+		// Where the name starts in the names buffer
+		uint32_t nameOffset;
+		// The attribute location, uniform location, or block index
+		GLint location;
+		// The GLSL type (GL_FLOAT_VEC3...), 0 for blocks
+		GLenum type;
+		// The number of array elements, or the size of a block in bytes
+		GLint size;
+		// Uniforms inside a uniform block: the index of the block and the offset in bytes inside it, -1 otherwise
+		GLint blockIndex;
+		GLint offset;
+		// Arrays inside a uniform block: the bytes from one element to the next, 0 otherwise
+		GLint arrayStride;
+	};
+
+	std::vector<Resource> attributes;
+	std::vector<Resource> uniforms;
+	std::vector<Resource> uniformBlocks;
+	std::vector<Resource> storageBlocks;
+
+	// Reads the interface of a linked program
+	void Load(GLuint program)
+	{
+		this->attributes.clear();
+		this->uniforms.clear();
+		this->uniformBlocks.clear();
+		this->storageBlocks.clear();
+		this->names.clear();
+
+		std::vector<GLchar> name;
+		GLint count = 0;
+
+		// Vertex attributes
+		glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+		ResizeName(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, name);
+		for (GLint i = 0; i < count; ++i)
+		{
+			Resource attribute = Resource();
+			GLsizei length = 0;
+			glGetActiveAttrib(program, i, static_cast<GLsizei>(name.size()), &length, &attribute.size, &attribute.type, name.data());
+			attribute.location = glGetAttribLocation(program, name.data());
+			attribute.blockIndex = attribute.offset = -1;
+			AddName(attribute, name.data(), length);
+			this->attributes.push_back(attribute);
+		}
+
+		// Uniforms, including the ones inside uniform blocks
+		glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+		ResizeName(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, name);
+		for (GLint i = 0; i < count; ++i)
+		{
+			Resource uniform = Resource();
+			GLsizei length = 0;
+			GLuint index = static_cast<GLuint>(i);
+			glGetActiveUniform(program, index, static_cast<GLsizei>(name.size()), &length, &uniform.size, &uniform.type, name.data());
+			glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &uniform.blockIndex);
+			glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_OFFSET, &uniform.offset);
+			glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_ARRAY_STRIDE, &uniform.arrayStride);
+			uniform.arrayStride = std::max(uniform.arrayStride, 0);
+			uniform.location = glGetUniformLocation(program, name.data());
+			AddName(uniform, name.data(), length);
+			this->uniforms.push_back(uniform);
+		}
+
+		// Uniform blocks
+		glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+		ResizeName(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, name);
+		for (GLint i = 0; i < count; ++i)
+		{
+			Resource block = Resource();
+			GLsizei length = 0;
+			glGetActiveUniformBlockName(program, i, static_cast<GLsizei>(name.size()), &length, name.data());
+			glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.size);
+			block.location = i;
+			block.blockIndex = block.offset = -1;
+			AddName(block, name.data(), length);
+			this->uniformBlocks.push_back(block);
+		}
+
+		// Shader storage blocks can only be listed through the program interface query of OpenGL 4.3
+		if (GLEW_VERSION_4_3 || GLEW_ARB_program_interface_query)
+		{
+			glGetProgramInterfaceiv(program, GL_SHADER_STORAGE_BLOCK, GL_ACTIVE_RESOURCES, &count);
+			GLint maxLength = 0;
+			glGetProgramInterfaceiv(program, GL_SHADER_STORAGE_BLOCK, GL_MAX_NAME_LENGTH, &maxLength);
+			name.resize(std::max<size_t>(name.size(), maxLength + 1));
+			for (GLint i = 0; i < count; ++i)
+			{
+				Resource block = Resource();
+				GLsizei length = 0;
+				const GLenum property = GL_BUFFER_DATA_SIZE;
+				glGetProgramResourceName(program, GL_SHADER_STORAGE_BLOCK, i, static_cast<GLsizei>(name.size()), &length, name.data());
+				glGetProgramResourceiv(program, GL_SHADER_STORAGE_BLOCK, i, 1, &property, 1, NULL, &block.size);
+				block.location = i;
+				block.blockIndex = block.offset = -1;
+				AddName(block, name.data(), length);
+				this->storageBlocks.push_back(block);
+			}
+		}
+
+		// Sort every table by id, so lookups are a binary search
+		auto byId = [](const Resource& a, const Resource& b) { return a.id < b.id; };
+		std::sort(this->attributes.begin(), this->attributes.end(), byId);
+		std::sort(this->uniforms.begin(), this->uniforms.end(), byId);
+		std::sort(this->uniformBlocks.begin(), this->uniformBlocks.end(), byId);
+		std::sort(this->storageBlocks.begin(), this->storageBlocks.end(), byId);
+
+		// Two names with the same id would make the lookups return either of them
+		CheckUniqueIds(this->attributes);
+		CheckUniqueIds(this->uniforms);
+		CheckUniqueIds(this->uniformBlocks);
+		CheckUniqueIds(this->storageBlocks);
+	}
+
+	// Lookups by id, they return nullptr if the program does not use the name
+	const Resource* FindAttribute(uint32_t id) const { return Find(this->attributes, id); }
+	const Resource* FindUniform(uint32_t id) const { return Find(this->uniforms, id); }
+	const Resource* FindUniformBlock(uint32_t id) const { return Find(this->uniformBlocks, id); }
+	const Resource* FindStorageBlock(uint32_t id) const { return Find(this->storageBlocks, id); }
+
+	// Returns the location of a vertex attribute, or -1 if the program does not use it
+	GLint GetAttributeLocation(uint32_t id) const
+	{
+		const Resource* attribute = FindAttribute(id);
+		return attribute != nullptr ? attribute->location : -1;
+	}
+
+	// The name of a resource, mostly useful for error messages
+	const char* GetName(const Resource& resource) const
+	{
+		return this->names.c_str() + resource.nameOffset;
+	}
+
+	// Writes the tables into a block of bytes, so they can be stored (for example in a shader archive)
+	// and read back later without asking a program again
+	void Write(std::string& data) const
+	{
+		const uint32_t counts[] = { static_cast<uint32_t>(this->attributes.size()), static_cast<uint32_t>(this->uniforms.size()),
+			static_cast<uint32_t>(this->uniformBlocks.size()), static_cast<uint32_t>(this->storageBlocks.size()), static_cast<uint32_t>(this->names.size()) };
+		data.append(reinterpret_cast<const char*>(counts), sizeof(counts));
+		for (const std::vector<Resource>* table : { &this->attributes, &this->uniforms, &this->uniformBlocks, &this->storageBlocks })
+		{
+			data.append(reinterpret_cast<const char*>(table->data()), table->size() * sizeof(Resource));
+		}
+		data += this->names;
+	}
+
+	// Reads tables written by Write, returns false if the data is not valid
+	bool Read(const char* data, size_t length)
+	{
+		uint32_t counts[5];
+		if (length < sizeof(counts))
+		{
+			return false;
+		}
+		memcpy(counts, data, sizeof(counts));
+		const size_t resources = static_cast<size_t>(counts[0]) + counts[1] + counts[2] + counts[3];
+		if (length != sizeof(counts) + resources * sizeof(Resource) + counts[4])
+		{
+			return false;
+		}
+
+		const char* read = data + sizeof(counts);
+		std::vector<Resource>* tables[] = { &this->attributes, &this->uniforms, &this->uniformBlocks, &this->storageBlocks };
+		for (int i = 0; i < 4; ++i)
+		{
+			tables[i]->assign(reinterpret_cast<const Resource*>(read), reinterpret_cast<const Resource*>(read) + counts[i]);
+			read += counts[i] * sizeof(Resource);
+		}
+		this->names.assign(read, counts[4]);
+		return true;
+	}
+
+	// Checks that a vertex array object provides every attribute the program reads.
+	// Every active attribute needs an enabled array at its location, and integer attributes (int, ivec2...)
+	// have to be set up with glVertexAttribIPointer while float attributes must not be.
+	// Prints every problem found and returns false if there was any.
+	bool ValidateVertexArray(GLuint vertexArray) const
+	{
+		// Without direct state access the vertex array has to be bound to be queried.
+		// It is bound through the state cache, so the following draws bind their own vertex array again if needed.
+		const bool directStateAccess = GLEW_VERSION_4_5 || GLEW_ARB_direct_state_access;
+		if (!directStateAccess)
+		{
+			GLStateCache::Global().BindVertexArray(vertexArray);
+		}
+
+		bool valid = true;
+		for (const Resource& attribute : this->attributes)
+		{
+			// Built in inputs such as gl_VertexID have no location
+			if (attribute.location < 0)
+			{
+				continue;
+			}
+
+			GLint enabled = 0, integer = 0;
+			if (directStateAccess)
+			{
+				glGetVertexArrayIndexediv(vertexArray, attribute.location, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
+				glGetVertexArrayIndexediv(vertexArray, attribute.location, GL_VERTEX_ATTRIB_ARRAY_INTEGER, &integer);
+			}
+			else
+			{
+				glGetVertexAttribiv(attribute.location, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
+				glGetVertexAttribiv(attribute.location, GL_VERTEX_ATTRIB_ARRAY_INTEGER, &integer);
+			}
+
+			if (!enabled)
+			{
+				std::cout << "ERROR::SHADER::REFLECTION::ATTRIBUTE_NOT_ENABLED " << GetName(attribute)
+					<< " (location " << attribute.location << ")" << std::endl;
+				valid = false;
+			}
+			else if ((integer != 0) != IsIntegerType(attribute.type))
+			{
+				std::cout << "ERROR::SHADER::REFLECTION::ATTRIBUTE_TYPE_MISMATCH " << GetName(attribute)
+					<< " (location " << attribute.location << ")" << std::endl;
+				valid = false;
+			}
+		}
+
+		return valid;
+	}
+
+private:
+	// All the names, one after the other, each followed by a null character
+	std::string names;
+
+	// Makes sure the name buffer can hold the longest name of the given kind
+	static void ResizeName(GLuint program, GLenum maxLengthName, std::vector<GLchar>& name)
+	{
+		GLint maxLength = 0;
+		glGetProgramiv(program, maxLengthName, &maxLength);
+		name.resize(std::max<size_t>(name.size(), maxLength + 1));
+	}
+
+	void AddName(Resource& resource, const GLchar* name, GLsizei length)
+	{
+		std::string plain(name, length);
+		// Arrays of basic types are reported as "name[0]", store them under their plain name.
+		// Only a trailing "[0]" is removed: members of arrays of structs ("lights[1].color") and the elements
+		// of arrayed blocks ("Block[1]") are distinct resources and keep their full name.
+		const char suffix[] = "[0]";
+		const size_t suffixLength = sizeof(suffix) - 1;
+		if (plain.size() > suffixLength && plain.compare(plain.size() - suffixLength, suffixLength, suffix) == 0)
+		{
+			plain.resize(plain.size() - suffixLength);
+		}
+		resource.id = Id(plain.c_str());
+		resource.nameOffset = static_cast<uint32_t>(this->names.size());
+		this->names += plain;
+		this->names += '\0';
+	}
+
+	// Prints the resources of a table sorted by id which share their id with the previous one
+	void CheckUniqueIds(const std::vector<Resource>& table) const
+	{
+		for (size_t i = 1; i < table.size(); ++i)
+		{
+			if (table[i].id == table[i - 1].id)
+			{
+				std::cout << "ERROR::SHADER::REFLECTION::DUPLICATE_ID " << GetName(table[i]) << " and " << GetName(table[i - 1])
+					<< " have the same id, only one of them can be found" << std::endl;
+			}
+		}
+	}
+
+	static const Resource* Find(const std::vector<Resource>& table, uint32_t id)
+	{
+		auto found = std::lower_bound(table.begin(), table.end(), id, [](const Resource& resource, uint32_t value) { return resource.id < value; });
+		return found != table.end() && found->id == id ? &*found : nullptr;
+	}
+
+	static bool IsIntegerType(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_INT: case GL_INT_VEC2: case GL_INT_VEC3: case GL_INT_VEC4:
+		case GL_UNSIGNED_INT: case GL_UNSIGNED_INT_VEC2: case GL_UNSIGNED_INT_VEC3: case GL_UNSIGNED_INT_VEC4:
+			return true;
+		default:
+			return false;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef SHADER_REGISTRY_H
+#define SHADER_REGISTRY_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+#include <iostream>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "Shader.h"
+
+// SHADER REGISTRY
+// When different parts of an application each create their own Shader for the same files, the same program is compiled,
+// linked and kept in memory several times. The registry builds every combination of stages, sources and defines once and
+// hands out shared references to it: asking for a program which is still in use returns the existing one.
+// Programs are told apart by the hash of their preprocessed sources (ShaderPreprocessor::Expansion::hash, ShaderCode::hash),
+// not by their paths, so two paths to the same file, or embedded or archived code equal to a file, share the program too.
+// The defines are sorted first, so the same defines given in another order share the program as well.
+// The references are counted (std::shared_ptr), and the program is deleted as soon as the last reference is released,
+// so it has to be released on the thread of the OpenGL context, before the context is destroyed.
+//
+// Usage:
+//		std::shared_ptr<Shader> shader = ShaderRegistry::Global().Get("core.vs", "core.frag", { "FOG" });
+class ShaderRegistry
+{
+public:
+	// Counts the programs asked for, and how many of them were already built
+	struct Statistics
+	{
+		unsigned int requests;
+		// Programs built, and requests answered with a program which already existed
+		unsigned int created;
+		unsigned int shared;
+		// Programs deleted because their last reference was released
+		unsigned int released;
+	};
+
+	ShaderRegistry()
+		: statistics()
+	{
+	}
+
+	ShaderRegistry(const ShaderRegistry&) = delete;
+	ShaderRegistry& operator=(const ShaderRegistry&) = delete;
+
+	// The registry shared by the whole application
+	static ShaderRegistry& Global()
+	{
+		static ShaderRegistry registry;
+		return registry;
+	}
+
+	// Returns the program built from a vertex and a fragment file with the given defines, see the Shader constructors.
+	// The files are preprocessed here to find their hashes, the Shader built from them finds them already expanded.
+	std::shared_ptr<Shader> Get(const std::string& vertexPath, const std::string& fragmentPath,
+		const std::vector<std::string>& defines = std::vector<std::string>(), bool async = false)
+	{
+		return Get({ GL_VERTEX_SHADER, GL_FRAGMENT_SHADER }, GetHashes({ vertexPath, fragmentPath }), defines, [&](const std::vector<std::string>& sortedDefines)
+		{
+			return new Shader(vertexPath.c_str(), fragmentPath.c_str(), sortedDefines, async);
+		});
+	}
+
+	// Returns the program of a single stage, a compute shader
+	std::shared_ptr<Shader> Get(GLenum stage, const std::string& path,
+		const std::vector<std::string>& defines = std::vector<std::string>(), bool async = false)
+	{
+		return Get(std::vector<GLenum>{ stage }, GetHashes({ path }), defines, [&](const std::vector<std::string>& sortedDefines)
+		{
+			return new Shader(stage, path.c_str(), sortedDefines, async);
+		});
+	}
+
+	// Returns the program built from embedded sources, see EmbeddedShaders.h
+	std::shared_ptr<Shader> Get(const ShaderCode& vertexCode, const ShaderCode& fragmentCode,
+		const std::vector<std::string>& defines = std::vector<std::string>(), bool async = false)
+	{
+		return Get({ GL_VERTEX_SHADER, GL_FRAGMENT_SHADER }, { vertexCode.hash, fragmentCode.hash }, defines, [&](const std::vector<std::string>& sortedDefines)
+		{
+			return new Shader(vertexCode, fragmentCode, sortedDefines, async);
+		});
+	}
+
+	// Returns the program of a single stage from embedded sources
+	std::shared_ptr<Shader> Get(GLenum stage, const ShaderCode& code,
+		const std::vector<std::string>& defines = std::vector<std::string>(), bool async = false)
+	{
+		return Get(std::vector<GLenum>{ stage }, { code.hash }, defines, [&](const std::vector<std::string>& sortedDefines)
+		{
+			return new Shader(stage, code, sortedDefines, async);
+		});
+	}
+
+	// Returns the program of a permutation baked into an archive, see ShaderArchive.h.
+	// The hashes stored in the archive are the hashes of the preprocessed files, so the program is shared with one built from the files.
+	std::shared_ptr<Shader> Get(const ShaderArchive& archive, const std::string& vertexPath, const std::string& fragmentPath,
+		const std::vector<std::string>& defines = std::vector<std::string>(), bool async = false)
+	{
+		const ShaderArchive::Entry* entry = archive.Find(vertexPath, fragmentPath, defines);
+		const std::vector<uint64_t> hashes = entry != nullptr
+			? std::vector<uint64_t>{ entry->vertexHash, entry->fragmentHash }
+			: GetHashes({ vertexPath, fragmentPath });
+		return Get({ GL_VERTEX_SHADER, GL_FRAGMENT_SHADER }, hashes, defines, [&](const std::vector<std::string>& sortedDefines)
+		{
+			return new Shader(archive, vertexPath.c_str(), fragmentPath.c_str(), sortedDefines, async);
+		});
+	}
+
+	// How many programs are in use
+	size_t GetProgramCount() const
+	{
+		return this->entries.size();
+	}
+
+	// How many references to the program built from these files and defines are in use, 0 if it does not exist
+	long GetReferenceCount(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines = std::vector<std::string>()) const
+	{
+		const std::vector<GLenum> stages = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+		const std::vector<uint64_t> hashes = GetHashes({ vertexPath, fragmentPath });
+		const std::vector<std::string> sortedDefines = ShaderArchive::SortDefines(defines);
+		auto found = this->entries.find(GetKey(stages, hashes, sortedDefines));
+		return found != this->entries.end() && found->second.Matches(stages, hashes, sortedDefines) ? found->second.shader.use_count() : 0;
+	}
+
+	const Statistics& GetStatistics() const
+	{
+		return this->statistics;
+	}
+
+	void PrintStatistics() const
+	{
+		std::cout << "SHADER::REGISTRY " << this->entries.size() << " programs in use, " << this->statistics.requests << " requests: "
+			<< this->statistics.created << " built, " << this->statistics.shared << " shared, " << this->statistics.released << " released" << std::endl;
+	}
+
+private:
+	// A program in use. The registry only keeps a weak reference, the program belongs to the references handed out.
+	struct Entry
+	{
+		std::vector<GLenum> stages;
+		// The hashes of the preprocessed sources of the stages
+		std::vector<uint64_t> hashes;
+		std::vector<std::string> defines;
+		std::weak_ptr<Shader> shader;
+
+		bool Matches(const std::vector<GLenum>& stages, const std::vector<uint64_t>& hashes, const std::vector<std::string>& defines) const
+		{
+			return this->stages == stages && this->hashes == hashes && this->defines == defines;
+		}
+	};
+
+	// Builds the Shader when the program is not in use yet, it receives the sorted defines
+	typedef std::function<Shader*(const std::vector<std::string>& defines)> Creator;
+
+	// Programs keyed by the hash of their stages, sources and defines
+	std::unordered_map<uint64_t, Entry> entries;
+	Statistics statistics;
+
+	std::shared_ptr<Shader> Get(const std::vector<GLenum>& stages, const std::vector<uint64_t>& hashes, const std::vector<std::string>& requestedDefines, Creator create)
+	{
+		this->statistics.requests++;
+		// The same defines in another order, or repeated, are the same program
+		const std::vector<std::string> defines = ShaderArchive::SortDefines(requestedDefines);
+		const uint64_t key = GetKey(stages, hashes, defines);
+		auto found = this->entries.find(key);
+		if (found != this->entries.end() && found->second.Matches(stages, hashes, defines))
+		{
+			std::shared_ptr<Shader> shader = found->second.shader.lock();
+			if (shader)
+			{
+				this->statistics.shared++;
+				return shader;
+			}
+		}
+
+		Shader* created = create(defines);
+		this->statistics.created++;
+
+		// The last reference deletes the Shader, and with it the program, then removes the entry.
+		// The entry may have been replaced by another program with the same key, that one is still in use and is kept.
+		std::shared_ptr<Shader> shader(created, [this, key](Shader* shader)
+		{
+			delete shader;
+			this->statistics.released++;
+			auto found = this->entries.find(key);
+			if (found != this->entries.end() && found->second.shader.expired())
+			{
+				this->entries.erase(found);
+			}
+		});
+
+		Entry& entry = this->entries[key];
+		entry.stages = stages;
+		entry.hashes = hashes;
+		entry.defines = defines;
+		entry.shader = shader;
+		return shader;
+	}
+
+	// The hashes of the files with their includes expanded
+	static std::vector<uint64_t> GetHashes(const std::vector<std::string>& paths)
+	{
+		std::vector<uint64_t> hashes;
+		for (const std::string& path : paths)
+		{
+			hashes.push_back(ShaderPreprocessor::Global().Expand(path)->hash);
+		}
+		return hashes;
+	}
+
+	// Every define is followed by a separator, so moving characters from one define to the next gives a different hash.
+	// The defines are sorted, see ShaderArchive::SortDefines.
+	static uint64_t GetKey(const std::vector<GLenum>& stages, const std::vector<uint64_t>& hashes, const std::vector<std::string>& defines)
+	{
+		uint64_t key = ShaderCache::Hash(stages.data(), stages.size() * sizeof(GLenum));
+		key = ShaderCache::Hash(hashes.data(), hashes.size() * sizeof(uint64_t), key);
+		for (const std::string& define : defines)
+		{
+			key = ShaderCache::Hash(define + ";", key);
+		}
+		return key;
+	}
+};
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef SHADER_SOURCE_H
+#define SHADER_SOURCE_H
+
+#include <string>
+#include <vector>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <cstdint>
+#include <iostream>
+
+// Source code which is already in memory: where it came from, its text (not null terminated), its length and its hash (ShaderCache::Hash).
+// The sources embedded into the program by ShaderBake --embed (EmbeddedShaders.h) are constexpr ShaderCode values,
+// so a shader created from them opens no file and hashes nothing.
+struct ShaderCode
+{
+	const char* path;
+	const char* code;
+	size_t length;
+	uint64_t hash;
+};
+
+// SHADER SOURCE LOADING
+// Reading a file through std::ifstream and std::stringstream copies the text twice: once into the stream buffer,
+// and once more when the stream is converted into a string. Shader sources are read a lot (startup, hot reload),
+// so we ask the operating system for the size of the file, allocate the string once and read the whole file
+// directly into it with a single read call. The string is then handed to glShaderSource together with its length,
+// so OpenGL does not need to search for the terminating null character either.
+class ShaderSource
+{
+public:
+	// Counters for all the files loaded so far, shared by every thread that loads sources
+	struct Statistics
+	{
+		std::atomic<unsigned long long> files;
+		std::atomic<unsigned long long> bytes;
+		std::atomic<unsigned long long> microseconds;
+	};
+
+	static Statistics& GetStatistics()
+	{
+		static Statistics statistics;
+		return statistics;
+	}
+
+	static void ResetStatistics()
+	{
+		GetStatistics().files = 0;
+		GetStatistics().bytes = 0;
+		GetStatistics().microseconds = 0;
+	}
+
+	// Returns true if the file exists and can be read
+	static bool Exists(const std::string& path)
+	{
+		return std::ifstream(path).is_open();
+	}
+
+	// Reads the whole file into text, returns false if the file could not be read
+	static bool Load(const std::string& path, std::string& text)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		// Binary mode, so the size reported by the file is the number of bytes we read (no newline conversion on Windows)
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+		{
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+			text.clear();
+			return false;
+		}
+
+		// The file was opened at its end (std::ios::ate), so the current position is its size
+		std::streamsize size = file.tellg();
+		file.seekg(0, std::ios::beg);
+
+		text.resize(size > 0 ? static_cast<size_t>(size) : 0);
+		if (!text.empty())
+		{
+			file.read(&text[0], size);
+		}
+		size_t read = static_cast<size_t>(file.gcount());
+		text.resize(read);
+
+		Statistics& statistics = GetStatistics();
+		statistics.files++;
+		statistics.bytes += read;
+		statistics.microseconds += std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::high_resolution_clock::now() - start).count();
+		return size >= 0 && read == static_cast<size_t>(size);
+	}
+
+	// Reads several files at the same time. Every file except the first one is read on its own thread,
+	// the first one is read on the calling thread while the others are loading.
+	// The texts are returned in the same order as the paths, returns false if any file could not be read.
+	static bool LoadAll(const std::vector<std::string>& paths, std::vector<std::string>& texts)
+	{
+		texts.assign(paths.size(), std::string());
+		if (paths.empty())
+		{
+			return true;
+		}
+
+		std::vector<std::future<bool>> loads;
+		for (size_t i = 1; i < paths.size(); ++i)
+		{
+			loads.push_back(std::async(std::launch::async, [&paths, &texts, i] { return Load(paths[i], texts[i]); }));
+		}
+
+		bool success = Load(paths[0], texts[0]);
+		for (std::future<bool>& load : loads)
+		{
+			success = load.get() && success;
+		}
+		return success;
+	}
+};
+
+#endif
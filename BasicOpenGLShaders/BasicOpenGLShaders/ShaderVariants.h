@@ -0,0 +1,166 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#include "ShaderRegistry.h"
+
+// SHADER VARIANT CACHE
+// A single shader file can be compiled into many variants (permutations) by turning features on and off with defines,
+// for example lit/unlit, fog, skinning and instancing. Different parts of a program often ask for the same variant,
+// so instead of creating their own Shader they ask the cache, which compiles every combination only once.
+// The variants are taken from the ShaderRegistry, so a variant also built elsewhere in the program is shared as well.
+// The cache can also write the list of the combinations in use to a file, which can be used to compile all of them
+// ahead of time (Prewarm), filling the program binary cache before the program actually needs them.
+class ShaderVariantCache
+{
+public:
+	// Returns the variant for this combination of files and defines, creating it the first time it is asked for.
+	// The order of the defines does not matter, the variant is built with them sorted (see ShaderArchive::SortDefines).
+	Shader& Get(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& requestedDefines, bool async = false)
+	{
+		const std::vector<std::string> defines = ShaderArchive::SortDefines(requestedDefines);
+		uint64_t hash = ShaderArchive::PermutationHash(vertexPath, fragmentPath, defines);
+		auto found = this->variants.find(hash);
+		if (found != this->variants.end() && found->second.vertexPath == vertexPath
+			&& found->second.fragmentPath == fragmentPath && found->second.shader->GetDefines() == defines)
+		{
+			found->second.requests++;
+			return *found->second.shader;
+		}
+
+		Variant variant;
+		variant.vertexPath = vertexPath;
+		variant.fragmentPath = fragmentPath;
+		variant.shader = ShaderRegistry::Global().Get(vertexPath, fragmentPath, defines, async);
+		variant.requests = 1;
+		Shader& shader = *variant.shader;
+		this->variants[hash] = std::move(variant);
+		return shader;
+	}
+
+	// The number of different variants created so far
+	size_t GetVariantCount() const
+	{
+		return this->variants.size();
+	}
+
+	// Prints every variant with the time it took to compile, slowest first
+	void PrintStatistics() const
+	{
+		std::vector<const Variant*> sorted;
+		for (const auto& entry : this->variants)
+		{
+			sorted.push_back(&entry.second);
+		}
+		std::sort(sorted.begin(), sorted.end(), [](const Variant* a, const Variant* b)
+		{
+			return a->shader->GetCompileMilliseconds() > b->shader->GetCompileMilliseconds();
+		});
+
+		const char* cacheStatusNames[] = { "disabled", "miss", "hit", "invalidated" };
+		std::cout << "SHADER::VARIANTS " << sorted.size() << " variants" << std::endl;
+		for (const Variant* variant : sorted)
+		{
+			std::cout << "  " << variant->vertexPath << " " << variant->fragmentPath << " [" << JoinDefines(variant->shader->GetDefines()) << "] "
+				<< variant->shader->GetCompileMilliseconds() << " ms, program cache " << cacheStatusNames[variant->shader->GetCacheStatus()]
+				<< ", requested " << variant->requests << " times" << std::endl;
+		}
+	}
+
+	// Writes every combination in use to a file, one per line: vertex file|fragment file|define;define
+	bool Dump(const std::string& path) const
+	{
+		std::ofstream file(path);
+		if (!file.is_open())
+		{
+			std::cout << "ERROR::SHADER::VARIANTS::FILE_NOT_SUCCESFULLY_WRITTEN " << path << std::endl;
+			return false;
+		}
+		for (const auto& entry : this->variants)
+		{
+			const Variant& variant = entry.second;
+			file << variant.vertexPath << "|" << variant.fragmentPath << "|" << JoinDefines(variant.shader->GetDefines()) << "\n";
+		}
+		return true;
+	}
+
+	// Reads a file written by Dump and starts compiling every combination in it, in the background.
+	// After the programs are ready they are in the program binary cache, so the next run loads them without compiling.
+	void Prewarm(const std::string& path)
+	{
+		std::vector<std::vector<std::string>> permutations;
+		if (!ReadDump(path, permutations))
+		{
+			return;
+		}
+		for (const std::vector<std::string>& fields : permutations)
+		{
+			Get(fields[0], fields[1], std::vector<std::string>(fields.begin() + 2, fields.end()), true);
+		}
+	}
+
+	// Reads a file written by Dump. Every permutation is returned as the vertex file, the fragment file, and then its defines.
+	static bool ReadDump(const std::string& path, std::vector<std::vector<std::string>>& permutations)
+	{
+		std::ifstream file(path);
+		if (!file.is_open())
+		{
+			std::cout << "ERROR::SHADER::VARIANTS::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+			return false;
+		}
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			size_t first = line.find('|');
+			size_t second = first == std::string::npos ? std::string::npos : line.find('|', first + 1);
+			if (second == std::string::npos)
+			{
+				continue;
+			}
+
+			std::vector<std::string> fields = { line.substr(0, first), line.substr(first + 1, second - first - 1) };
+			std::string defines = line.substr(second + 1);
+			for (size_t start = 0; start < defines.size(); )
+			{
+				size_t end = defines.find(';', start);
+				end = end == std::string::npos ? defines.size() : end;
+				fields.push_back(defines.substr(start, end - start));
+				start = end + 1;
+			}
+			permutations.push_back(fields);
+		}
+		return true;
+	}
+
+private:
+	struct Variant
+	{
+		std::string vertexPath, fragmentPath;
+		// The cache keeps a reference, the variants live as long as the cache
+		std::shared_ptr<Shader> shader;
+		// How many times this variant was asked for, the first request created it
+		unsigned int requests;
+	};
+
+	std::unordered_map<uint64_t, Variant> variants;
+
+	static std::string JoinDefines(const std::vector<std::string>& defines)
+	{
+		std::string joined;
+		for (size_t i = 0; i < defines.size(); ++i)
+		{
+			joined += (i > 0 ? ";" : "") + defines[i];
+		}
+		return joined;
+	}
+};
+
+#endif
@@ -0,0 +1,292 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <climits>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+#include "ShaderSource.h"
+#include "ShaderCache.h"
+
+// SHADER WATCHER
+// Watches the source files of a shader on a background thread and reads them again as soon as one of them changes.
+// The render loop only has to check an atomic flag (HasChanges) once per frame, which costs nothing while the files
+// are not being edited. All the file reading (and preprocessing, see the Loader below) is done on the watcher thread.
+// On Linux the thread sleeps inside the kernel until inotify reports a change in one of the folders holding the files.
+// On other platforms the thread wakes up a few times per second and compares the modification times of the files.
+class ShaderWatcher
+{
+public:
+	// A source read again after a change, and its hash (ShaderCache::Hash), computed on the watcher thread as well.
+	// The code is shared so a loader can hand over a string it keeps as well without copying it.
+	struct Source
+	{
+		std::shared_ptr<const std::string> code;
+		uint64_t hash;
+	};
+
+	// Called on the watcher thread after a change, returns the new sources.
+	// The loader receives the list of watched files and can change it, for example when a file includes a new file.
+	typedef std::function<std::vector<Source>(std::vector<std::string>& paths)> Loader;
+
+	// Starts watching the given files, the order of the paths is the order of the sources returned by TakeSources
+	explicit ShaderWatcher(const std::vector<std::string>& paths)
+		: ShaderWatcher(paths, LoadFiles)
+	{
+	}
+
+	// Starts watching the given files, calling load to get the new sources whenever one of them changes
+	ShaderWatcher(const std::vector<std::string>& paths, Loader load)
+		: paths(paths), load(load), changed(false), running(true)
+	{
+#ifdef __linux__
+		this->notifyFile = inotify_init1(IN_CLOEXEC);
+		if (pipe(this->stopPipe) != 0)
+		{
+			this->stopPipe[0] = this->stopPipe[1] = -1;
+		}
+#endif
+		WatchPaths();
+		this->thread = std::thread(&ShaderWatcher::Run, this);
+	}
+
+	// Stops the watcher thread and waits for it to exit
+	~ShaderWatcher()
+	{
+		this->running = false;
+#ifdef __linux__
+		// Wake up the thread sleeping in poll()
+		if (this->stopPipe[1] >= 0)
+		{
+			char stop = 0;
+			(void)write(this->stopPipe[1], &stop, 1);
+		}
+#else
+		this->stopCondition.notify_all();
+#endif
+		if (this->thread.joinable())
+		{
+			this->thread.join();
+		}
+#ifdef __linux__
+		close(this->notifyFile);
+		close(this->stopPipe[0]);
+		close(this->stopPipe[1]);
+#endif
+	}
+
+	ShaderWatcher(const ShaderWatcher&) = delete;
+	ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+	// Returns true if the files changed since the last call to TakeSources.
+	// This is only an atomic load, so it can be called every frame.
+	bool HasChanges() const
+	{
+		return this->changed.load(std::memory_order_acquire);
+	}
+
+	// Returns the new sources, in the order of the paths given to the constructor (or as returned by the loader),
+	// and the files watched from now on, which the loader may have changed
+	std::vector<Source> TakeSources(std::vector<std::string>& files)
+	{
+		std::lock_guard<std::mutex> lock(this->sourcesMutex);
+		this->changed.store(false, std::memory_order_release);
+		files = this->files;
+		return std::move(this->sources);
+	}
+
+private:
+	// The watched files, only used by the watcher thread once it has started
+	std::vector<std::string> paths;
+	Loader load;
+	std::thread thread;
+	std::atomic<bool> changed;
+	std::atomic<bool> running;
+	// The sources read by the watcher thread and the files watched after reading them, waiting to be taken by the render loop
+	std::vector<Source> sources;
+	std::vector<std::string> files;
+	std::mutex sourcesMutex;
+
+#ifdef __linux__
+	struct Watch
+	{
+		int descriptor;
+		std::string name;
+	};
+	int notifyFile;
+	int stopPipe[2];
+	std::vector<Watch> watches;
+#else
+	std::vector<long long> modificationTimes;
+	std::mutex stopMutex;
+	std::condition_variable stopCondition;
+#endif
+
+	// The default loader, reads the files as they are
+	static std::vector<Source> LoadFiles(std::vector<std::string>& paths)
+	{
+		std::vector<std::string> texts;
+		ShaderSource::LoadAll(paths, texts);
+		std::vector<Source> sources;
+		for (std::string& text : texts)
+		{
+			const uint64_t hash = ShaderCache::Hash(text);
+			sources.push_back(Source{ std::make_shared<const std::string>(std::move(text)), hash });
+		}
+		return sources;
+	}
+
+	// Starts watching every path which is not watched yet
+	void WatchPaths()
+	{
+#ifdef __linux__
+		// inotify reports events for folders, we watch the folder of every file because most editors save a file
+		// by writing a new file and renaming it over the old one, which would remove a watch placed on the file itself.
+		// Adding the same folder twice returns the same watch descriptor.
+		for (size_t i = this->watches.size(); i < this->paths.size(); ++i)
+		{
+			std::string folder, name;
+			SplitPath(this->paths[i], folder, name);
+			int watch = inotify_add_watch(this->notifyFile, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+			this->watches.push_back(Watch{ watch, name });
+		}
+#else
+		for (size_t i = this->modificationTimes.size(); i < this->paths.size(); ++i)
+		{
+			this->modificationTimes.push_back(GetModificationTime(this->paths[i]));
+		}
+#endif
+	}
+
+	static void SplitPath(const std::string& path, std::string& folder, std::string& name)
+	{
+		size_t slash = path.find_last_of("/\\");
+		folder = slash == std::string::npos ? "." : path.substr(0, slash);
+		name = slash == std::string::npos ? path : path.substr(slash + 1);
+	}
+
+	// The body of the watcher thread
+	void Run()
+	{
+		while (this->running)
+		{
+			if (!WaitForChange())
+			{
+				continue;
+			}
+
+			// Editors often write a file in several steps, wait a moment so we read the finished file
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+			// The loader may add new files to the list, for example a newly included file
+			std::vector<std::string> newPaths = this->paths;
+			std::vector<Source> newSources = this->load(newPaths);
+			if (newPaths != this->paths)
+			{
+				// Files which are no longer used are dropped by restarting the list from scratch
+				ResetWatches();
+				this->paths = newPaths;
+				WatchPaths();
+			}
+
+			std::lock_guard<std::mutex> lock(this->sourcesMutex);
+			this->sources = std::move(newSources);
+			this->files = this->paths;
+			this->changed.store(true, std::memory_order_release);
+		}
+	}
+
+	// Forgets the watched files, WatchPaths adds them again
+	void ResetWatches()
+	{
+#ifdef __linux__
+		for (const Watch& watch : this->watches)
+		{
+			inotify_rm_watch(this->notifyFile, watch.descriptor);
+		}
+		this->watches.clear();
+#else
+		this->modificationTimes.clear();
+#endif
+	}
+
+#ifdef __linux__
+	// Sleeps until one of the watched files is written, returns false if the watcher is stopping
+	bool WaitForChange()
+	{
+		pollfd files[2] = { { this->notifyFile, POLLIN, 0 }, { this->stopPipe[0], POLLIN, 0 } };
+		if (poll(files, 2, -1) <= 0 || (files[1].revents & POLLIN) || !this->running)
+		{
+			return false;
+		}
+
+		// Read all the pending events and check whether one of them is about one of our files
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length = read(this->notifyFile, buffer, sizeof(buffer));
+		bool found = false;
+		for (ssize_t i = 0; i < length; )
+		{
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + i);
+			for (const Watch& watch : this->watches)
+			{
+				if (event->wd == watch.descriptor && event->len > 0 && watch.name == event->name)
+				{
+					found = true;
+				}
+			}
+			i += sizeof(inotify_event) + event->len;
+		}
+		return found;
+	}
+#else
+	static long long GetModificationTime(const std::string& path)
+	{
+#ifdef _WIN32
+		struct _stat info;
+		return _stat(path.c_str(), &info) == 0 ? static_cast<long long>(info.st_mtime) : 0;
+#else
+		struct stat info;
+		return stat(path.c_str(), &info) == 0 ? static_cast<long long>(info.st_mtime) : 0;
+#endif
+	}
+
+	// Checks the modification times of the files a few times per second, returns false if nothing changed
+	bool WaitForChange()
+	{
+		{
+			std::unique_lock<std::mutex> lock(this->stopMutex);
+			this->stopCondition.wait_for(lock, std::chrono::milliseconds(250), [this] { return !this->running; });
+		}
+
+		bool found = false;
+		for (size_t i = 0; i < this->paths.size(); ++i)
+		{
+			long long time = GetModificationTime(this->paths[i]);
+			if (time != this->modificationTimes[i])
+			{
+				this->modificationTimes[i] = time;
+				found = true;
+			}
+		}
+		return found && this->running;
+	}
+#endif
+};
+
+#endif
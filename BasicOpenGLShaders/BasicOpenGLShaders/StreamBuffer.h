@@ -0,0 +1,242 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "GLStateCache.h"
+#include "DirectStateAccess.h"
+
+// STREAMING BUFFER
+// Data written again every frame (per draw uniforms, instances, particles, debug lines, UI) cannot simply be uploaded with
+// glBufferSubData into the buffer the GPU is still reading from the previous frame: the driver either waits for the GPU
+// or makes a hidden copy. Instead the buffer is split into one region per frame in flight. Every frame writes into the next region,
+// and a fence placed after the draws of a frame keeps its region from being written again until the GPU has finished with it.
+// With three regions the CPU can be up to two frames ahead of the GPU without ever waiting.
+// How the CPU writes into the regions depends on what the driver offers:
+//		PERSISTENT		OpenGL 4.4 or ARB_buffer_storage: the buffer is mapped once, persistent and coherent, and stays mapped
+//						while the GPU draws from it. Writing is a plain memory copy, there are no map or unmap calls at all.
+//		UNSYNCHRONIZED	OpenGL 3.3: the region of the frame is mapped without synchronization (the fence already guarantees the GPU
+//						is done with it) and unmapped before drawing. The buffer cannot be drawn from while it is mapped,
+//						so everything of a frame is written before its draws.
+//		ORPHANING		a single region, given a new store every frame (glBufferData with no data): the driver keeps the old store
+//						alive until the GPU is done with it. No fences, but the driver has to allocate behind the scenes.
+// The strategy is chosen from the context (PERSISTENT if available, UNSYNCHRONIZED otherwise), or can be forced.
+// The buffer is mapped and written without binding it to the target it is drawn from (see DirectStateAccess.h).
+//
+// Usage, every frame:
+//		stream.BeginFrame();
+//		allocation = stream.Allocate(size);			write the data into allocation.data, the GPU reads it at allocation.offset
+//		stream.EndFrame();
+//		draw
+//		stream.Fence();
+class StreamBuffer
+{
+public:
+	enum Strategy
+	{
+		PERSISTENT,
+		UNSYNCHRONIZED,
+		ORPHANING,
+		AUTOMATIC
+	};
+
+	// A piece of the current region: where to write the data, and its offset in the buffer
+	struct Allocation
+	{
+		void* data;
+		GLintptr offset;
+	};
+
+	// Creates a buffer with room for frameSize bytes per frame, for the given number of frames in flight.
+	// Every allocation starts at a multiple of alignment.
+	StreamBuffer(GLsizeiptr frameSize, int frames = 3, GLsizeiptr alignment = 4, Strategy strategy = AUTOMATIC)
+		: alignment(alignment), frames(frames), frame(0), used(0), base(nullptr), mapped(nullptr)
+	{
+		this->strategy = strategy != AUTOMATIC ? strategy : IsPersistentSupported() ? PERSISTENT : UNSYNCHRONIZED;
+		if (this->strategy == PERSISTENT && !IsPersistentSupported())
+		{
+			std::cout << "ERROR::STREAM_BUFFER::PERSISTENT_NOT_SUPPORTED using unsynchronized mapping" << std::endl;
+			this->strategy = UNSYNCHRONIZED;
+		}
+		if (this->strategy == ORPHANING)
+		{
+			this->frames = 1;
+		}
+		// Every region starts at an aligned offset
+		this->frameSize = (frameSize + alignment - 1) / alignment * alignment;
+
+		this->buffer = DirectStateAccess::CreateBuffer();
+		if (this->strategy == PERSISTENT)
+		{
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			DirectStateAccess::BufferStorage(this->buffer, this->frameSize * this->frames, nullptr, flags);
+			this->base = static_cast<unsigned char*>(DirectStateAccess::MapBufferRange(this->buffer, 0, this->frameSize * this->frames, flags));
+		}
+		else
+		{
+			DirectStateAccess::BufferData(this->buffer, this->frameSize * this->frames, nullptr, GL_STREAM_DRAW);
+		}
+		this->fences.assign(this->frames, nullptr);
+	}
+
+	~StreamBuffer()
+	{
+		for (GLsync fence : this->fences)
+		{
+			glDeleteSync(fence);
+		}
+		if (this->base != nullptr || this->mapped != nullptr)
+		{
+			DirectStateAccess::UnmapBuffer(this->buffer);
+		}
+		glDeleteBuffers(1, &this->buffer);
+		GLStateCache::Global().Forget(GL_BUFFER, this->buffer);
+	}
+
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	// True if the context can map a buffer while drawing from it
+	static bool IsPersistentSupported()
+	{
+		return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+	}
+
+	static const char* GetStrategyName(Strategy strategy)
+	{
+		switch (strategy)
+		{
+		case PERSISTENT: return "persistent";
+		case UNSYNCHRONIZED: return "unsynchronized";
+		case ORPHANING: return "orphaning";
+		default: return "automatic";
+		}
+	}
+
+	// Moves to the next region, waiting for the GPU only if it is still reading that region, and makes it writable
+	void BeginFrame()
+	{
+		this->frame = (this->frame + 1) % this->frames;
+		this->used = 0;
+
+		GLsync& fence = this->fences[this->frame];
+		if (fence != nullptr)
+		{
+			glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+		switch (this->strategy)
+		{
+		case PERSISTENT:
+			this->mapped = nullptr;
+			break;
+		case UNSYNCHRONIZED:
+			// We only tell the driver which part we actually wrote when we are done (FLUSH_EXPLICIT)
+			this->mapped = static_cast<unsigned char*>(DirectStateAccess::MapBufferRange(this->buffer, GetRegionOffset(), this->frameSize,
+				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT));
+			break;
+		default:
+			DirectStateAccess::BufferData(this->buffer, this->frameSize, nullptr, GL_STREAM_DRAW);
+			this->mapped = static_cast<unsigned char*>(DirectStateAccess::MapBufferRange(this->buffer, 0, this->frameSize,
+				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+			break;
+		}
+	}
+
+	// Takes the next size bytes of this frame's region. Returns data == nullptr if the region is full.
+	Allocation Allocate(GLsizeiptr size)
+	{
+		Allocation allocation = { nullptr, 0 };
+		unsigned char* region = GetRegion();
+		if (region == nullptr || this->used + size > this->frameSize)
+		{
+			return allocation;
+		}
+		allocation.data = region + this->used;
+		allocation.offset = GetRegionOffset() + this->used;
+		this->used += (size + this->alignment - 1) / this->alignment * this->alignment;
+		return allocation;
+	}
+
+	// Makes what was written visible to the GPU, the allocations of this frame can then be used for drawing
+	void EndFrame()
+	{
+		if (this->mapped == nullptr)
+		{
+			// A persistent coherent mapping needs nothing
+			return;
+		}
+		if (this->strategy == UNSYNCHRONIZED && this->used > 0)
+		{
+			DirectStateAccess::FlushMappedBufferRange(this->buffer, 0, std::min(this->used, this->frameSize));
+		}
+		DirectStateAccess::UnmapBuffer(this->buffer);
+		this->mapped = nullptr;
+	}
+
+	// Call after the last draw using this frame's region, the region is reused once the GPU has passed this point
+	void Fence()
+	{
+		if (this->strategy != ORPHANING)
+		{
+			// Only the last fence of a frame matters
+			glDeleteSync(this->fences[this->frame]);
+			this->fences[this->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+	}
+
+	GLuint GetBuffer() const
+	{
+		return this->buffer;
+	}
+
+	Strategy GetStrategy() const
+	{
+		return this->strategy;
+	}
+
+	GLsizeiptr GetFrameSize() const
+	{
+		return this->frameSize;
+	}
+
+	// The bytes allocated in this frame's region
+	GLsizeiptr GetUsed() const
+	{
+		return this->used;
+	}
+
+private:
+	GLuint buffer;
+	Strategy strategy;
+	GLsizeiptr frameSize;
+	GLsizeiptr alignment;
+	int frames;
+	// The region of the current frame, and how much of it has been allocated
+	int frame;
+	GLsizeiptr used;
+	// The whole buffer when it is mapped persistently, otherwise the region mapped for the current frame
+	unsigned char* base;
+	unsigned char* mapped;
+	std::vector<GLsync> fences;
+
+	GLintptr GetRegionOffset() const
+	{
+		return this->frame * this->frameSize;
+	}
+
+	// Where the current region starts in memory, nullptr if it is not mapped
+	unsigned char* GetRegion() const
+	{
+		return this->base != nullptr ? this->base + GetRegionOffset() : this->mapped;
+	}
+};
+
+#endif
@@ -0,0 +1,328 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+#include <initializer_list>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "ShaderReflection.h"
+#include "GLStateCache.h"
+#include "StreamBuffer.h"
+
+// UNIFORM BUFFER OBJECTS (UBO)
+// Instead of setting uniforms one by one with glUniform, a shader can read a whole block of uniforms from a buffer:
+//		layout (std140) uniform Object { mat4 model; vec4 color; };
+// The data of the block is written into a buffer object and attached to the shader with glBindBufferRange.
+// The std140 layout fixes where every member of the block lives in the buffer, so we can write a C++ struct
+// with the same layout (a mirror struct) and copy it into the buffer as it is.
+// For more information on uniform buffers and the std140 rules please visit this site:
+// https://www.khronos.org/opengl/wiki/Interface_Block_(GLSL)#Memory_layout
+
+// C++ types with the std140 alignment of the GLSL type of the same name, used to build mirror structs.
+// NOTE: a Std140Vec3 takes 16 bytes, but in GLSL a float following a vec3 uses its last 4 bytes.
+//		 In that case declare the vec3 as "alignas(16) GLfloat name[3];" instead (GenerateStruct does this).
+struct alignas(8) Std140Vec2 { GLfloat x, y; };
+struct alignas(16) Std140Vec3 { GLfloat x, y, z; };
+struct alignas(16) Std140Vec4 { GLfloat x, y, z, w; };
+struct alignas(16) Std140IVec4 { GLint x, y, z, w; };
+struct alignas(8) Std140IVec2 { GLint x, y; };
+struct alignas(16) Std140IVec3 { GLint x, y, z; };
+struct alignas(8) Std140UVec2 { GLuint x, y; };
+struct alignas(16) Std140UVec3 { GLuint x, y, z; };
+struct alignas(16) Std140UVec4 { GLuint x, y, z, w; };
+// Matrices are stored as columns, every column is aligned like a vec4, even the vec2 columns of a mat2
+struct Std140Mat2 { Std140Vec4 columns[2]; };
+struct Std140Mat3 { Std140Vec4 columns[3]; };
+struct alignas(16) Std140Mat4 { GLfloat values[16]; };
+// Every element of an array is aligned to 16 bytes, even floats
+template <typename T> struct Std140ArrayElement { alignas(16) T value; };
+
+// Describes where a member of a mirror struct is, to check it against the program, see UNIFORM_BLOCK_MEMBER
+struct UniformBlockMember
+{
+	uint32_t id;
+	size_t offset;
+};
+
+// UNIFORM_BLOCK_MEMBER(Object, model) gives the id and the C++ offset of the member "model" of the struct Object
+#define UNIFORM_BLOCK_MEMBER(Struct, member) UniformBlockMember{ ShaderReflection::Id(#member), offsetof(Struct, member) }
+
+class UniformBlockLayout
+{
+public:
+	// Checks a mirror struct against the layout of a uniform block in a linked program.
+	// Every member has to be at the offset OpenGL uses, and the struct has to be at least as big as the block.
+	// Prints every difference and returns false if there was any.
+	static bool Validate(const ShaderReflection& reflection, uint32_t blockId, std::initializer_list<UniformBlockMember> members, size_t structSize)
+	{
+		const ShaderReflection::Resource* block = reflection.FindUniformBlock(blockId);
+		if (block == nullptr)
+		{
+			std::cout << "ERROR::UNIFORM_BUFFER::BLOCK_NOT_FOUND" << std::endl;
+			return false;
+		}
+
+		bool valid = true;
+		if (structSize < static_cast<size_t>(block->size))
+		{
+			std::cout << "ERROR::UNIFORM_BUFFER::STRUCT_TOO_SMALL " << reflection.GetName(*block) << " needs " << block->size
+				<< " bytes, the struct has " << structSize << std::endl;
+			valid = false;
+		}
+		for (const UniformBlockMember& member : members)
+		{
+			const ShaderReflection::Resource* uniform = FindMember(reflection, *block, member.id);
+			if (uniform == nullptr)
+			{
+				// Members the shader does not use are removed by the compiler, this is not an error
+				continue;
+			}
+			if (static_cast<size_t>(uniform->offset) != member.offset)
+			{
+				std::cout << "ERROR::UNIFORM_BUFFER::OFFSET_MISMATCH " << reflection.GetName(*uniform) << " is at " << uniform->offset
+					<< " in the shader and at " << member.offset << " in the struct" << std::endl;
+				valid = false;
+			}
+		}
+		return valid;
+	}
+
+	// Writes the C++ mirror struct of a uniform block, with padding wherever the std140 layout leaves a gap.
+	// Meant to be printed once and pasted into the code, then kept in check with Validate.
+	// Members of a named block ("Block.color") are written without the name of the block.
+	// Returns an empty string, after printing why, if a member has no C++ mirror type (structs, non square matrices...).
+	static std::string GenerateStruct(const ShaderReflection& reflection, uint32_t blockId, const std::string& structName)
+	{
+		const ShaderReflection::Resource* block = reflection.FindUniformBlock(blockId);
+		if (block == nullptr)
+		{
+			std::cout << "ERROR::UNIFORM_BUFFER::BLOCK_NOT_FOUND" << std::endl;
+			return std::string();
+		}
+
+		// The members of the block, in the order of their offsets
+		std::vector<const ShaderReflection::Resource*> members;
+		for (const ShaderReflection::Resource& uniform : reflection.uniforms)
+		{
+			if (uniform.blockIndex == block->location)
+			{
+				members.push_back(&uniform);
+			}
+		}
+		std::sort(members.begin(), members.end(), [](const ShaderReflection::Resource* a, const ShaderReflection::Resource* b)
+		{
+			return a->offset < b->offset;
+		});
+
+		std::string code = "struct " + structName + "\n{\n";
+		GLint offset = 0;
+		int paddings = 0;
+		for (size_t i = 0; i < members.size(); ++i)
+		{
+			const ShaderReflection::Resource* member = members[i];
+			const std::string name = GetMemberName(reflection, *block, *member);
+			const std::string type = GetTypeName(member->type);
+			if (type.empty() || name.find_first_of(".[") != std::string::npos)
+			{
+				std::cout << "ERROR::UNIFORM_BUFFER::UNSUPPORTED_MEMBER " << reflection.GetName(*member)
+					<< " cannot be mirrored, write the struct of " << reflection.GetName(*block) << " by hand" << std::endl;
+				return std::string();
+			}
+
+			const bool array = member->size > 1;
+			// Every std140 array element takes a multiple of 16 bytes, which is the size of Std140ArrayElement
+			const GLint elementSize = (GetTypeSize(member->type) + 15) / 16 * 16;
+			if (array && member->arrayStride != elementSize)
+			{
+				std::cout << "ERROR::UNIFORM_BUFFER::UNSUPPORTED_MEMBER " << reflection.GetName(*member) << " has an array stride of "
+					<< member->arrayStride << " bytes instead of " << elementSize << ", the block is not std140" << std::endl;
+				return std::string();
+			}
+
+			if (member->offset > offset)
+			{
+				code += "\tchar padding" + std::to_string(paddings++) + "[" + std::to_string(member->offset - offset) + "];\n";
+			}
+			GLint size = array ? member->arrayStride * member->size : GetTypeSize(member->type);
+			const char* scalar = GetVec3ScalarName(member->type);
+			if (!array && scalar != nullptr && i + 1 < members.size() && members[i + 1]->offset == member->offset + 12)
+			{
+				// A scalar is packed into the last 4 bytes of this vec3
+				code += "\talignas(16) " + std::string(scalar) + " " + name + "[3];\n";
+				size = 12;
+			}
+			else
+			{
+				code += "\t" + (array ? "Std140ArrayElement<" + type + ">" : type) + " " + name;
+				code += array ? "[" + std::to_string(member->size) + "];\n" : ";\n";
+			}
+			offset = member->offset + size;
+		}
+		if (block->size > offset)
+		{
+			code += "\tchar padding" + std::to_string(paddings) + "[" + std::to_string(block->size - offset) + "];\n";
+		}
+		return code + "};\n";
+	}
+
+private:
+	// The name of a member without the name of its block: "Block.color" is "color", a member of a block without
+	// instance name is already named "color". Arrays of blocks ("Block[1]") name their members "Block.color" too.
+	static std::string GetMemberName(const ShaderReflection& reflection, const ShaderReflection::Resource& block, const ShaderReflection::Resource& member)
+	{
+		std::string prefix = reflection.GetName(block);
+		prefix.resize(std::min(prefix.find('['), prefix.size()));
+		prefix += '.';
+		const std::string name = reflection.GetName(member);
+		return name.compare(0, prefix.size(), prefix) == 0 ? name.substr(prefix.size()) : name;
+	}
+
+	// The member of a block whose name, without the name of the block, has the given id
+	static const ShaderReflection::Resource* FindMember(const ShaderReflection& reflection, const ShaderReflection::Resource& block, uint32_t id)
+	{
+		for (const ShaderReflection::Resource& uniform : reflection.uniforms)
+		{
+			if (uniform.blockIndex == block.location && ShaderReflection::Id(GetMemberName(reflection, block, uniform).c_str()) == id)
+			{
+				return &uniform;
+			}
+		}
+		return nullptr;
+	}
+
+	// The C++ type of a member, empty if there is none
+	static std::string GetTypeName(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_FLOAT: return "GLfloat";
+		case GL_INT: case GL_BOOL: return "GLint";
+		case GL_UNSIGNED_INT: return "GLuint";
+		case GL_FLOAT_VEC2: return "Std140Vec2";
+		case GL_FLOAT_VEC3: return "Std140Vec3";
+		case GL_FLOAT_VEC4: return "Std140Vec4";
+		// Booleans take 4 bytes in a uniform block, like ints
+		case GL_INT_VEC2: case GL_BOOL_VEC2: return "Std140IVec2";
+		case GL_INT_VEC3: case GL_BOOL_VEC3: return "Std140IVec3";
+		case GL_INT_VEC4: case GL_BOOL_VEC4: return "Std140IVec4";
+		case GL_UNSIGNED_INT_VEC2: return "Std140UVec2";
+		case GL_UNSIGNED_INT_VEC3: return "Std140UVec3";
+		case GL_UNSIGNED_INT_VEC4: return "Std140UVec4";
+		case GL_FLOAT_MAT2: return "Std140Mat2";
+		case GL_FLOAT_MAT3: return "Std140Mat3";
+		case GL_FLOAT_MAT4: return "Std140Mat4";
+		default: return std::string();
+		}
+	}
+
+	// The size of the C++ type GetTypeName returns, which is 16 for a vec3
+	static GLint GetTypeSize(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_FLOAT: case GL_INT: case GL_BOOL: case GL_UNSIGNED_INT: return 4;
+		case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_BOOL_VEC2: case GL_UNSIGNED_INT_VEC2: return 8;
+		case GL_FLOAT_MAT2: return 32;
+		case GL_FLOAT_MAT3: return 48;
+		case GL_FLOAT_MAT4: return 64;
+		default: return 16;
+		}
+	}
+
+	// The scalar type of a 3 component vector, nullptr for other types
+	static const char* GetVec3ScalarName(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_FLOAT_VEC3: return "GLfloat";
+		case GL_INT_VEC3: case GL_BOOL_VEC3: return "GLint";
+		case GL_UNSIGNED_INT_VEC3: return "GLuint";
+		default: return nullptr;
+		}
+	}
+};
+
+// UNIFORM RING BUFFER
+// Giving every object its own uniform buffer means thousands of small buffers and one upload per object.
+// Instead, the per draw data of a whole frame is written into one big streaming buffer (see StreamBuffer.h):
+// every frame writes into its own region of the buffer, and every draw takes the next free piece of it (Allocate).
+// The pieces are attached to the shader with glBindBufferRange, which only needs an offset aligned to
+// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+//
+// Usage, every frame:
+//		ring.BeginFrame();
+//		for every object: allocation = ring.Allocate(sizeof(Object)); write the Object into allocation.data
+//		ring.EndFrame();
+//		for every object: ring.Bind(binding, allocation, sizeof(Object)); draw
+//		ring.Fence();
+// NOTE: without persistent mapping the buffer cannot be used for drawing while it is mapped,
+//		 so all the allocations of a frame are written before the draws.
+class UniformRing
+{
+public:
+	typedef StreamBuffer::Allocation Allocation;
+
+	// Creates a ring with room for frameSize bytes per frame, for the given number of frames in flight
+	UniformRing(GLsizeiptr frameSize, int frames = 3)
+		: stream(frameSize, frames, GetAlignment())
+	{
+	}
+
+	UniformRing(const UniformRing&) = delete;
+	UniformRing& operator=(const UniformRing&) = delete;
+
+	// Moves to the next region, waiting for the GPU only if it is still reading that region
+	void BeginFrame()
+	{
+		this->stream.BeginFrame();
+	}
+
+	// Takes the next size bytes of this frame's region. Returns data == nullptr if the region is full.
+	Allocation Allocate(GLsizeiptr size)
+	{
+		return this->stream.Allocate(size);
+	}
+
+	// Makes the region visible to the GPU so its allocations can be used for drawing
+	void EndFrame()
+	{
+		this->stream.EndFrame();
+	}
+
+	// Attaches an allocation to a uniform block binding point, see Shader::BindUniformBlock
+	void Bind(GLuint binding, const Allocation& allocation, GLsizeiptr size) const
+	{
+		GLStateCache::Global().BindBufferRange(GL_UNIFORM_BUFFER, binding, this->stream.GetBuffer(), allocation.offset, size);
+	}
+
+	// Call after the last draw using this frame's region, the region is reused once the GPU has passed this point
+	void Fence()
+	{
+		this->stream.Fence();
+	}
+
+	GLuint GetBuffer() const
+	{
+		return this->stream.GetBuffer();
+	}
+
+private:
+	StreamBuffer stream;
+
+	// Uniform blocks can only be attached at multiples of this offset
+	static GLsizeiptr GetAlignment()
+	{
+		GLint alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		return alignment;
+	}
+};
+
+#endif
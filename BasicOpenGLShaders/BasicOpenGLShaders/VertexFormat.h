@@ -0,0 +1,293 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <vector>
+#include <iostream>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "GLStateCache.h"
+#include "DirectStateAccess.h"
+#include "VertexLayout.h"
+
+// VERTEX FORMAT
+// glVertexAttribPointer sets the format of an attribute and the buffer it reads in the same call, so a vertex array belongs to its buffers:
+// meshes in different buffers need a vertex array each, or glVertexAttribPointer again for every attribute whenever the buffer changes,
+// and the driver validates the whole format again every time.
+// OpenGL 4.3 (or ARB_vertex_attrib_binding) separates the two: the format of every attribute (glVertexAttribFormat) and the binding point
+// it reads (glVertexAttribBinding) are set once, and the buffer, offset and stride of a binding point are set with glBindVertexBuffer,
+// a single call whatever the number of attributes reading from it.
+// A VertexFormat is one vertex array shared by every mesh with the same vertices: the formats are set when the bindings are added,
+// and every draw only changes the buffers of the binding points (BindVertexBuffer). The per vertex data and the per instance data
+// are two binding points of the same format, with their own stride and divisor.
+// Without vertex attrib binding (OpenGL 3.3) BindVertexBuffer calls glVertexAttribPointer again for the attributes of the binding point.
+// A binding point remembers its buffer and offset, binding the same ones again costs nothing.
+//
+// Usage:
+//		VertexFormat format;
+//		format.AddBinding<Vertex>(0, vertexAttributes);					locations 0 to N - 1
+//		format.AddBinding<Instance>(1, instanceAttributes, 2, 1);		locations from 2 on, advancing once per instance
+//		for every draw:
+//		format.BindVertexBuffer(0, vertexBuffer, vertexOffset);
+//		format.BindElementBuffer(indexBuffer);
+//		format.Bind();
+//		glDrawElements(...);
+class VertexFormat
+{
+public:
+	// Counts the buffer changes sent to OpenGL and the ones skipped because the binding point already had that buffer
+	struct Statistics
+	{
+		unsigned int issued;
+		unsigned int filtered;
+	};
+
+	VertexFormat()
+		: vertexArray(DirectStateAccess::CreateVertexArray()), elementBuffer(NONE), statistics()
+	{
+	}
+
+	~VertexFormat()
+	{
+		glDeleteVertexArrays(1, &this->vertexArray);
+		GLStateCache::Global().Forget(GL_VERTEX_ARRAY, this->vertexArray);
+	}
+
+	VertexFormat(const VertexFormat&) = delete;
+	VertexFormat& operator=(const VertexFormat&) = delete;
+
+	// True if the context can set the formats once and change the buffers with glBindVertexBuffer
+	static bool IsAttribBindingSupported()
+	{
+		return GLEW_VERSION_4_3 || GLEW_ARB_vertex_attrib_binding;
+	}
+
+	// Sets the attribute pointers again for every buffer change even if the context has vertex attrib binding, to compare both.
+	// Call before creating any format.
+	static void SetAttribBindingEnabled(bool enabled)
+	{
+		AttribBindingEnabled() = enabled;
+	}
+
+	// True if vertex attrib binding is used
+	static bool IsAttribBindingEnabled()
+	{
+		return AttribBindingEnabled() && IsAttribBindingSupported();
+	}
+
+	// Adds a binding point read by the attributes of Vertex, which take the locations from firstLocation on.
+	// With a divisor of 0 the attributes advance once per vertex, otherwise once every divisor instances.
+	// The binding point reads nothing until BindVertexBuffer gives it a buffer.
+	template <typename Vertex, size_t N>
+	void AddBinding(GLuint binding, const VertexAttribute (&attributes)[N], GLuint firstLocation = 0, GLuint divisor = 0)
+	{
+		if (HasBinding(binding))
+		{
+			std::cout << "ERROR::VERTEX_FORMAT::BINDING_ALREADY_ADDED " << binding << std::endl;
+			return;
+		}
+		const Binding added = { binding, VertexLayout<Vertex>::GetStride(), firstLocation, divisor,
+			std::vector<VertexAttribute>(attributes, attributes + N), NONE, 0 };
+		this->bindings.push_back(added);
+		if (!IsAttribBindingEnabled())
+		{
+			// Set with the buffer, by glVertexAttribPointer
+			return;
+		}
+
+		const bool direct = DirectStateAccess::IsEnabled();
+		if (direct)
+		{
+			glVertexArrayBindingDivisor(this->vertexArray, binding, divisor);
+		}
+		else
+		{
+			GLStateCache::Global().BindVertexArray(this->vertexArray);
+			glVertexBindingDivisor(binding, divisor);
+		}
+		for (size_t i = 0; i < N; ++i)
+		{
+			const VertexAttribute& attribute = attributes[i];
+			const GLuint location = firstLocation + static_cast<GLuint>(i);
+			if (direct)
+			{
+				if (attribute.integer)
+				{
+					glVertexArrayAttribIFormat(this->vertexArray, location, attribute.components, attribute.type, attribute.offset);
+				}
+				else
+				{
+					glVertexArrayAttribFormat(this->vertexArray, location, attribute.components, attribute.type, attribute.normalized, attribute.offset);
+				}
+				glVertexArrayAttribBinding(this->vertexArray, location, binding);
+				glEnableVertexArrayAttrib(this->vertexArray, location);
+			}
+			else
+			{
+				if (attribute.integer)
+				{
+					glVertexAttribIFormat(location, attribute.components, attribute.type, attribute.offset);
+				}
+				else
+				{
+					glVertexAttribFormat(location, attribute.components, attribute.type, attribute.normalized, attribute.offset);
+				}
+				glVertexAttribBinding(location, binding);
+				glEnableVertexAttribArray(location);
+			}
+		}
+	}
+
+	bool HasBinding(GLuint binding) const
+	{
+		return Find(binding) != nullptr;
+	}
+
+	// Makes a binding point read from offset bytes into a buffer, the formats of its attributes do not change
+	void BindVertexBuffer(GLuint binding, GLuint buffer, GLintptr offset = 0)
+	{
+		Binding* point = Find(binding);
+		if (point == nullptr)
+		{
+			std::cout << "ERROR::VERTEX_FORMAT::UNKNOWN_BINDING " << binding << std::endl;
+			return;
+		}
+		if (point->buffer == buffer && point->offset == offset)
+		{
+			this->statistics.filtered++;
+			return;
+		}
+		point->buffer = buffer;
+		point->offset = offset;
+		this->statistics.issued++;
+
+		if (IsAttribBindingEnabled())
+		{
+			if (DirectStateAccess::IsEnabled())
+			{
+				glVertexArrayVertexBuffer(this->vertexArray, binding, buffer, offset, point->stride);
+			}
+			else
+			{
+				GLStateCache::Global().BindVertexArray(this->vertexArray);
+				glBindVertexBuffer(binding, buffer, offset, point->stride);
+			}
+			return;
+		}
+
+		// Every attribute of the binding point is set again
+		GLStateCache& state = GLStateCache::Global();
+		state.BindVertexArray(this->vertexArray);
+		state.BindBuffer(GL_ARRAY_BUFFER, buffer);
+		for (size_t i = 0; i < point->attributes.size(); ++i)
+		{
+			const VertexAttribute& attribute = point->attributes[i];
+			const GLuint location = point->firstLocation + static_cast<GLuint>(i);
+			const GLvoid* pointer = reinterpret_cast<const GLvoid*>(offset + attribute.offset);
+			if (attribute.integer)
+			{
+				glVertexAttribIPointer(location, attribute.components, attribute.type, point->stride, pointer);
+			}
+			else
+			{
+				glVertexAttribPointer(location, attribute.components, attribute.type, attribute.normalized, point->stride, pointer);
+			}
+			glVertexAttribDivisor(location, point->divisor);
+			glEnableVertexAttribArray(location);
+		}
+	}
+
+	// The buffer the indices are read from
+	void BindElementBuffer(GLuint buffer)
+	{
+		if (this->elementBuffer == buffer)
+		{
+			this->statistics.filtered++;
+			return;
+		}
+		this->elementBuffer = buffer;
+		this->statistics.issued++;
+		DirectStateAccess::VertexArrayElementBuffer(this->vertexArray, buffer);
+	}
+
+	// Binds the vertex array for drawing
+	void Bind() const
+	{
+		GLStateCache::Global().BindVertexArray(this->vertexArray);
+	}
+
+	GLuint GetVertexArray() const
+	{
+		return this->vertexArray;
+	}
+
+	const Statistics& GetStatistics() const
+	{
+		return this->statistics;
+	}
+
+	void ResetStatistics()
+	{
+		this->statistics = Statistics();
+	}
+
+	void PrintStatistics() const
+	{
+		std::cout << "VERTEX::FORMAT " << this->statistics.issued << " buffer changes issued, " << this->statistics.filtered << " filtered"
+			<< (IsAttribBindingEnabled() ? "" : " (without vertex attrib binding, attribute pointers set again)") << std::endl;
+	}
+
+private:
+	// The buffer of a binding point before the first BindVertexBuffer, it never matches a real buffer
+	static const GLuint NONE = 0xFFFFFFFF;
+
+	struct Binding
+	{
+		GLuint index;
+		GLsizei stride;
+		GLuint firstLocation;
+		GLuint divisor;
+		// Kept to call glVertexAttribPointer again without vertex attrib binding
+		std::vector<VertexAttribute> attributes;
+		GLuint buffer;
+		GLintptr offset;
+	};
+
+	GLuint vertexArray;
+	GLuint elementBuffer;
+	std::vector<Binding> bindings;
+	Statistics statistics;
+
+	static bool& AttribBindingEnabled()
+	{
+		static bool enabled = true;
+		return enabled;
+	}
+
+	Binding* Find(GLuint binding)
+	{
+		for (Binding& point : this->bindings)
+		{
+			if (point.index == binding)
+			{
+				return &point;
+			}
+		}
+		return nullptr;
+	}
+
+	const Binding* Find(GLuint binding) const
+	{
+		for (const Binding& point : this->bindings)
+		{
+			if (point.index == binding)
+			{
+				return &point;
+			}
+		}
+		return nullptr;
+	}
+};
+
+#endif
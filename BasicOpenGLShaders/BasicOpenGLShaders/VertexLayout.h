@@ -0,0 +1,208 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "GLStateCache.h"
+#include "DirectStateAccess.h"
+
+// VERTEX LAYOUT
+// glVertexAttribPointer needs the number of components, the type, the normalization, the stride and the offset of every attribute.
+// Written by hand these are numbers such as 6 * sizeof(GLfloat) which have to be changed everywhere when the vertex changes,
+// and a wrong one is not an error, the shader just reads the wrong bytes.
+// Instead the vertices are described by a struct, and the attributes are worked out from the types of its members at compile time:
+//		struct Vertex { GLfloat position[3]; GLfloat color[3]; };
+//		constexpr VertexAttribute vertexAttributes[] = { VERTEX_ATTRIBUTE(Vertex, position), VERTEX_ATTRIBUTE(Vertex, color) };
+//		VertexLayout<Vertex>::Apply(vertexAttributes);		with the vertex array and the vertex buffer bound
+//		VertexLayout<Vertex>::Apply(vertexArray, vertexBuffer, vertexAttributes);		without binding them, see DirectStateAccess.h
+// The attributes get the locations 0, 1, 2... in the order they are listed, matching "layout (location = N)" in the vertex shader.
+// Per instance data (instanced rendering) is described the same way with its own struct, its attributes take the locations
+// after the ones of the vertex and advance once per instance instead of once per vertex (the divisor, see InstanceStream.h).
+// The stride is the size of the struct and the offsets are the offsets of the members, so changing the type of a member
+// (for example to a normalized or packed type, see VertexAttributeFormat) is the only change needed.
+
+// The format of one attribute, as given to glVertexAttribPointer
+struct VertexAttribute
+{
+	GLint components;
+	GLenum type;
+	GLboolean normalized;
+	// Integer attributes (int, ivec2... in the shader) are set up with glVertexAttribIPointer
+	bool integer;
+	GLuint offset;
+	GLuint size;
+};
+
+// VertexAttributeFormat<T> gives the format of a member of type T. Every type used in a vertex needs one.
+// components, type, normalized and integer are the values given to OpenGL, size is the size of T in bytes.
+template <typename T>
+struct VertexAttributeFormat
+{
+	static_assert(sizeof(T) == 0, "No vertex attribute format for this type, add a VertexAttributeFormat specialization");
+};
+
+template <typename T, GLenum Type, bool Integer>
+struct VertexComponentFormat
+{
+	static const GLint components = 1;
+	static const GLenum type = Type;
+	static const bool normalized = false;
+	static const bool integer = Integer;
+	static const size_t size = sizeof(T);
+};
+
+template <> struct VertexAttributeFormat<GLfloat> : VertexComponentFormat<GLfloat, GL_FLOAT, false> {};
+template <> struct VertexAttributeFormat<GLint> : VertexComponentFormat<GLint, GL_INT, true> {};
+template <> struct VertexAttributeFormat<GLuint> : VertexComponentFormat<GLuint, GL_UNSIGNED_INT, true> {};
+template <> struct VertexAttributeFormat<GLshort> : VertexComponentFormat<GLshort, GL_SHORT, true> {};
+template <> struct VertexAttributeFormat<GLushort> : VertexComponentFormat<GLushort, GL_UNSIGNED_SHORT, true> {};
+template <> struct VertexAttributeFormat<GLbyte> : VertexComponentFormat<GLbyte, GL_BYTE, true> {};
+template <> struct VertexAttributeFormat<GLubyte> : VertexComponentFormat<GLubyte, GL_UNSIGNED_BYTE, true> {};
+
+// An array is a vector: GLfloat[3] is a vec3
+template <typename T, size_t N>
+struct VertexAttributeFormat<T[N]>
+{
+	static_assert(VertexAttributeFormat<T>::components == 1 && N >= 1 && N <= 4, "A vertex attribute has 1 to 4 components");
+	static const GLint components = static_cast<GLint>(N);
+	static const GLenum type = VertexAttributeFormat<T>::type;
+	static const bool normalized = VertexAttributeFormat<T>::normalized;
+	static const bool integer = VertexAttributeFormat<T>::integer;
+	static const size_t size = N * VertexAttributeFormat<T>::size;
+};
+
+// Integer components read by the shader as floats in [0, 1] (unsigned) or [-1, 1] (signed), for example colors stored in bytes:
+//		Normalized<GLubyte, 4> color;		is a vec4 in the shader
+template <typename T, size_t N>
+struct Normalized
+{
+	T values[N];
+};
+
+template <typename T, size_t N>
+struct VertexAttributeFormat<Normalized<T, N>> : VertexAttributeFormat<T[N]>
+{
+	static_assert(VertexAttributeFormat<T>::integer, "Only integer components can be normalized");
+	static const bool normalized = true;
+	static const bool integer = false;
+};
+
+// Builds the VertexAttribute of a member. The checks are done at compile time: the member has to start at a multiple of 4 bytes
+// (OpenGL asks for offsets aligned to the size of the components, and many drivers are slower below 4 bytes)
+// and the format has to describe exactly the bytes of the member.
+template <typename T, size_t Offset>
+constexpr VertexAttribute MakeVertexAttribute()
+{
+	static_assert(Offset % 4 == 0, "Vertex attributes must start at a multiple of 4 bytes");
+	static_assert(VertexAttributeFormat<T>::size == sizeof(T), "The vertex attribute format does not match the size of the member");
+	return VertexAttribute{ VertexAttributeFormat<T>::components, VertexAttributeFormat<T>::type,
+		static_cast<GLboolean>(VertexAttributeFormat<T>::normalized ? GL_TRUE : GL_FALSE), VertexAttributeFormat<T>::integer,
+		static_cast<GLuint>(Offset), static_cast<GLuint>(sizeof(T)) };
+}
+
+// VERTEX_ATTRIBUTE(Vertex, position) gives the format and the offset of the member "position" of the struct Vertex
+#define VERTEX_ATTRIBUTE(Struct, member) MakeVertexAttribute<decltype(Struct::member), offsetof(Struct, member)>()
+
+template <typename Vertex>
+class VertexLayout
+{
+	static_assert(std::is_standard_layout<Vertex>::value, "A vertex struct must have a standard layout, offsetof needs it");
+	static_assert(sizeof(Vertex) % 4 == 0, "The size of a vertex (the stride) must be a multiple of 4 bytes");
+	// GL_MAX_VERTEX_ATTRIB_STRIDE is at least 2048
+	static_assert(sizeof(Vertex) <= 2048, "A vertex cannot be larger than 2048 bytes");
+
+public:
+	// The distance between two vertices in the buffer
+	static constexpr GLsizei GetStride()
+	{
+		return static_cast<GLsizei>(sizeof(Vertex));
+	}
+
+	// Checks that the attributes are inside the vertex and do not overlap, to be used with static_assert:
+	//		static_assert(VertexLayout<Vertex>::IsValid(vertexAttributes), "...");
+	template <size_t N>
+	static constexpr bool IsValid(const VertexAttribute (&attributes)[N])
+	{
+		for (size_t i = 0; i < N; ++i)
+		{
+			if (attributes[i].offset + attributes[i].size > sizeof(Vertex))
+			{
+				return false;
+			}
+			for (size_t j = i + 1; j < N; ++j)
+			{
+				if (attributes[i].offset < attributes[j].offset + attributes[j].size && attributes[j].offset < attributes[i].offset + attributes[i].size)
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// Sets up and enables the attributes firstLocation to firstLocation + N - 1 of the bound vertex array,
+	// reading from the buffer bound to GL_ARRAY_BUFFER. baseOffset is where the first vertex starts in the buffer.
+	// With a divisor of 0 the attributes advance once per vertex, otherwise once every divisor instances (glVertexAttribDivisor).
+	template <size_t N>
+	static void Apply(const VertexAttribute (&attributes)[N], GLintptr baseOffset = 0, GLuint firstLocation = 0, GLuint divisor = 0)
+	{
+		for (size_t i = 0; i < N; ++i)
+		{
+			const VertexAttribute& attribute = attributes[i];
+			const GLuint location = firstLocation + static_cast<GLuint>(i);
+			const GLvoid* pointer = reinterpret_cast<const GLvoid*>(baseOffset + attribute.offset);
+			if (attribute.integer)
+			{
+				glVertexAttribIPointer(location, attribute.components, attribute.type, GetStride(), pointer);
+			}
+			else
+			{
+				glVertexAttribPointer(location, attribute.components, attribute.type, attribute.normalized, GetStride(), pointer);
+			}
+			glVertexAttribDivisor(location, divisor);
+			glEnableVertexAttribArray(location);
+		}
+	}
+
+	// Same as Apply for the given vertex array and buffer. With direct state access they are not bound: the buffer is attached
+	// to the binding point firstLocation of the vertex array, and the attributes read from it with their offset in the vertex
+	// (glVertexArrayAttribFormat). Otherwise the vertex array and the buffer are bound and left bound.
+	template <size_t N>
+	static void Apply(GLuint vertexArray, GLuint buffer, const VertexAttribute (&attributes)[N], GLintptr baseOffset = 0, GLuint firstLocation = 0, GLuint divisor = 0)
+	{
+		if (!DirectStateAccess::IsEnabled())
+		{
+			GLStateCache& state = GLStateCache::Global();
+			state.BindVertexArray(vertexArray);
+			state.BindBuffer(GL_ARRAY_BUFFER, buffer);
+			Apply(attributes, baseOffset, firstLocation, divisor);
+			return;
+		}
+
+		const GLuint binding = firstLocation;
+		glVertexArrayVertexBuffer(vertexArray, binding, buffer, baseOffset, GetStride());
+		glVertexArrayBindingDivisor(vertexArray, binding, divisor);
+		for (size_t i = 0; i < N; ++i)
+		{
+			const VertexAttribute& attribute = attributes[i];
+			const GLuint location = firstLocation + static_cast<GLuint>(i);
+			if (attribute.integer)
+			{
+				glVertexArrayAttribIFormat(vertexArray, location, attribute.components, attribute.type, attribute.offset);
+			}
+			else
+			{
+				glVertexArrayAttribFormat(vertexArray, location, attribute.components, attribute.type, attribute.normalized, attribute.offset);
+			}
+			glVertexArrayAttribBinding(vertexArray, location, binding);
+			glEnableVertexArrayAttrib(vertexArray, location);
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,334 @@
+#ifndef VERTEX_QUANTIZE_H
+#define VERTEX_QUANTIZE_H
+
+#include <cmath>
+#include <array>
+#include <cfloat>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <iostream>
+#include <algorithm>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "VertexLayout.h"
+
+// COMPRESSED VERTEX FORMATS
+// Vertices stored as 32 bit floats are often much more precise than needed, and the GPU has to read every byte of them.
+// Smaller formats mean less memory and less bandwidth for every vertex drawn:
+//		- positions as half floats (GL_HALF_FLOAT, 2 bytes per component), precise to about 3 decimal digits
+//		- positions as 16 bit integers normalized to [-1, 1] (snorm16) inside the bounding box of the mesh,
+//		  the vertex shader brings them back with a scale and an offset (QUANTIZED_POSITION in core.vs)
+//		- colors as 8 bit integers normalized to [0, 1] (unorm8), which is the precision of the screen anyway
+//		- normals packed into 32 bits, 10 bits for each of x, y and z (GL_INT_2_10_10_10_REV)
+// The types below are used as members of a vertex struct (see VertexLayout.h), and VertexQuantizer converts float data into them,
+// measuring the error of the conversion against the error the format allows.
+// Components are used in fours (Half[4], Normalized<GLshort, 4>) so every attribute keeps the 4 byte alignment,
+// the fourth component of a position is ignored by a vec3 in the shader.
+
+// A 16 bit float, IEEE 754 binary16
+struct Half
+{
+	GLushort bits;
+};
+
+// A normal (or tangent) packed into 10 bits for each of x, y, z and 2 bits for w, every value normalized to [-1, 1]
+struct PackedNormal
+{
+	GLuint bits;
+};
+
+template <> struct VertexAttributeFormat<Half>
+{
+	static const GLint components = 1;
+	static const GLenum type = GL_HALF_FLOAT;
+	static const bool normalized = false;
+	static const bool integer = false;
+	static const size_t size = sizeof(Half);
+};
+
+template <> struct VertexAttributeFormat<PackedNormal>
+{
+	static const GLint components = 4;
+	static const GLenum type = GL_INT_2_10_10_10_REV;
+	static const bool normalized = true;
+	static const bool integer = false;
+	static const size_t size = sizeof(PackedNormal);
+};
+
+// How far the converted values are from the original ones, and how far the format allows them to be
+struct QuantizationError
+{
+	// The largest and the root mean square difference of a component
+	double maxError;
+	double rmsError;
+	// The largest difference the rounding of the format can cause
+	double bound;
+	size_t count;
+};
+
+class VertexQuantizer
+{
+public:
+	// The scale and offset bringing snorm16 positions back to the original coordinates: position = value * scale + offset
+	struct PositionTransform
+	{
+		GLfloat scale[3];
+		GLfloat offset[3];
+	};
+
+	// Rounds a float to the nearest half float (ties to even), values too large become infinity
+	static Half ToHalf(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		const uint32_t sign = (bits >> 16) & 0x8000;
+		const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+		uint32_t mantissa = bits & 0x7FFFFF;
+
+		// Infinity and not a number
+		if (((bits >> 23) & 0xFF) == 0xFF)
+		{
+			return Half{ static_cast<GLushort>(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0)) };
+		}
+		if (exponent >= 31)
+		{
+			return Half{ static_cast<GLushort>(sign | 0x7C00) };
+		}
+
+		// Too small for the exponent of a half float, stored without the implicit leading 1 (subnormal) or as zero
+		uint32_t shift = 13;
+		uint32_t half = sign | (static_cast<uint32_t>(std::max(exponent, 0)) << 10);
+		if (exponent <= 0)
+		{
+			if (exponent < -10)
+			{
+				return Half{ static_cast<GLushort>(sign) };
+			}
+			mantissa |= 0x800000;
+			shift = static_cast<uint32_t>(14 - exponent);
+		}
+		half |= mantissa >> shift;
+
+		// Round to nearest, ties to even. A carry into the exponent gives the next power of two, or infinity.
+		const uint32_t remainder = mantissa & ((1u << shift) - 1);
+		const uint32_t halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1) != 0))
+		{
+			half++;
+		}
+		return Half{ static_cast<GLushort>(half) };
+	}
+
+	static float FromHalf(Half value)
+	{
+		const uint32_t sign = static_cast<uint32_t>(value.bits & 0x8000) << 16;
+		const uint32_t exponent = (value.bits >> 10) & 0x1F;
+		const uint32_t mantissa = value.bits & 0x3FF;
+		if (exponent == 0)
+		{
+			const float subnormal = std::ldexp(static_cast<float>(mantissa), -24);
+			return sign != 0 ? -subnormal : subnormal;
+		}
+		const uint32_t bits = sign | (exponent == 31 ? 0x7F800000 : (exponent - 15 + 127) << 23) | (mantissa << 13);
+		float result;
+		memcpy(&result, &bits, sizeof(result));
+		return result;
+	}
+
+	// [-1, 1] to a 16 bit integer, and back the way OpenGL does it
+	static GLshort ToSnorm16(float value)
+	{
+		return static_cast<GLshort>(std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+	}
+
+	static float FromSnorm16(GLshort value)
+	{
+		return std::max(value / 32767.0f, -1.0f);
+	}
+
+	// [0, 1] to an 8 bit integer, and back
+	static GLubyte ToUnorm8(float value)
+	{
+		return static_cast<GLubyte>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+	}
+
+	static float FromUnorm8(GLubyte value)
+	{
+		return value / 255.0f;
+	}
+
+	// Packs x, y and z in [-1, 1] into 10 bits each, and w into the last 2 bits
+	static PackedNormal PackNormal(float x, float y, float z, float w = 0.0f)
+	{
+		const float values[] = { x, y, z };
+		GLuint bits = 0;
+		for (int i = 0; i < 3; ++i)
+		{
+			const long component = std::lround(std::min(std::max(values[i], -1.0f), 1.0f) * 511.0f);
+			bits |= (static_cast<GLuint>(component) & 0x3FF) << (10 * i);
+		}
+		bits |= (static_cast<GLuint>(std::lround(std::min(std::max(w, -1.0f), 1.0f))) & 0x3) << 30;
+		return PackedNormal{ bits };
+	}
+
+	// Unpacks one of the three 10 bit components (0 for x, 1 for y, 2 for z)
+	static float UnpackNormal(PackedNormal normal, int component)
+	{
+		// Move the 10 bits to the top of a signed integer and back, to extend the sign
+		const int32_t value = static_cast<int32_t>(normal.bits << (22 - 10 * component)) >> 22;
+		return std::max(value / 511.0f, -1.0f);
+	}
+
+	// The transform which fits the bounding box of the positions (3 floats each) into [-1, 1]
+	static PositionTransform GetPositionTransform(const GLfloat (*positions)[3], size_t count)
+	{
+		PositionTransform transform;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float minimum = count > 0 ? positions[0][axis] : 0.0f;
+			float maximum = minimum;
+			for (size_t i = 1; i < count; ++i)
+			{
+				minimum = std::min(minimum, positions[i][axis]);
+				maximum = std::max(maximum, positions[i][axis]);
+			}
+			transform.offset[axis] = (minimum + maximum) * 0.5f;
+			// A flat axis still needs a scale which is not 0
+			transform.scale[axis] = maximum > minimum ? (maximum - minimum) * 0.5f : 1.0f;
+		}
+		return transform;
+	}
+
+	// The original coordinates of a snorm16 position, as the vertex shader computes them
+	static std::array<GLfloat, 3> GetPosition(const Normalized<GLshort, 4>& position, const PositionTransform& transform)
+	{
+		std::array<GLfloat, 3> result;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			result[axis] = FromSnorm16(position.values[axis]) * transform.scale[axis] + transform.offset[axis];
+		}
+		return result;
+	}
+
+	// CONVERSION
+	// Every function converts count float values into a member of count vertices, and returns the error of the conversion.
+	// member is the member to write, for example &Vertex::position.
+
+	// Positions as half floats
+	template <typename Vertex>
+	static QuantizationError QuantizePositions(const GLfloat (*positions)[3], size_t count, Vertex* vertices, Half (Vertex::*member)[4])
+	{
+		QuantizationError error = QuantizationError();
+		for (size_t i = 0; i < count; ++i)
+		{
+			Half* half = vertices[i].*member;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				half[axis] = ToHalf(positions[i][axis]);
+				// A half float has 11 significant bits, the rounding is at most half of the last one
+				const double magnitude = std::fabs(positions[i][axis]);
+				const int exponent = magnitude > 0.0 ? std::ilogb(magnitude) : -14;
+				error.bound = std::max(error.bound, std::ldexp(1.0, std::max(exponent, -14) - 11));
+				AddError(error, positions[i][axis], FromHalf(half[axis]));
+			}
+			half[3] = ToHalf(1.0f);
+		}
+		return Finish(error);
+	}
+
+	// Positions as snorm16 inside the bounding box, transform is the one given to the vertex shader
+	template <typename Vertex>
+	static QuantizationError QuantizePositions(const GLfloat (*positions)[3], size_t count, Vertex* vertices,
+		Normalized<GLshort, 4> Vertex::*member, PositionTransform& transform)
+	{
+		transform = GetPositionTransform(positions, count);
+		QuantizationError error = QuantizationError();
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			// One step of the format is 1 / 32767 of the half size of the box, the rounding is at most half of that.
+			// The transform is computed with floats, which adds their own rounding for values as large as the box.
+			const double magnitude = std::fabs(transform.offset[axis]) + transform.scale[axis];
+			error.bound = std::max(error.bound, transform.scale[axis] / 32767.0 * 0.5 + magnitude * FLOAT_ROUNDING);
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			GLshort* values = (vertices[i].*member).values;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				values[axis] = ToSnorm16((positions[i][axis] - transform.offset[axis]) / transform.scale[axis]);
+				AddError(error, positions[i][axis], FromSnorm16(values[axis]) * transform.scale[axis] + transform.offset[axis]);
+			}
+			values[3] = 32767;
+		}
+		return Finish(error);
+	}
+
+	// Colors (red, green, blue in [0, 1]) as unorm8, alpha is 1
+	template <typename Vertex>
+	static QuantizationError QuantizeColors(const GLfloat (*colors)[3], size_t count, Vertex* vertices, Normalized<GLubyte, 4> Vertex::*member)
+	{
+		QuantizationError error = QuantizationError();
+		error.bound = 0.5 / 255.0 + FLOAT_ROUNDING;
+		for (size_t i = 0; i < count; ++i)
+		{
+			GLubyte* values = (vertices[i].*member).values;
+			for (int channel = 0; channel < 3; ++channel)
+			{
+				values[channel] = ToUnorm8(colors[i][channel]);
+				AddError(error, std::min(std::max(colors[i][channel], 0.0f), 1.0f), FromUnorm8(values[channel]));
+			}
+			values[3] = 255;
+		}
+		return Finish(error);
+	}
+
+	// Normals (unit vectors) packed into 2_10_10_10
+	template <typename Vertex>
+	static QuantizationError QuantizeNormals(const GLfloat (*normals)[3], size_t count, Vertex* vertices, PackedNormal Vertex::*member)
+	{
+		QuantizationError error = QuantizationError();
+		error.bound = 0.5 / 511.0 + FLOAT_ROUNDING;
+		for (size_t i = 0; i < count; ++i)
+		{
+			PackedNormal& normal = vertices[i].*member;
+			normal = PackNormal(normals[i][0], normals[i][1], normals[i][2]);
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				AddError(error, normals[i][axis], UnpackNormal(normal, axis));
+			}
+		}
+		return Finish(error);
+	}
+
+	// Prints the error of a conversion, and whether it stayed inside the bound of the format
+	static void PrintReport(const std::string& name, const QuantizationError& error)
+	{
+		const bool inside = error.maxError <= error.bound;
+		std::cout << (inside ? "VERTEX::QUANTIZE " : "ERROR::VERTEX::QUANTIZE::OUT_OF_BOUNDS ") << name << ": " << error.count
+			<< " values, max error " << error.maxError << ", rms error " << error.rmsError << ", bound " << error.bound << std::endl;
+	}
+
+private:
+	// The conversions are computed with floats, every one of them can be off by a few times the precision of a float
+	static constexpr double FLOAT_ROUNDING = 4.0 * FLT_EPSILON;
+
+	static void AddError(QuantizationError& error, double expected, double actual)
+	{
+		const double difference = std::fabs(expected - actual);
+		error.maxError = std::max(error.maxError, difference);
+		// The sum of the squares until Finish
+		error.rmsError += difference * difference;
+		error.count++;
+	}
+
+	static QuantizationError Finish(QuantizationError error)
+	{
+		error.rmsError = error.count > 0 ? std::sqrt(error.rmsError / error.count) : 0.0;
+		return error;
+	}
+};
+
+#endif
@@ -16,12 +16,54 @@ layout (location = 1) in vec3 color;
 // The output color from vertex shader which will feed into fragment shader
 out vec3 ourColor;
 
+#ifdef QUANTIZED_POSITION
+// The positions are stored as 16 bit integers normalized to [-1, 1] inside the bounding box of the mesh (see VertexQuantize.h),
+// the scale and the offset of the box bring them back to the original coordinates
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+#endif
+
+#ifdef INSTANCED
+// Per instance attributes, they advance once per instance instead of once per vertex (see InstanceStream.h):
+// the offset of the instance in xyz and its scale in w, and a color multiplying the color of the vertex
+layout (location = 2) in vec4 instanceTransform;
+layout (location = 3) in vec4 instanceColor;
+#endif
+
+#ifdef OBJECT_UNIFORMS
+// The same values for a single object, set with glUniform before every draw
+uniform vec4 objectTransform;
+uniform vec4 objectColor;
+#endif
+
+#ifdef OBJECT_BLOCK
+// The same values read from a uniform block, every draw attaches its own part of a buffer to it (see UniformBuffer.h)
+layout (std140) uniform Object
+{
+	vec4 objectTransform;
+	vec4 objectColor;
+};
+#endif
+
 void main()
 {
 	// gl_Position is inbuilt vertex shader output variable of type vec4.
 	// In our case we store the position of the vertex in the variable
-	gl_Position = vec4(position, 1.0);
+#ifdef QUANTIZED_POSITION
+	vec3 vertexPosition = position * positionScale + positionOffset;
+#else
+	vec3 vertexPosition = position;
+#endif
 
+#ifdef INSTANCED
+	gl_Position = vec4(vertexPosition * instanceTransform.w + instanceTransform.xyz, 1.0);
+	ourColor = color * instanceColor.rgb;
+#elif defined(OBJECT_UNIFORMS) || defined(OBJECT_BLOCK)
+	gl_Position = vec4(vertexPosition * objectTransform.w + objectTransform.xyz, 1.0);
+	ourColor = color * objectColor.rgb;
+#else
+	gl_Position = vec4(vertexPosition, 1.0);
 	// store the color in ourColor output variable
 	ourColor = color;
+#endif
 }
\ No newline at end of file
@@ -1,4 +1,8 @@
 #include <iostream>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <vector>
 
 // We are using the glew32s.lib
 // Thus we have a define statement
@@ -11,10 +15,45 @@
 #include <GLFW/glfw3.h>
 
 #include "Shader.h"
+#include "EmbeddedShaders.h"
+#include "VertexLayout.h"
+#include "VertexQuantize.h"
+#include "MeshOptimizer.h"
+#include "InstanceStream.h"
+#include "BufferArena.h"
+#include "DirectStateAccess.h"
+#include "VertexFormat.h"
 
 // Variables for the Height and width of the window
 const GLint WIDTH = 800, HEIGHT = 600;
 
+// The data of one vertex, as it is stored in the vertex buffer: 12 bytes instead of the 24 of six floats.
+// The position is a 16 bit integer per axis inside the bounding box of the mesh (the shader is built with QUANTIZED_POSITION),
+// and the color is a byte per channel, see VertexQuantize.h
+struct Vertex
+{
+	Normalized<GLshort, 4> position;
+	Normalized<GLubyte, 4> color;
+};
+
+// The attributes of the vertex shader (core.vs), in the order of their locations: position is location 0 and color is location 1
+constexpr VertexAttribute vertexAttributes[] = { VERTEX_ATTRIBUTE(Vertex, position), VERTEX_ATTRIBUTE(Vertex, color) };
+static_assert(VertexLayout<Vertex>::IsValid(vertexAttributes), "The vertex attributes overlap or do not fit in Vertex");
+
+// The data of one copy of the triangle (an instance), streamed every frame: its offset and scale, and a color multiplying the vertex colors.
+// The shader is built with INSTANCED, its instance attributes are the locations 2 and 3, after the ones of Vertex.
+struct Instance
+{
+	GLfloat transform[4];
+	Normalized<GLubyte, 4> color;
+};
+
+constexpr VertexAttribute instanceAttributes[] = { VERTEX_ATTRIBUTE(Instance, transform), VERTEX_ATTRIBUTE(Instance, color) };
+static_assert(VertexLayout<Instance>::IsValid(instanceAttributes), "The instance attributes overlap or do not fit in Instance");
+
+// The triangle is drawn as a grid of INSTANCE_GRID x INSTANCE_GRID instances, with a single draw call
+const int INSTANCE_GRID = 3;
+
 // SHADERS
 // Shader is a type of computer program that is created by the user.
 // These programs perform a variety of specialized functions in various fields of graphics special effects
@@ -95,19 +134,69 @@ int main()
 	// The next two parameters specify the height and the width of the viewport.
 	// We use the variables screenWidth and screenHeight, in which we stored the value of width and height of the window,
 	// using the function glfwGetFramebufferSize above.
-	glViewport(0, 0, screenWidth, screenHeight);
-
-	Shader ourShader("core.vs", "core.frag");
+	// The bindings and other states are changed through the state cache, which skips the calls that would not change anything.
+	// Every change has to go through it, so it knows what is bound, see GLStateCache.h
+	GLStateCache& state = GLStateCache::Global();
+	state.Viewport(0, 0, screenWidth, screenHeight);
+
+	// Let the driver compile our shaders on its own threads, if it supports it
+	Shader::EnableParallelCompile();
+
+	// Measure how long it takes to submit the shader, this is the startup cost the main thread pays for it.
+	// Run the program twice to compare a cold start (cache miss) with a warm start (cache hit).
+	// Deleting the shader_cache folder or updating the driver gives the cold and invalidated timings again,
+	// VertexBenchmark --cache measures all three for many programs in a single run.
+	// The shader is created in the asynchronous mode, so the constructor does not wait for the driver to finish compiling.
+	// Shaders baked into shaders.pack by the ShaderBake project are created from the archive without reading their files.
+	// Without the archive the sources embedded in the program are used (EmbeddedShaders.h), so the program
+	// also runs from another working directory. Debug builds read core.vs and core.frag when they are there, for hot reload.
+	auto shaderStart = std::chrono::high_resolution_clock::now();
+	ShaderArchive archive;
+	std::unique_ptr<Shader> shader(archive.Open("shaders.pack")
+		? new Shader(archive, "core.vs", "core.frag", { "QUANTIZED_POSITION", "INSTANCED" }, true)
+		: new Shader(EmbeddedShaders::core_vs, EmbeddedShaders::core_frag, { "QUANTIZED_POSITION", "INSTANCED" }, true));
+	Shader& ourShader = *shader;
+	auto shaderEnd = std::chrono::high_resolution_clock::now();
+
+	const char* cacheStatusNames[] = { "disabled", "miss", "hit", "invalidated" };
+	std::cout << "Shader core.vs/core.frag submitted in "
+		<< std::chrono::duration<double, std::milli>(shaderEnd - shaderStart).count() << " ms"
+		<< " (program cache " << cacheStatusNames[ourShader.GetCacheStatus()] << ", "
+		<< ShaderSource::GetStatistics().bytes << " source bytes read in "
+		<< ShaderSource::GetStatistics().microseconds << " us)" << std::endl;
+
+	// Recompile the shader whenever core.vs or core.frag is saved, without restarting the program
+	ourShader.EnableHotReload();
 
 	// The vertices of the triangle we want to display on the screen
-	GLfloat vertices[] =
+	const GLfloat positions[][3] =
 	{
-		// POSITION				// COLOR
-		-0.5f, -0.5f, 0.0f,		1.0f, 0.0f, 0.0f,
-		0.5, -0.5f, 0.0f,		0.0f, 1.0f, 0.0f,
-		0.0f, 0.5f, 0.0f,		0.0f, 0.0f, 1.0f
+		{ -0.5f, -0.5f, 0.0f },
+		{ 0.5, -0.5f, 0.0f },
+		{ 0.0f, 0.5f, 0.0f }
+	};
+	const GLfloat colors[][3] =
+	{
+		{ 1.0f, 0.0f, 0.0f },
+		{ 0.0f, 1.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f }
 	};
 
+	// Convert them into the compressed Vertex, and print how much precision the conversion lost
+	Vertex vertices[3];
+	VertexQuantizer::PositionTransform positionTransform;
+	VertexQuantizer::PrintReport("position snorm16", VertexQuantizer::QuantizePositions(positions, 3, vertices, &Vertex::position, positionTransform));
+	VertexQuantizer::PrintReport("color unorm8", VertexQuantizer::QuantizeColors(colors, 3, vertices, &Vertex::color));
+
+	// INDEXED GEOMETRY
+	// Turn the three vertices per triangle into unique vertices and an index buffer, then order the triangles and the vertices
+	// for the vertex cache of the GPU, see MeshOptimizer.h. A single triangle gains nothing, a real mesh gains a lot.
+	std::vector<Vertex> meshVertices(vertices, vertices + 3);
+	std::vector<GLuint> indices = MeshOptimizer::Weld(meshVertices);
+	MeshOptimizer::PrintStatistics("before", MeshOptimizer::AnalyzeVertexCache(indices, meshVertices.size()));
+	MeshOptimizer::Optimize(meshVertices, indices, [&positionTransform](const Vertex& vertex) { return VertexQuantizer::GetPosition(vertex.position, positionTransform); });
+	MeshOptimizer::PrintStatistics("after", MeshOptimizer::AnalyzeVertexCache(indices, meshVertices.size()));
+
 	// VERTEX ARRAY OBJECTS (VAO)
 	// The vertex array object is a special type of object that encapsulates all the data that is associated
 	// with the vertex processors. Instead of containing the actual data, it holds the references to the vertex
@@ -125,81 +214,59 @@ int main()
 	// and provides same access functions to reference the arrays, which are used in the vertex arrays, such as
 	// glVertexPointer(), glNormalPointer(), glTexCoordPointer(), etc.
 
-	// Create variables for Vertex Buffer Objects (VBO) and Vertex Array Objects (VAO)
-	GLuint VBO, VAO;
-
-	// Generate the vertex array object names by calling the function glGenVertexArrays function.
-	// The first parameter specifies the number of vertex array object names to generate
-	// The second parameter specifies an array in which generated vertex array object names are stored (in our case VAO)
-	glGenVertexArrays(1, &VAO);
-	// Generate the vertex buffer object names by calling the function glGenBuffers function.
-	// The first parameter specifies the number of vertex buffer object names to generate
-	// The second parameter specifies an array in which generated vertex buffer object names are stores (in our case VBO)
-	glGenBuffers(1, &VBO);
-
-	// Activate the vertex array created (in our case VAO) active, creating it if necessary
-	glBindVertexArray(VAO);
-
-	// Activate the vertex buffer created (in our case VBO) active, creating it if necessary
-	// Kind of like:
-	// if (opengl->buffers[buffer] == null)
-	//	   opengl->buffers[buffer] = new Buffer()
-	// opengl->current_array_buffer = opengl->buffers[buffer]
-	// The first parameter is the target to which the buffer is bound
-	// The list of the targets can be found on this site:
-	// https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glBindBuffer.xhtml
-	// The second parameter is name of the buffer object we want to bind to (in our case VBO)
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	// The glBufferData creates a new data store for the object buffer
-	// The first parameter is the target to which the buffer object is bound.
-	// The list of the parameter can be found on this site:
-	// https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glBufferData.xhtml
-	// The second parameter is the size of the buffer object data in bytes.
-	// In our case the data is vertices, so we pass in sizeof(vertices) for the size of the data
-	// The third parameter is the pointer to the data that will be stored in the data store.
-	// The last parameter specifies the usage of the data stored in the buffer.
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-	// Define an array of generic vertex attribute data.
-	// The function specifies the format and the source buffer of a vertex attribute that is used when rendering something
-	// The first parameter of the function is the index which specifies the index of the generic vertex attribute to be modified
-	// The index location is specified in the vertex shader.
-	// The second parameter specifies the number of components per generic vertex attribute,
-	// in our case the vertex component has 3 co-ordinates value, defining the position of the vertex.
-	// The thrid parameter specifies the type of each component in the array, in our case GL_FLOAT
-	// The next parameter specifies whether the data values are normalized or not. If the value of this parameter is GL_TRUE,
-	// it indicates the values are stored in integer format and mapped to the range [-1, 1] for signed value or [0, 1] (for unsigned value)
-	// The fourth parameter is the stride which specifies the byte offset between consecutive generic vertex attribute (position).
-	// The last parameter specifies the offset of the first component of the generic vertex attribute in the array data store
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid*)0);
-	// Enable the generic vertex attribute array created above using the the function glEnableVertexAttributeArray,
-	// passing in the index of the vertex attribute array
-	glEnableVertexAttribArray(0);
-
-	// Define an array of generic vertex attribute data.
-	// The function specifies the format and the source buffer of a vertex attribute that is used when rendering something
-	// The first parameter of the function is the index which specifies the index of the generic vertex attribute to be modified
-	// The index location is specified in the vertex shader.
-	// The second parameter specifies the number of components per generic vertex attribute,
-	// in our case the vertex component has 3 co-ordinates value, defining the color of the vertex.
-	// The thrid parameter specifies the type of each component in the array, in our case GL_FLOAT
-	// The next parameter specifies whether the data values are normalized or not. If the value of this parameter is GL_TRUE,
-	// it indicates the values are stored in integer format and mapped to the range [-1, 1] for signed value or [0, 1] (for unsigned value)
-	// The fourth parameter is the stride which specifies the byte offset between consecutive generic vertex attribute (position).
-	// The last parameter specifies the offset of the first component of the generic vertex attribute in the array data store
-	// In our case the first instance of color attribute appears after 3 co-ordinate values which define the position.
-	// Thus we would require to skip the 3 float values. So, we set the offset accordingly
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid *)(3 * sizeof(GLfloat)));
-	// Enable the generic vertex attribute array created above using the the function glEnableVertexAttributeArray,
-	// passing in the index of the vertex attribute array
-	glEnableVertexAttribArray(1);
-
-	// Unbind the buffer previously bound by passing in 0 to the glBindBuffer function.
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	// Unbind the existing vertex array object binding by passing in 0 to the glBindVertexArray function.
-	// NOTE: we unbind the vertex array here for later use
-	//		 as soon as we want to draw an object, we simply bind the VAO with preferred settings before drawing the object
-	glBindVertexArray(0);
+	// ELEMENT BUFFER OBJECTS (EBO)
+	// The element buffer holds the indices of the vertices of every triangle, so a vertex used by several triangles is stored once.
+	// Its binding is part of the state of the vertex array, binding the VAO is enough to draw with it.
+
+	// BUFFER ARENA
+	// Instead of a vertex buffer and an element buffer of its own, every mesh takes a range of the large buffers of an arena,
+	// shared by all the meshes, see BufferArena.h. The arena creates buffers whose data store has a fixed size (glBufferStorage),
+	// and writes the data of every mesh into its range with glBufferSubData. The vertices start at a whole number of vertices,
+	// the indices at a whole number of indices.
+	// The arena lives in a unique_ptr so its buffers can be deleted before the context is destroyed.
+	// The application has a single small mesh, so its pages are 4 KB instead of the default 16 MB.
+	std::unique_ptr<BufferArena> arena(new BufferArena(4 * 1024));
+	const BufferArena::Handle vertexData = arena->Allocate(meshVertices.size() * sizeof(Vertex), sizeof(Vertex), meshVertices.data());
+	const BufferArena::Handle indexData = arena->Allocate(indices.size() * sizeof(GLuint), sizeof(GLuint), indices.data());
+
+	// DIRECT STATE ACCESS
+	// With OpenGL 3.3 an object is edited while it is bound: the VAO is bound, then the vertex buffer is bound to GL_ARRAY_BUFFER
+	// and glVertexAttribPointer reads that binding, then both are unbound so later code does not change them by accident.
+	// With OpenGL 4.5 (direct state access) the VAO is edited by its name, nothing is bound or unbound.
+	// DirectStateAccess.h and VertexFormat.h use it when the driver has it, and bind the objects otherwise.
+	// For more information please visit this site:
+	// https://www.khronos.org/opengl/wiki/Direct_State_Access
+	if (!DirectStateAccess::IsSupported())
+	{
+		std::cout << "GL::DIRECT_STATE_ACCESS not supported, objects are bound to be edited" << std::endl;
+	}
+
+	// VERTEX FORMAT
+	// glVertexAttribPointer ties the format of the attributes to the buffer they read, so every mesh would need its own VAO.
+	// With OpenGL 4.3 (vertex attrib binding) the formats are set once in a VAO shared by every mesh with the same Vertex,
+	// and a draw only tells a binding point which buffer to read (glBindVertexBuffer), see VertexFormat.h.
+	// The vertices are binding point 0, the instances binding point 1. The format lives in a unique_ptr like the arena,
+	// its VAO is deleted before the context is destroyed.
+	std::unique_ptr<VertexFormat> format(new VertexFormat());
+
+	// Define the arrays of generic vertex attribute data, one for every member of Vertex.
+	// For every attribute the format gives: the index of the attribute (the location specified in the vertex shader),
+	// the number of components (3 for a position), the type of each component (GL_FLOAT), whether integer values are normalized
+	// to the range [-1, 1] or [0, 1], the offset of the attribute in the vertex, and the binding point it reads from.
+	// The stride (the byte offset between consecutive vertices, sizeof(Vertex)) belongs to the binding point.
+	// All of these come from the members of Vertex, see VertexLayout.h. Then every attribute array is enabled.
+	format->AddBinding<Vertex>(0, vertexAttributes);
+	// The instance attributes take the locations 2 and 3 and advance once per instance (a divisor of 1)
+	format->AddBinding<Instance>(1, instanceAttributes, 2, 1);
+
+	// The per instance data, written again every frame into a buffer with a region per frame in flight, see InstanceStream.h
+	// It lives in a unique_ptr like the arena, its buffer is deleted before the context is destroyed.
+	std::unique_ptr<InstanceStream<Instance>> stream(new InstanceStream<Instance>(INSTANCE_GRID * INSTANCE_GRID));
+	InstanceStream<Instance>& instanceStream = *stream;
+
+	// The attribute locations above have to match the "layout (location = N)" of core.vs.
+	// Once the shader has been linked we check the VAO against the attributes the program actually reads.
+	bool vertexArrayChecked = false;
 
 	// This is the game loop, the game logic and render part goes in here.
 	// It checks if the created window is still open, and keeps performing the specified operations until the window is closed
@@ -208,6 +275,13 @@ int main()
 		// Checking for events/inputs
 		glfwPollEvents();
 
+		// Start counting the uniform uploads and the state changes of this frame from zero
+		Shader::ResetUniformStatistics();
+		state.ResetStatistics();
+
+		// Swap in the reloaded shader if its files were edited, this is the frame boundary where it is safe to do so
+		ourShader.Update();
+
 		// handle game object
 
 		// render here
@@ -220,27 +294,89 @@ int main()
 		glClear(GL_COLOR_BUFFER_BIT);
 
 		// Draw OpenGL stuff
-		// Use the current shader
-		ourShader.Use();
-		// Bind the VAO here for the purpose of drawing using the settings required
-		glBindVertexArray(VAO);
-		// Draw the primitive shapes from the vertex array data.
-		// The primitive datas can be points, lines, triangles etc.
-		// Here is an example of all the primitives in OPENGL
-		// https://www.khronos.org/opengl/wiki/Primitive
-		glDrawArrays(GL_TRIANGLES, 0, 3);
-		// Unbind the vertex array here, so that we can bind a different VAO.
-		// NOTE: Since we are only using a single VAO here, it is not necessary to unbind it here, but we do it for completeness sake.
-		glBindVertexArray(0);
+		// The shader may still be compiling in the background, in that case we skip the draw this frame
+		if (ourShader.IsReady())
+		{
+			// Write the instances of this frame: a grid of smaller triangles, each one tinted with its own color.
+			// The stream gives a different region of its buffer every frame, so the instance attributes of the VAO are pointed at it again.
+			Instance* instances = instanceStream.BeginFrame(INSTANCE_GRID * INSTANCE_GRID);
+			for (GLsizei i = 0; instances != nullptr && i < instanceStream.GetCount(); ++i)
+			{
+				const int column = i % INSTANCE_GRID, row = i / INSTANCE_GRID;
+				const GLfloat pulse = 0.75f + 0.25f * static_cast<GLfloat>(std::sin(glfwGetTime() * 2.0 + i));
+				Instance& instance = instances[i];
+				instance.transform[0] = (column + 0.5f) * 2.0f / INSTANCE_GRID - 1.0f;
+				instance.transform[1] = (row + 0.5f) * 2.0f / INSTANCE_GRID - 1.0f;
+				instance.transform[2] = 0.0f;
+				instance.transform[3] = 1.0f / INSTANCE_GRID;
+				instance.color = { { VertexQuantizer::ToUnorm8(pulse), VertexQuantizer::ToUnorm8(static_cast<GLfloat>(column + 1) / INSTANCE_GRID),
+					VertexQuantizer::ToUnorm8(static_cast<GLfloat>(row + 1) / INSTANCE_GRID), 255 } };
+			}
+			instanceStream.EndFrame();
+
+			// Point the binding points at the buffers of this draw: the vertices and the indices of the mesh in the arena,
+			// and the instances of this frame. Nothing else of the VAO changes, and a binding point given the buffer
+			// and offset it already has is skipped.
+			format->BindVertexBuffer(0, arena->GetBuffer(vertexData), arena->GetOffset(vertexData));
+			format->BindElementBuffer(arena->GetBuffer(indexData));
+			instanceStream.Attach(*format, 1);
+
+			// Report attributes the shader reads but the VAO does not provide, only once
+			if (!vertexArrayChecked)
+			{
+				// The time until the shader could be used, including the frames drawn while it was compiling
+				std::cout << "Shader core.vs/core.frag ready after "
+					<< std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - shaderStart).count() << " ms" << std::endl;
+				ourShader.GetReflection().ValidateVertexArray(format->GetVertexArray());
+				vertexArrayChecked = true;
+			}
+			// Use the current shader
+			ourShader.Use();
+			// The transform from the quantized positions back to the original ones, only sent when it changes (after a reload)
+			const GLfloat* scale = positionTransform.scale;
+			const GLfloat* offset = positionTransform.offset;
+			ourShader.SetVec3(ourShader.GetUniform(ShaderReflection::Id("positionScale")), scale[0], scale[1], scale[2]);
+			ourShader.SetVec3(ourShader.GetUniform(ShaderReflection::Id("positionOffset")), offset[0], offset[1], offset[2]);
+			// Bind the VAO here for the purpose of drawing using the settings required
+			// After the first frame the program and the VAO are already bound, the cache filters both calls out
+			format->Bind();
+			// Draw the primitive shapes from the vertex array data, taking the vertices in the order of the element buffer,
+			// from where the indices are in the buffer of the arena.
+			// Every instance of the stream draws the whole mesh once, all of them with this single call.
+			// The primitive datas can be points, lines, triangles etc.
+			// Here is an example of all the primitives in OPENGL
+			// https://www.khronos.org/opengl/wiki/Primitive
+			glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT,
+				reinterpret_cast<const GLvoid*>(arena->GetOffset(indexData)), instanceStream.GetCount());
+			// The region of this frame is written again once the GPU has drawn it
+			instanceStream.Fence();
+			// NOTE: The VAO is not unbound after the draw. The next draw binds its own VAO through the cache anyway,
+			//		 and unbinding would make the cache issue both binds again every frame.
+		}
 
 		// Swaps the front and back buffers of the specified window
 		glfwSwapBuffers(window);
 	}
 
-	// Delete the vertex array object, passing in the number of the vertex arrays objects stored in the the array (VAO)
-	glDeleteVertexArrays(1, &VAO);
-	// Delete the number of buffer objects passed in the array buffer.
-	glDeleteBuffers(1, &VBO);
+	// Every compile and link done while the program ran (the first build and the hot reloads), with their timings and logs.
+	// Build with SHADER_FAIL_ON_ERROR defined to stop at the first shader error instead, for automated builds.
+	ShaderDiagnostics::Global().PrintSlowest(5);
+	ShaderDiagnostics::Global().Export("shader_diagnostics.json");
+	// The state changes of the last frame
+	state.PrintStatistics();
+
+	// The buffer changes of the binding points, most of them skipped since the buffers of the single mesh never change
+	format->PrintStatistics();
+	// Delete the vertex array object of the format
+	format.reset();
+	// Give the ranges of the mesh back and delete the buffers of the arena and of the instances
+	arena->PrintStatistics("mesh");
+	arena->Free(vertexData);
+	arena->Free(indexData);
+	arena.reset();
+	stream.reset();
+	// Delete the shader program, this needs the context so it has to happen before glfwTerminate
+	shader.reset();
 
 	// Terminate all the stuff related to GLFW and exit the program using the return value EXIT_SUCCESS
 	glfwTerminate();
@@ -0,0 +1,199 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <GLFW/glfw3.h>
+
+#include "ShaderVariants.h"
+#include "ShaderArchive.h"
+
+// SHADER BAKE TOOL
+// Builds the shader archive used by the application (see ShaderArchive.h), as part of the build.
+// Usage: ShaderBake <permutation list> <archive>
+//		  ShaderBake --embed <permutation list> <header>
+// The permutation list has one permutation per line, in the format written by ShaderVariantCache::Dump:
+//		vertex file|fragment file|DEFINE;DEFINE
+// Every permutation is preprocessed, compiled and linked. If any of them fails the tool exits with EXIT_FAILURE,
+// which fails the build instead of shipping a broken shader.
+// With --embed, the preprocessed sources of every file in the list are written into a header instead, see WriteEmbedded.
+
+// The name of the constant holding the source of a file: core.vs becomes core_vs
+std::string GetEmbeddedName(const std::string& path)
+{
+	std::string name;
+	for (char character : path)
+	{
+		name += isalnum(static_cast<unsigned char>(character)) ? character : '_';
+	}
+	return isdigit(static_cast<unsigned char>(name[0])) ? "_" + name : name;
+}
+
+// Writes a header with a constexpr ShaderCode (see ShaderSource.h) for every vertex and fragment file in the list.
+// The sources are preprocessed (includes expanded), their lengths and hashes are computed here,
+// and the text is stored as raw string literals so it keeps its exact contents.
+// The header is only rewritten when its contents change, so it does not trigger a rebuild for nothing.
+bool WriteEmbedded(const std::vector<std::vector<std::string>>& permutations, const std::string& headerPath)
+{
+	std::vector<std::string> files;
+	for (const std::vector<std::string>& fields : permutations)
+	{
+		for (int i = 0; i < 2; ++i)
+		{
+			if (std::find(files.begin(), files.end(), fields[i]) == files.end())
+			{
+				files.push_back(fields[i]);
+			}
+		}
+	}
+
+	std::string header = "// Generated by ShaderBake --embed from the shader permutation list, do not edit.\n"
+		"// Run ShaderBake again (it runs after building the ShaderBake project) after changing the shaders.\n"
+		"#ifndef EMBEDDED_SHADERS_H\n#define EMBEDDED_SHADERS_H\n\n#include \"ShaderSource.h\"\n\nnamespace EmbeddedShaders\n{\n";
+	for (const std::string& file : files)
+	{
+		std::shared_ptr<const ShaderPreprocessor::Expansion> source = ShaderPreprocessor::Global().Expand(file);
+		const std::string& code = *source->code;
+		if (code.empty() || code.find(")glsl\"") != std::string::npos)
+		{
+			std::cout << "ERROR::SHADER::BAKE::CANNOT_EMBED " << file << std::endl;
+			return false;
+		}
+
+		char hash[32];
+		snprintf(hash, sizeof(hash), "0x%016llxULL", static_cast<unsigned long long>(source->hash));
+		header += "\tconstexpr ShaderCode " + GetEmbeddedName(file) + " = { \"" + file + "\",\n";
+		// Compilers limit the length of a single string literal, long sources are split into several literals which the compiler joins
+		for (size_t start = 0; start < code.size(); )
+		{
+			size_t end = std::min(start + 4096, code.size());
+			end = end < code.size() ? code.rfind('\n', end) + 1 : end;
+			end = end <= start ? std::min(start + 4096, code.size()) : end;
+			header += "R\"glsl(" + code.substr(start, end - start) + ")glsl\"\n";
+			start = end;
+		}
+		header += "\t\t, " + std::to_string(code.size()) + ", " + hash + " };\n";
+	}
+	header += "}\n\n// File numbers in compiler messages: " + ShaderPreprocessor::Global().GetSourceNames() + "\n\n#endif\n";
+
+	std::string current;
+	if (ShaderSource::Exists(headerPath) && ShaderSource::Load(headerPath, current) && current == header)
+	{
+		std::cout << "SHADER::BAKE " << headerPath << " is up to date" << std::endl;
+		return true;
+	}
+	std::ofstream output(headerPath, std::ios::binary | std::ios::trunc);
+	output << header;
+	if (!output.good())
+	{
+		std::cout << "ERROR::SHADER::BAKE::FILE_NOT_SUCCESFULLY_WRITTEN " << headerPath << std::endl;
+		return false;
+	}
+	std::cout << "SHADER::BAKE " << files.size() << " files embedded into " << headerPath << std::endl;
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	const bool embed = argc == 4 && strcmp(argv[1], "--embed") == 0;
+	if (argc != 3 && !embed)
+	{
+		std::cout << "Usage: ShaderBake <permutation list> <archive>" << std::endl;
+		std::cout << "       ShaderBake --embed <permutation list> <header>" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::vector<std::vector<std::string>> permutations;
+	if (!ShaderVariantCache::ReadDump(argv[embed ? 2 : 1], permutations))
+	{
+		return EXIT_FAILURE;
+	}
+
+	// Embedding only needs the preprocessor, no OpenGL context
+	if (embed)
+	{
+		return WriteEmbedded(permutations, argv[3]) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Compiling needs an OpenGL context, the same one the application asks for, in a window that is never shown
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	GLFWwindow* window = glfwCreateWindow(1, 1, "ShaderBake", nullptr, nullptr);
+	if (window == nullptr)
+	{
+		std::cout << "Failed to create GLFW window" << std::endl;
+		glfwTerminate();
+		return EXIT_FAILURE;
+	}
+	glfwMakeContextCurrent(window);
+	glewExperimental = GL_TRUE;
+	if (GLEW_OK != glewInit())
+	{
+		std::cout << "Failed to initialize GLEW" << std::endl;
+		glfwTerminate();
+		return EXIT_FAILURE;
+	}
+
+	ShaderArchiveWriter writer;
+	int failed = 0;
+	for (const std::vector<std::string>& fields : permutations)
+	{
+		const std::vector<std::string> defines(fields.begin() + 2, fields.end());
+		Shader shader(fields[0].c_str(), fields[1].c_str(), defines);
+		if (!shader.IsReady())
+		{
+			std::cout << "SHADER::BAKE::FAILED " << fields[0] << " " << fields[1] << std::endl;
+			failed++;
+			continue;
+		}
+
+		// The preprocessed sources, the preprocessor already has them from building the shader
+		ShaderPreprocessor& preprocessor = ShaderPreprocessor::Global();
+		const std::string vertexCode = *preprocessor.Expand(fields[0])->code;
+		const std::string fragmentCode = *preprocessor.Expand(fields[1])->code;
+
+		std::string reflection;
+		shader.GetReflection().Write(reflection);
+
+		// The program binary, only if the driver can give one (the program was linked with the retrievable hint)
+		GLenum binaryFormat = 0;
+		std::vector<char> binary;
+		if (shader.GetCacheStatus() != ShaderCache::DISABLED)
+		{
+			GLint length = 0;
+			glGetProgramiv(shader.GetProgram(), GL_PROGRAM_BINARY_LENGTH, &length);
+			binary.resize(length);
+			GLsizei written = 0;
+			if (length > 0)
+			{
+				glGetProgramBinary(shader.GetProgram(), length, &written, &binaryFormat, binary.data());
+			}
+			binary.resize(written);
+		}
+
+		writer.Add(fields[0], fields[1], defines, vertexCode, fragmentCode, reflection, binaryFormat, binary);
+		std::cout << "SHADER::BAKE " << fields[0] << " " << fields[1] << " " << defines.size() << " defines, "
+			<< binary.size() << " binary bytes" << std::endl;
+	}
+
+	bool written = failed == 0 && writer.Write(argv[2], ShaderCache::DriverHash());
+	glfwTerminate();
+	if (!written)
+	{
+		std::cout << "SHADER::BAKE " << failed << " of " << permutations.size() << " permutations failed, " << argv[2] << " not written" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "SHADER::BAKE " << permutations.size() << " permutations written to " << argv[2] << std::endl;
+	return EXIT_SUCCESS;
+}
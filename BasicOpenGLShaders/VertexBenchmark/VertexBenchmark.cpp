@@ -0,0 +1,1676 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <functional>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <GLFW/glfw3.h>
+
+#include "Shader.h"
+#include "VertexLayout.h"
+#include "VertexQuantize.h"
+#include "InstanceStream.h"
+#include "MeshBatch.h"
+#include "BufferArena.h"
+#include "DirectStateAccess.h"
+#include "VertexFormat.h"
+#include "UniformBuffer.h"
+#include "ShaderPipeline.h"
+#include "EmbeddedShaders.h"
+
+// VERTEX FORMAT BENCHMARK
+// Measures how fast the GPU reads vertices stored in each of the formats of VertexQuantize.h.
+// Usage: VertexBenchmark [vertex count]
+//		  VertexBenchmark --instances [largest instance count]
+//		  VertexBenchmark --batch [largest mesh count]
+//		  VertexBenchmark --stream [particle count]
+//		  VertexBenchmark --arena [mesh count]
+//		  VertexBenchmark --dsa [mesh count]
+//		  VertexBenchmark --binding [mesh count]
+//		  VertexBenchmark --uniforms [object count]
+//		  VertexBenchmark --compute [particle count]
+//		  VertexBenchmark --pipelines [variant count]
+//		  VertexBenchmark --sources [file count]
+//		  VertexBenchmark --cache [program count]
+// A large grid mesh (4 million vertices unless a count is given) with a position, a color and a normal per vertex
+// is converted into every format, printing the error of the conversion, and drawn as points a number of times.
+// The window is a single pixel and almost every point falls outside of it, so the time measured is the time spent
+// fetching and transforming the vertices, not the time spent drawing pixels. The throughput is computed from the time
+// of the whole draw as seen by the application, the time of the GPU alone (GL_TIME_ELAPSED) is printed next to it,
+// software renderers do not always measure it.
+// With --instances, many small copies of a triangle are drawn instead, from 1 up to a million (unless a count is given),
+// once with one draw call per copy and once with a single instanced draw call (see InstanceStream.h),
+// printing the time the CPU takes to submit the frame and the time of the whole frame.
+// With --batch, as many different meshes as copies are drawn, from 1 up to 10000 (unless a count is given): once with a vertex array
+// and a draw call per mesh, and once from the shared buffers of a MeshBatch, both with a draw call per mesh and with multi draw indirect.
+// With --stream, the vertices of a million particles (unless a count is given) are written again and drawn every frame,
+// through a StreamBuffer with each of its strategies and with glBufferSubData, printing how many bytes per second reach the GPU.
+// With --arena, 10000 meshes (unless a count is given) are loaded and drawn once with buffers and a vertex array per mesh
+// and once from a BufferArena, then half of them are replaced by larger ones and the arena is defragmented over several frames,
+// printing its statistics along the way.
+// With --dsa, 10000 meshes (unless a count is given) are created with a vertex array, a vertex buffer and an index buffer each,
+// once with direct state access and once by binding the objects to edit them, printing the time and the number of binds.
+// With --binding, 10000 meshes (unless a count is given) in buffers of their own are drawn with a vertex array per mesh, then with
+// a single VertexFormat changing the vertex buffer of its binding point for every draw, with and without vertex attrib binding.
+// With --uniforms, 10000 copies of the triangle (unless a count is given) are drawn with one draw call each, their transform and color
+// set with glUniform, written into a uniform buffer per object, and written into a UniformRing.
+// With --compute, a million particles (unless a count is given) are written by a compute shader and drawn as vertices every frame,
+// with the barriers of MemoryBarrierTracker and with GL_ALL_BARRIER_BITS, then read back and checked against the CPU.
+// The kernel uses GLSL 4.30 and a shader storage block, so this mode asks for an OpenGL 4.3 context instead of 3.3.
+// With --pipelines, 8 vertex shaders (unless a count is given) are combined with as many fragment shaders and a triangle is drawn
+// with every combination, once with separable stages and program pipelines (see ShaderPipeline.h) and once linking a program
+// per combination, printing the number of links, the time, and the memory held by the programs or the stages and pipelines.
+// Programs found in the program binary cache are not linked again, they are counted separately.
+// With --sources, 300 shader files of 256 KB (unless a count is given) are written into the working directory and read a few times,
+// with an ifstream and a stringstream, with ShaderSource::Load, with ShaderSource::LoadAll (see ShaderSource.h)
+// and through ShaderPreprocessor::Expand and Shader::SetShaderSource as shaders load them,
+// printing the time and the bytes copied by each. The files are deleted afterwards.
+// With --cache, 20 variants of core.vs/core.frag (unless a count is given) are created in the asynchronous mode three times:
+// with their entries removed from the program binary cache, with the entries written by the first run, and with every entry
+// marked as written by another driver. The time until all of them can be used is printed for each.
+// Drivers with a shader cache of their own (Mesa) may find the sources of the invalidated run there, after the cold run compiled them.
+
+// 32 bit floats everywhere, 36 bytes
+struct FloatVertex
+{
+	GLfloat position[3];
+	GLfloat color[3];
+	GLfloat normal[3];
+};
+
+// Half float positions, byte colors and packed normals, 16 bytes
+struct HalfVertex
+{
+	Half position[4];
+	Normalized<GLubyte, 4> color;
+	PackedNormal normal;
+};
+
+// snorm16 positions in the bounding box of the mesh, byte colors and packed normals, 16 bytes
+struct Snorm16Vertex
+{
+	Normalized<GLshort, 4> position;
+	Normalized<GLubyte, 4> color;
+	PackedNormal normal;
+};
+
+constexpr VertexAttribute floatAttributes[] = { VERTEX_ATTRIBUTE(FloatVertex, position), VERTEX_ATTRIBUTE(FloatVertex, color), VERTEX_ATTRIBUTE(FloatVertex, normal) };
+constexpr VertexAttribute halfAttributes[] = { VERTEX_ATTRIBUTE(HalfVertex, position), VERTEX_ATTRIBUTE(HalfVertex, color), VERTEX_ATTRIBUTE(HalfVertex, normal) };
+constexpr VertexAttribute snorm16Attributes[] = { VERTEX_ATTRIBUTE(Snorm16Vertex, position), VERTEX_ATTRIBUTE(Snorm16Vertex, color), VERTEX_ATTRIBUTE(Snorm16Vertex, normal) };
+
+// Reads every attribute, so none of them can be skipped by the compiler
+const std::string vertexSource = R"glsl(#version 330 core
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 color;
+layout (location = 2) in vec3 normal;
+
+out vec3 shade;
+
+#ifdef QUANTIZED_POSITION
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+#endif
+
+void main()
+{
+#ifdef QUANTIZED_POSITION
+	gl_Position = vec4(position * positionScale + positionOffset, 1.0);
+#else
+	gl_Position = vec4(position, 1.0);
+#endif
+	shade = color * max(dot(normal, vec3(0.0, 0.0, 1.0)), 0.0);
+}
+)glsl";
+
+const std::string fragmentSource = R"glsl(#version 330 core
+in vec3 shade;
+
+out vec4 color;
+
+void main()
+{
+	color = vec4(shade, 1.0);
+}
+)glsl";
+
+// The draws measured for every format, after one draw to warm up
+const int DRAW_COUNT = 20;
+
+// The float data of the mesh, converted into every format, three floats per vertex for each attribute
+struct Mesh
+{
+	size_t count;
+	std::vector<GLfloat> positions;
+	std::vector<GLfloat> colors;
+	std::vector<GLfloat> normals;
+};
+
+// The floats of an attribute as an array of three floats per vertex, as VertexQuantizer takes them
+const GLfloat (*GetTriples(const std::vector<GLfloat>& values))[3]
+{
+	return reinterpret_cast<const GLfloat (*)[3]>(values.data());
+}
+
+// A square grid bent into waves, so the positions, colors and normals all vary from one vertex to the next
+Mesh CreateGrid(size_t vertexCount)
+{
+	const size_t side = std::max<size_t>(2, static_cast<size_t>(std::sqrt(static_cast<double>(vertexCount))));
+	Mesh mesh;
+	mesh.count = side * side;
+	mesh.positions.resize(mesh.count * 3);
+	mesh.colors.resize(mesh.count * 3);
+	mesh.normals.resize(mesh.count * 3);
+	for (size_t row = 0; row < side; ++row)
+	{
+		for (size_t column = 0; column < side; ++column)
+		{
+			GLfloat* position = &mesh.positions[(row * side + column) * 3];
+			GLfloat* color = &mesh.colors[(row * side + column) * 3];
+			GLfloat* normal = &mesh.normals[(row * side + column) * 3];
+			const float x = column * 2.0f / (side - 1) - 1.0f;
+			const float y = row * 2.0f / (side - 1) - 1.0f;
+			const float z = 0.25f * std::sin(x * 6.0f) * std::cos(y * 6.0f);
+
+			position[0] = x;
+			position[1] = y;
+			position[2] = z;
+			color[0] = x * 0.5f + 0.5f;
+			color[1] = y * 0.5f + 0.5f;
+			color[2] = z * 2.0f + 0.5f;
+
+			// The normal of the surface z(x, y) is (-dz/dx, -dz/dy, 1), normalized
+			const float dx = 1.5f * std::cos(x * 6.0f) * std::cos(y * 6.0f);
+			const float dy = -1.5f * std::sin(x * 6.0f) * std::sin(y * 6.0f);
+			const float length = std::sqrt(dx * dx + dy * dy + 1.0f);
+			normal[0] = -dx / length;
+			normal[1] = -dy / length;
+			normal[2] = 1.0f / length;
+		}
+	}
+	return mesh;
+}
+
+// Uploads the vertices, draws them DRAW_COUNT times and prints the time the GPU took
+template <typename Vertex, size_t N>
+bool Benchmark(const std::string& name, const std::vector<Vertex>& vertices, const VertexAttribute (&attributes)[N],
+	const std::vector<std::string>& defines, const VertexQuantizer::PositionTransform* transform)
+{
+	const ShaderCode vertexCode = { "benchmark.vs", vertexSource.data(), vertexSource.size(), ShaderCache::Hash(vertexSource) };
+	const ShaderCode fragmentCode = { "benchmark.frag", fragmentSource.data(), fragmentSource.size(), ShaderCache::Hash(fragmentSource) };
+	Shader shader(vertexCode, fragmentCode, defines);
+	if (!shader.IsReady())
+	{
+		std::cout << "ERROR::VERTEX::BENCHMARK::SHADER_NOT_READY " << name << std::endl;
+		return false;
+	}
+
+	GLuint vertexArray, buffer, query;
+	glGenVertexArrays(1, &vertexArray);
+	glGenBuffers(1, &buffer);
+	glGenQueries(1, &query);
+	GLStateCache& state = GLStateCache::Global();
+	state.BindVertexArray(vertexArray);
+	state.BindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	VertexLayout<Vertex>::Apply(attributes);
+
+	shader.Use();
+	if (transform != nullptr)
+	{
+		shader.SetVec3(shader.GetUniform(ShaderReflection::Id("positionScale")), transform->scale[0], transform->scale[1], transform->scale[2]);
+		shader.SetVec3(shader.GetUniform(ShaderReflection::Id("positionOffset")), transform->offset[0], transform->offset[1], transform->offset[2]);
+	}
+
+	// The first draw uploads the buffer to the GPU and finishes setting up the program, it is not measured
+	const GLsizei count = static_cast<GLsizei>(vertices.size());
+	glDrawArrays(GL_POINTS, 0, count);
+	glFinish();
+
+	GLuint64 nanoseconds = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < DRAW_COUNT; ++i)
+	{
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		glDrawArrays(GL_POINTS, 0, count);
+		glEndQuery(GL_TIME_ELAPSED);
+		// Waits for the draw itself, not only for the query, so the time on the clock is the time of the draw
+		glFinish();
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+		nanoseconds += elapsed;
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	glDeleteQueries(1, &query);
+	glDeleteBuffers(1, &buffer);
+	glDeleteVertexArrays(1, &vertexArray);
+	state.Forget(GL_VERTEX_ARRAY, vertexArray);
+	state.Forget(GL_BUFFER, buffer);
+
+	const double seconds = std::chrono::duration<double>(end - start).count() / DRAW_COUNT;
+	const double gpuSeconds = nanoseconds * 1e-9 / DRAW_COUNT;
+	const double verticesPerSecond = seconds > 0.0 ? count / seconds : 0.0;
+	std::cout << "VERTEX::BENCHMARK " << name << ": " << sizeof(Vertex) << " bytes per vertex, " << seconds * 1e3 << " ms per draw ("
+		<< gpuSeconds * 1e3 << " ms on the GPU), "
+		<< verticesPerSecond * 1e-6 << " million vertices/s, " << verticesPerSecond * sizeof(Vertex) * 1e-9 << " GB/s" << std::endl;
+	return true;
+}
+
+// Draws the grid mesh in every vertex format
+bool BenchmarkFormats(size_t vertexCount)
+{
+	const Mesh mesh = CreateGrid(vertexCount);
+	const size_t count = mesh.count;
+	std::cout << "VERTEX::BENCHMARK " << count << " vertices, " << DRAW_COUNT << " draws per format" << std::endl;
+
+	std::vector<FloatVertex> floatVertices(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			floatVertices[i].position[axis] = mesh.positions[i * 3 + axis];
+			floatVertices[i].color[axis] = mesh.colors[i * 3 + axis];
+			floatVertices[i].normal[axis] = mesh.normals[i * 3 + axis];
+		}
+	}
+
+	// Colors and normals are converted the same way for both compressed formats
+	std::vector<HalfVertex> halfVertices(count);
+	VertexQuantizer::PrintReport("position half", VertexQuantizer::QuantizePositions(GetTriples(mesh.positions), count, halfVertices.data(), &HalfVertex::position));
+	VertexQuantizer::PrintReport("color unorm8", VertexQuantizer::QuantizeColors(GetTriples(mesh.colors), count, halfVertices.data(), &HalfVertex::color));
+	VertexQuantizer::PrintReport("normal 2_10_10_10", VertexQuantizer::QuantizeNormals(GetTriples(mesh.normals), count, halfVertices.data(), &HalfVertex::normal));
+
+	std::vector<Snorm16Vertex> snorm16Vertices(count);
+	VertexQuantizer::PositionTransform transform;
+	VertexQuantizer::PrintReport("position snorm16", VertexQuantizer::QuantizePositions(GetTriples(mesh.positions), count, snorm16Vertices.data(), &Snorm16Vertex::position, transform));
+	VertexQuantizer::QuantizeColors(GetTriples(mesh.colors), count, snorm16Vertices.data(), &Snorm16Vertex::color);
+	VertexQuantizer::QuantizeNormals(GetTriples(mesh.normals), count, snorm16Vertices.data(), &Snorm16Vertex::normal);
+
+	bool success = Benchmark("float32", floatVertices, floatAttributes, std::vector<std::string>(), nullptr);
+	success = Benchmark("half position", halfVertices, halfAttributes, std::vector<std::string>(), nullptr) && success;
+	success = Benchmark("snorm16 position", snorm16Vertices, snorm16Attributes, { "QUANTIZED_POSITION" }, &transform) && success;
+	return success;
+}
+
+// The triangle of the application with float vertices, and a copy of it as an instance: offset and scale, and a color
+struct TriangleVertex
+{
+	GLfloat position[3];
+	GLfloat color[3];
+};
+
+struct Instance
+{
+	GLfloat transform[4];
+	Normalized<GLubyte, 4> color;
+};
+
+constexpr VertexAttribute triangleAttributes[] = { VERTEX_ATTRIBUTE(TriangleVertex, position), VERTEX_ATTRIBUTE(TriangleVertex, color) };
+constexpr VertexAttribute instanceAttributes[] = { VERTEX_ATTRIBUTE(Instance, transform), VERTEX_ATTRIBUTE(Instance, color) };
+
+// The frames measured for every number of objects, and the largest number of copies drawn with one draw call per copy
+const int FRAME_COUNT = 10;
+const size_t SEPARATE_DRAW_LIMIT = 100000;
+
+// The copy i of count, spread over a square grid
+Instance GetInstance(size_t i, size_t count)
+{
+	const size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+	const GLfloat size = 2.0f / side;
+	const GLubyte shade = static_cast<GLubyte>(i * 255 / count);
+	return Instance{ { (i % side + 0.5f) * size - 1.0f, (i / side + 0.5f) * size - 1.0f, 0.0f, size }, { { shade, 255, static_cast<GLubyte>(255 - shade), 255 } } };
+}
+
+// Prints the average submit and frame time of FRAME_COUNT frames, drawFrame submits one frame. Returns the frame time in seconds.
+template <typename DrawFrame>
+double MeasureFrames(const std::string& name, size_t count, DrawFrame drawFrame)
+{
+	// One frame to warm up, it is not measured
+	drawFrame();
+	glFinish();
+
+	double submitSeconds = 0.0, frameSeconds = 0.0;
+	for (int frame = 0; frame < FRAME_COUNT; ++frame)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		drawFrame();
+		auto submitted = std::chrono::high_resolution_clock::now();
+		glFinish();
+		auto end = std::chrono::high_resolution_clock::now();
+		submitSeconds += std::chrono::duration<double>(submitted - start).count();
+		frameSeconds += std::chrono::duration<double>(end - start).count();
+	}
+	std::cout << "VERTEX::BENCHMARK " << name << ", " << count << " objects: " << submitSeconds * 1e3 / FRAME_COUNT << " ms submit, "
+		<< frameSeconds * 1e3 / FRAME_COUNT << " ms frame" << std::endl;
+	return frameSeconds / FRAME_COUNT;
+}
+
+// Draws 1, 10, 100... copies of the triangle up to maxInstances, with one draw call per copy and with one instanced draw call
+bool BenchmarkInstances(size_t maxInstances)
+{
+	Shader shader(EmbeddedShaders::core_vs, EmbeddedShaders::core_frag, { "INSTANCED" });
+	if (!shader.IsReady())
+	{
+		std::cout << "ERROR::INSTANCE::BENCHMARK::SHADER_NOT_READY" << std::endl;
+		return false;
+	}
+	shader.Use();
+
+	const TriangleVertex vertices[] =
+	{
+		{ { -0.5f, -0.5f, 0.0f }, { 1.0f, 0.0f, 0.0f } },
+		{ { 0.5f, -0.5f, 0.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { 0.0f, 0.5f, 0.0f }, { 0.0f, 0.0f, 1.0f } }
+	};
+	const GLuint indices[] = { 0, 1, 2 };
+
+	// Two vertex arrays on the same buffers: one reads the instance attributes from the stream,
+	// the other leaves them disabled so every draw sets them with glVertexAttrib, the way a uniform would be set per object
+	GLStateCache& state = GLStateCache::Global();
+	GLuint vertexArrays[2], buffers[2];
+	glGenVertexArrays(2, vertexArrays);
+	glGenBuffers(2, buffers);
+	for (GLuint vertexArray : vertexArrays)
+	{
+		state.BindVertexArray(vertexArray);
+		state.BindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+		if (vertexArray == vertexArrays[0])
+		{
+			glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+		}
+		VertexLayout<TriangleVertex>::Apply(triangleAttributes);
+		state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+		if (vertexArray == vertexArrays[0])
+		{
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+		}
+	}
+
+	{
+		InstanceStream<Instance> stream(maxInstances);
+		for (size_t count = 1; count <= maxInstances; count *= 10)
+		{
+			if (count <= SEPARATE_DRAW_LIMIT)
+			{
+				MeasureFrames("separate draws", count, [&]()
+				{
+					state.BindVertexArray(vertexArrays[1]);
+					for (size_t i = 0; i < count; ++i)
+					{
+						const Instance instance = GetInstance(i, count);
+						glVertexAttrib4fv(2, instance.transform);
+						glVertexAttrib4Nubv(3, instance.color.values);
+						glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, nullptr);
+					}
+				});
+			}
+
+			MeasureFrames("instanced", count, [&]()
+			{
+				Instance* instances = stream.BeginFrame(count);
+				for (GLsizei i = 0; instances != nullptr && i < stream.GetCount(); ++i)
+				{
+					instances[i] = GetInstance(i, count);
+				}
+				stream.EndFrame();
+				stream.Attach(vertexArrays[0], instanceAttributes, 2);
+				state.BindVertexArray(vertexArrays[0]);
+				glDrawElementsInstanced(GL_TRIANGLES, 3, GL_UNSIGNED_INT, nullptr, stream.GetCount());
+				stream.Fence();
+			});
+		}
+	}
+
+	glDeleteBuffers(2, buffers);
+	glDeleteVertexArrays(2, vertexArrays);
+	for (int i = 0; i < 2; ++i)
+	{
+		state.Forget(GL_VERTEX_ARRAY, vertexArrays[i]);
+		state.Forget(GL_BUFFER, buffers[i]);
+	}
+	return true;
+}
+
+// A different mesh for every number: a regular polygon with 3 to 10 sides, made of a fan of triangles
+void CreatePolygon(size_t number, std::vector<TriangleVertex>& vertices, std::vector<GLuint>& indices)
+{
+	const size_t sides = 3 + number % 8;
+	vertices.clear();
+	indices.clear();
+	for (size_t i = 0; i < sides; ++i)
+	{
+		const float angle = i * 6.2831853f / sides;
+		vertices.push_back(TriangleVertex{ { 0.5f * std::cos(angle), 0.5f * std::sin(angle), 0.0f }, { 1.0f, 1.0f, 1.0f } });
+	}
+	for (size_t i = 1; i + 1 < sides; ++i)
+	{
+		indices.push_back(0);
+		indices.push_back(static_cast<GLuint>(i));
+		indices.push_back(static_cast<GLuint>(i + 1));
+	}
+}
+
+// Draws 1, 10, 100... different meshes up to maxMeshes, each with its own vertex array and with a MeshBatch
+bool BenchmarkBatch(size_t maxMeshes)
+{
+	Shader shader(EmbeddedShaders::core_vs, EmbeddedShaders::core_frag, { "INSTANCED" });
+	if (!shader.IsReady())
+	{
+		std::cout << "ERROR::MESH::BATCH::BENCHMARK::SHADER_NOT_READY" << std::endl;
+		return false;
+	}
+	shader.Use();
+
+	// Every mesh in its own buffers and vertex array, the per draw data is set with glVertexAttrib before every draw,
+	// and in the shared buffers of the batch, the per draw data is read from an instance stream
+	GLStateCache& state = GLStateCache::Global();
+	std::vector<GLuint> vertexArrays(maxMeshes), buffers(maxMeshes * 2);
+	std::vector<GLsizei> indexCounts(maxMeshes);
+	glGenVertexArrays(static_cast<GLsizei>(maxMeshes), vertexArrays.data());
+	glGenBuffers(static_cast<GLsizei>(maxMeshes * 2), buffers.data());
+	MeshBatch<TriangleVertex> batch(triangleAttributes);
+	std::vector<TriangleVertex> vertices;
+	std::vector<GLuint> indices;
+	for (size_t i = 0; i < maxMeshes; ++i)
+	{
+		CreatePolygon(i, vertices, indices);
+		batch.Add(vertices, indices);
+		state.BindVertexArray(vertexArrays[i]);
+		state.BindBuffer(GL_ARRAY_BUFFER, buffers[i * 2]);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(TriangleVertex), vertices.data(), GL_STATIC_DRAW);
+		VertexLayout<TriangleVertex>::Apply(triangleAttributes);
+		state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[i * 2 + 1]);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+		indexCounts[i] = static_cast<GLsizei>(indices.size());
+	}
+	batch.Upload();
+	if (!MeshBatch<TriangleVertex>::IsMultiDrawIndirectSupported())
+	{
+		std::cout << "MESH::BATCH::BENCHMARK multi draw indirect is not supported, the batch draws one call per mesh" << std::endl;
+	}
+
+	{
+		InstanceStream<Instance> stream(maxMeshes);
+		for (size_t count = 1; count <= maxMeshes; count *= 10)
+		{
+			MeasureFrames("vertex array per mesh", count, [&]()
+			{
+				for (size_t i = 0; i < count; ++i)
+				{
+					const Instance instance = GetInstance(i, count);
+					state.BindVertexArray(vertexArrays[i]);
+					glVertexAttrib4fv(2, instance.transform);
+					glVertexAttrib4Nubv(3, instance.color.values);
+					glDrawElements(GL_TRIANGLES, indexCounts[i], GL_UNSIGNED_INT, nullptr);
+				}
+			});
+
+			// The per draw data of mesh i is instance i of the frame
+			auto drawBatch = [&]()
+			{
+				Instance* instances = stream.BeginFrame(count);
+				for (GLsizei i = 0; instances != nullptr && i < stream.GetCount(); ++i)
+				{
+					instances[i] = GetInstance(i, count);
+					batch.Draw(static_cast<GLuint>(i), 1, static_cast<GLuint>(i));
+				}
+				stream.EndFrame();
+				batch.Submit(stream, instanceAttributes, 2);
+				stream.Fence();
+			};
+			batch.SetMultiDrawIndirect(false);
+			MeasureFrames("batch, call per mesh", count, drawBatch);
+			batch.SetMultiDrawIndirect(true);
+			if (batch.IsMultiDrawIndirect())
+			{
+				MeasureFrames("batch, multi draw indirect", count, drawBatch);
+			}
+		}
+	}
+
+	glDeleteBuffers(static_cast<GLsizei>(buffers.size()), buffers.data());
+	glDeleteVertexArrays(static_cast<GLsizei>(vertexArrays.size()), vertexArrays.data());
+	for (GLuint vertexArray : vertexArrays)
+	{
+		state.Forget(GL_VERTEX_ARRAY, vertexArray);
+	}
+	for (GLuint buffer : buffers)
+	{
+		state.Forget(GL_BUFFER, buffer);
+	}
+	return true;
+}
+
+// Writes the particles of a frame, every particle moves along its own circle
+void WriteParticles(TriangleVertex* particles, size_t count, int frame)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float angle = (i % 1024) * 0.00614f + frame * 0.01f;
+		const float radius = (i / 1024 % 1024) / 1024.0f;
+		particles[i] = TriangleVertex{ { radius * std::cos(angle), radius * std::sin(angle), 0.0f }, { radius, 1.0f - radius, 0.5f } };
+	}
+}
+
+// Streams particleCount particles every frame, with every strategy of StreamBuffer and with glBufferSubData into a single buffer
+bool BenchmarkStreaming(size_t particleCount)
+{
+	Shader shader(EmbeddedShaders::core_vs, EmbeddedShaders::core_frag, std::vector<std::string>());
+	if (!shader.IsReady())
+	{
+		std::cout << "ERROR::STREAM_BUFFER::BENCHMARK::SHADER_NOT_READY" << std::endl;
+		return false;
+	}
+	shader.Use();
+
+	GLStateCache& state = GLStateCache::Global();
+	GLuint vertexArray;
+	glGenVertexArrays(1, &vertexArray);
+	const GLsizeiptr size = static_cast<GLsizeiptr>(particleCount * sizeof(TriangleVertex));
+	const GLsizei count = static_cast<GLsizei>(particleCount);
+	std::cout << "VERTEX::BENCHMARK " << particleCount << " particles, " << size / (1024.0 * 1024.0) << " MB per frame" << std::endl;
+	int frame = 0;
+
+	const StreamBuffer::Strategy strategies[] = { StreamBuffer::PERSISTENT, StreamBuffer::UNSYNCHRONIZED, StreamBuffer::ORPHANING };
+	for (StreamBuffer::Strategy strategy : strategies)
+	{
+		if (strategy == StreamBuffer::PERSISTENT && !StreamBuffer::IsPersistentSupported())
+		{
+			std::cout << "VERTEX::BENCHMARK persistent mapping is not supported" << std::endl;
+			continue;
+		}
+		StreamBuffer stream(size, 3, 4, strategy);
+		const double seconds = MeasureFrames(std::string("stream ") + StreamBuffer::GetStrategyName(strategy), particleCount, [&]()
+		{
+			stream.BeginFrame();
+			const StreamBuffer::Allocation allocation = stream.Allocate(size);
+			if (allocation.data != nullptr)
+			{
+				WriteParticles(static_cast<TriangleVertex*>(allocation.data), particleCount, frame++);
+			}
+			stream.EndFrame();
+			// The region changes every frame, the attributes are pointed at it again
+			state.BindVertexArray(vertexArray);
+			state.BindBuffer(GL_ARRAY_BUFFER, stream.GetBuffer());
+			VertexLayout<TriangleVertex>::Apply(triangleAttributes, allocation.offset);
+			glDrawArrays(GL_POINTS, 0, count);
+			stream.Fence();
+		});
+		std::cout << "  " << size / seconds * 1e-9 << " GB/s" << std::endl;
+	}
+
+	// The simplest way, the driver has to wait for the GPU or copy the data to avoid writing into the buffer it is drawing from
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	state.BindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	std::vector<TriangleVertex> particles(particleCount);
+	const double seconds = MeasureFrames("glBufferSubData", particleCount, [&]()
+	{
+		WriteParticles(particles.data(), particleCount, frame++);
+		state.BindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, size, particles.data());
+		state.BindVertexArray(vertexArray);
+		VertexLayout<TriangleVertex>::Apply(triangleAttributes);
+		glDrawArrays(GL_POINTS, 0, count);
+	});
+	std::cout << "  " << size / seconds * 1e-9 << " GB/s" << std::endl;
+
+	glDeleteBuffers(1, &buffer);
+	glDeleteVertexArrays(1, &vertexArray);
+	state.Forget(GL_BUFFER, buffer);
+	state.Forget(GL_VERTEX_ARRAY, vertexArray);
+	return true;
+}
+
+// The bytes moved by every call to Defragment, one call per frame
+const GLsizeiptr DEFRAGMENT_BUDGET = 256 * 1024;
+
+// Loads meshCount meshes into buffers of their own and into an arena, draws them, then fragments and defragments the arena
+bool BenchmarkArena(size_t meshCount)
+{
+	Shader shader(EmbeddedShaders::core_vs, EmbeddedShaders::core_frag, std::vector<std::string>());
+	if (!shader.IsReady())
+	{
+		std::cout << "ERROR::BUFFER_ARENA::BENCHMARK::SHADER_NOT_READY" << std::endl;
+		return false;
+	}
+	shader.Use();
+
+	GLStateCache& state = GLStateCache::Global();
+	std::vector<std::vector<TriangleVertex>> meshVertices(meshCount);
+	std::vector<std::vector<GLuint>> meshIndices(meshCount);
+	GLsizeiptr totalSize = 0;
+	for (size_t i = 0; i < meshCount; ++i)
+	{
+		CreatePolygon(i, meshVertices[i], meshIndices[i]);
+		totalSize += meshVertices[i].size() * sizeof(TriangleVertex) + sizeof(TriangleVertex) + meshIndices[i].size() * sizeof(GLuint);
+	}
+
+	// Buffers and a vertex array per mesh
+	std::vector<GLuint> vertexArrays(meshCount), buffers(meshCount * 2);
+	auto start = std::chrono::high_resolution_clock::now();
+	glGenVertexArrays(static_cast<GLsizei>(meshCount), vertexArrays.data());
+	glGenBuffers(static_cast<GLsizei>(meshCount * 2), buffers.data());
+	for (size_t i = 0; i < meshCount; ++i)
+	{
+		state.BindVertexArray(vertexArrays[i]);
+		state.BindBuffer(GL_ARRAY_BUFFER, buffers[i * 2]);
+		glBufferData(GL_ARRAY_BUFFER, meshVertices[i].size() * sizeof(TriangleVertex), meshVertices[i].data(), GL_STATIC_DRAW);
+		VertexLayout<TriangleVertex>::Apply(triangleAttributes);
+		state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[i * 2 + 1]);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, meshIndices[i].size() * sizeof(GLuint), meshIndices[i].data(), GL_STATIC_DRAW);
+	}
+	glFinish();
+	std::cout << "VERTEX::BENCHMARK buffers per mesh, " << meshCount << " meshes loaded in "
+		<< std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms, "
+		<< buffers.size() << " buffers" << std::endl;
+
+	// The arena has a page large enough for all the meshes, so a single vertex array draws all of them with a base vertex
+	BufferArena arena(std::max(totalSize, static_cast<GLsizeiptr>(BufferArena::DEFAULT_PAGE_SIZE)));
+	std::vector<BufferArena::Handle> vertexData(meshCount), indexData(meshCount);
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < meshCount; ++i)
+	{
+		vertexData[i] = arena.Allocate(meshVertices[i].size() * sizeof(TriangleVertex), sizeof(TriangleVertex), meshVertices[i].data());
+		indexData[i] = arena.Allocate(meshIndices[i].size() * sizeof(GLuint), sizeof(GLuint), meshIndices[i].data());
+	}
+	glFinish();
+	std::cout << "VERTEX::BENCHMARK arena, " << meshCount << " meshes loaded in "
+		<< std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms, "
+		<< arena.GetStatistics().pages << " buffers" << std::endl;
+	arena.PrintStatistics("loaded");
+
+	GLuint vertexArray;
+	glGenVertexArrays(1, &vertexArray);
+	state.BindVertexArray(vertexArray);
+	state.BindBuffer(GL_ARRAY_BUFFER, arena.GetBuffer(vertexData[0]));
+	VertexLayout<TriangleVertex>::Apply(triangleAttributes);
+	state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.GetBuffer(indexData[0]));
+
+	MeasureFrames("vertex array per mesh", meshCount, [&]()
+	{
+		for (size_t i = 0; i < meshCount; ++i)
+		{
+			state.BindVertexArray(vertexArrays[i]);
+			glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(meshIndices[i].size()), GL_UNSIGNED_INT, nullptr);
+		}
+	});
+	MeasureFrames("arena, base vertex", meshCount, [&]()
+	{
+		state.BindVertexArray(vertexArray);
+		for (size_t i = 0; i < meshCount; ++i)
+		{
+			glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(meshIndices[i].size()), GL_UNSIGNED_INT,
+				reinterpret_cast<GLvoid*>(arena.GetOffset(indexData[i])), static_cast<GLint>(arena.GetOffset(vertexData[i]) / sizeof(TriangleVertex)));
+		}
+	});
+
+	// Every other mesh is replaced by one twice as large, which does not fit in the holes left by the smaller ones
+	for (size_t i = 0; i < meshCount; i += 2)
+	{
+		const GLsizeiptr size = arena.GetSize(vertexData[i]) * 2;
+		arena.Free(vertexData[i]);
+		arena.Free(indexData[i]);
+		std::vector<TriangleVertex> vertices(meshVertices[i]);
+		vertices.insert(vertices.end(), meshVertices[i].begin(), meshVertices[i].end());
+		vertexData[i] = arena.Allocate(size, sizeof(TriangleVertex), vertices.data());
+		indexData[i] = BufferArena::INVALID_HANDLE;
+	}
+	arena.PrintStatistics("fragmented");
+
+	int frames = 0;
+	start = std::chrono::high_resolution_clock::now();
+	while (arena.Defragment(DEFRAGMENT_BUDGET) > 0)
+	{
+		frames++;
+	}
+	glFinish();
+	std::cout << "VERTEX::BENCHMARK defragmented in " << frames << " frames of " << DEFRAGMENT_BUDGET / 1024 << " KB, "
+		<< std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+	arena.PrintStatistics("defragmented");
+
+	glDeleteVertexArrays(1, &vertexArray);
+	state.Forget(GL_VERTEX_ARRAY, vertexArray);
+	glDeleteBuffers(static_cast<GLsizei>(buffers.size()), buffers.data());
+	glDeleteVertexArrays(static_cast<GLsizei>(vertexArrays.size()), vertexArrays.data());
+	for (GLuint meshVertexArray : vertexArrays)
+	{
+		state.Forget(GL_VERTEX_ARRAY, meshVertexArray);
+	}
+	for (GLuint buffer : buffers)
+	{
+		state.Forget(GL_BUFFER, buffer);
+	}
+	return true;
+}
+
+// Creates a vertex array, a vertex buffer and an index buffer for every mesh, the way a loader does, and prints how long it took
+// and how many binds it made. A vertex array bound before must still be bound after.
+void CreateMeshes(const std::string& name, const std::vector<std::vector<TriangleVertex>>& meshVertices, const std::vector<std::vector<GLuint>>& meshIndices,
+	std::vector<GLuint>& vertexArrays, std::vector<GLuint>& buffers)
+{
+	GLStateCache& state = GLStateCache::Global();
+	GLuint bound;
+	glGenVertexArrays(1, &bound);
+	state.BindVertexArray(bound);
+	state.ResetStatistics();
+
+	const auto start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < meshVertices.size(); ++i)
+	{
+		const GLuint vertexArray = DirectStateAccess::CreateVertexArray();
+		const GLuint vertexBuffer = DirectStateAccess::CreateBuffer();
+		const GLuint indexBuffer = DirectStateAccess::CreateBuffer();
+		DirectStateAccess::BufferStorage(vertexBuffer, meshVertices[i].size() * sizeof(TriangleVertex), meshVertices[i].data(), 0);
+		DirectStateAccess::BufferStorage(indexBuffer, meshIndices[i].size() * sizeof(GLuint), meshIndices[i].data(), 0);
+		VertexLayout<TriangleVertex>::Apply(vertexArray, vertexBuffer, triangleAttributes);
+		DirectStateAccess::VertexArrayElementBuffer(vertexArray, indexBuffer);
+		vertexArrays.push_back(vertexArray);
+		buffers.push_back(vertexBuffer);
+		buffers.push_back(indexBuffer);
+	}
+	if (!DirectStateAccess::IsEnabled())
+	{
+		// Bind the vertex array of the caller again
+		state.BindVertexArray(bound);
+	}
+	glFinish();
+	const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	GLint current;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &current);
+	std::cout << "VERTEX::BENCHMARK " << name << ", " << meshVertices.size() << " meshes created in " << milliseconds << " ms, "
+		<< state.GetStatistics().issued << " binds" << (static_cast<GLuint>(current) != bound ? ", the bound vertex array changed" : "") << std::endl;
+	state.BindVertexArray(0);
+	glDeleteVertexArrays(1, &bound);
+	state.Forget(GL_VERTEX_ARRAY, bound);
+}
+
+// Creates meshCount meshes with direct state access, if the context has it, and with binds
+bool BenchmarkDirectStateAccess(size_t meshCount)
+{
+	std::vector<std::vector<TriangleVertex>> meshVertices(meshCount);
+	std::vector<std::vector<GLuint>> meshIndices(meshCount);
+	for (size_t i = 0; i < meshCount; ++i)
+	{
+		CreatePolygon(i, meshVertices[i], meshIndices[i]);
+	}
+
+	std::vector<GLuint> vertexArrays, buffers;
+	if (DirectStateAccess::IsSupported())
+	{
+		CreateMeshes("direct state access", meshVertices, meshIndices, vertexArrays, buffers);
+	}
+	else
+	{
+		std::cout << "VERTEX::BENCHMARK direct state access is not supported" << std::endl;
+	}
+	DirectStateAccess::SetEnabled(false);
+	CreateMeshes("bind to edit", meshVertices, meshIndices, vertexArrays, buffers);
+	DirectStateAccess::SetEnabled(true);
+
+	GLStateCache& state = GLStateCache::Global();
+	glDeleteBuffers(static_cast<GLsizei>(buffers.size()), buffers.data());
+	glDeleteVertexArrays(static_cast<GLsizei>(vertexArrays.size()), vertexArrays.data());
+	for (GLuint vertexArray : vertexArrays)
+	{
+		state.Forget(GL_VERTEX_ARRAY, vertexArray);
+	}
+	for (GLuint buffer : buffers)
+	{
+		state.Forget(GL_BUFFER, buffer);
+	}
+	return true;
+}
+
+// Draws meshCount meshes, each in buffers of its own, with a vertex array per mesh and with a single vertex format
+bool BenchmarkBinding(size_t meshCount)
+{
+	Shader shader(EmbeddedShaders::core_vs, EmbeddedShaders::core_frag, { "INSTANCED" });
+	if (!shader.IsReady())
+	{
+		std::cout << "ERROR::VERTEX::FORMAT::BENCHMARK::SHADER_NOT_READY" << std::endl;
+		return false;
+	}
+	shader.Use();
+
+	GLStateCache& state = GLStateCache::Global();
+	std::vector<GLuint> vertexArrays(meshCount), buffers(meshCount * 2);
+	std::vector<GLsizei> indexCounts(meshCount);
+	std::vector<TriangleVertex> vertices;
+	std::vector<GLuint> indices;
+	for (size_t i = 0; i < meshCount; ++i)
+	{
+		CreatePolygon(i, vertices, indices);
+		vertexArrays[i] = DirectStateAccess::CreateVertexArray();
+		buffers[i * 2] = DirectStateAccess::CreateBuffer();
+		buffers[i * 2 + 1] = DirectStateAccess::CreateBuffer();
+		DirectStateAccess::BufferStorage(buffers[i * 2], vertices.size() * sizeof(TriangleVertex), vertices.data(), 0);
+		DirectStateAccess::BufferStorage(buffers[i * 2 + 1], indices.size() * sizeof(GLuint), indices.data(), 0);
+		VertexLayout<TriangleVertex>::Apply(vertexArrays[i], buffers[i * 2], triangleAttributes);
+		DirectStateAccess::VertexArrayElementBuffer(vertexArrays[i], buffers[i * 2 + 1]);
+		indexCounts[i] = static_cast<GLsizei>(indices.size());
+	}
+
+	// The per draw data is set with glVertexAttrib, the instance attributes are not read from a buffer
+	auto setInstance = [meshCount](size_t i)
+	{
+		const Instance instance = GetInstance(i, meshCount);
+		glVertexAttrib4fv(2, instance.transform);
+		glVertexAttrib4Nubv(3, instance.color.values);
+	};
+	MeasureFrames("vertex array per mesh", meshCount, [&]()
+	{
+		for (size_t i = 0; i < meshCount; ++i)
+		{
+			setInstance(i);
+			state.BindVertexArray(vertexArrays[i]);
+			glDrawElements(GL_TRIANGLES, indexCounts[i], GL_UNSIGNED_INT, nullptr);
+		}
+	});
+
+	// The format is set once, every draw changes the buffers of the binding point and of the indices
+	auto measureFormat = [&](const std::string& name)
+	{
+		VertexFormat format;
+		format.AddBinding<TriangleVertex>(0, triangleAttributes);
+		MeasureFrames(name, meshCount, [&]()
+		{
+			for (size_t i = 0; i < meshCount; ++i)
+			{
+				setInstance(i);
+				format.BindVertexBuffer(0, buffers[i * 2]);
+				format.BindElementBuffer(buffers[i * 2 + 1]);
+				format.Bind();
+				glDrawElements(GL_TRIANGLES, indexCounts[i], GL_UNSIGNED_INT, nullptr);
+			}
+		});
+		format.PrintStatistics();
+	};
+	if (VertexFormat::IsAttribBindingSupported())
+	{
+		measureFormat("vertex format, vertex attrib binding");
+	}
+	else
+	{
+		std::cout << "VERTEX::BENCHMARK vertex attrib binding is not supported" << std::endl;
+	}
+	VertexFormat::SetAttribBindingEnabled(false);
+	measureFormat("vertex format, attribute pointers");
+	VertexFormat::SetAttribBindingEnabled(true);
+
+	glDeleteBuffers(static_cast<GLsizei>(buffers.size()), buffers.data());
+	glDeleteVertexArrays(static_cast<GLsizei>(vertexArrays.size()), vertexArrays.data());
+	for (GLuint vertexArray : vertexArrays)
+	{
+		state.Forget(GL_VERTEX_ARRAY, vertexArray);
+	}
+	for (GLuint buffer : buffers)
+	{
+		state.Forget(GL_BUFFER, buffer);
+	}
+	return true;
+}
+
+// The uniform block Object of core.vs (OBJECT_BLOCK)
+struct ObjectBlock
+{
+	Std140Vec4 objectTransform;
+	Std140Vec4 objectColor;
+};
+
+// The transform and color of the copy i of count, as the uniforms of core.vs
+ObjectBlock GetObjectBlock(size_t i, size_t count)
+{
+	const Instance instance = GetInstance(i, count);
+	const GLfloat* transform = instance.transform;
+	const GLubyte* color = instance.color.values;
+	return ObjectBlock{ { transform[0], transform[1], transform[2], transform[3] }, { color[0] / 255.0f, color[1] / 255.0f, color[2] / 255.0f, color[3] / 255.0f } };
+}
+
+// Draws objectCount copies of the triangle with a draw call each, giving every copy its transform and color
+// with glUniform, with a uniform buffer per object, and with a part of a UniformRing
+bool BenchmarkUniforms(size_t objectCount)
+{
+	Shader uniformShader(EmbeddedShaders::core_vs, EmbeddedShaders::core_frag, { "OBJECT_UNIFORMS" });
+	Shader blockShader(EmbeddedShaders::core_vs, EmbeddedShaders::core_frag, { "OBJECT_BLOCK" });
+	if (!uniformShader.IsReady() || !blockShader.IsReady())
+	{
+		std::cout << "ERROR::UNIFORM_BUFFER::BENCHMARK::SHADER_NOT_READY" << std::endl;
+		return false;
+	}
+	const GLuint OBJECT_BINDING = 0;
+	const uint32_t objectId = ShaderReflection::Id("Object");
+	if (!UniformBlockLayout::Validate(blockShader.GetReflection(), objectId,
+		{ UNIFORM_BLOCK_MEMBER(ObjectBlock, objectTransform), UNIFORM_BLOCK_MEMBER(ObjectBlock, objectColor) }, sizeof(ObjectBlock))
+		|| !blockShader.BindUniformBlock(objectId, OBJECT_BINDING))
+	{
+		return false;
+	}
+
+	const TriangleVertex vertices[] =
+	{
+		{ { -0.5f, -0.5f, 0.0f }, { 1.0f, 0.0f, 0.0f } },
+		{ { 0.5f, -0.5f, 0.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { 0.0f, 0.5f, 0.0f }, { 0.0f, 0.0f, 1.0f } }
+	};
+	const GLuint indices[] = { 0, 1, 2 };
+	GLStateCache& state = GLStateCache::Global();
+	const GLuint vertexArray = DirectStateAccess::CreateVertexArray();
+	const GLuint buffers[] = { DirectStateAccess::CreateBuffer(), DirectStateAccess::CreateBuffer() };
+	DirectStateAccess::BufferStorage(buffers[0], sizeof(vertices), vertices, 0);
+	DirectStateAccess::BufferStorage(buffers[1], sizeof(indices), indices, 0);
+	VertexLayout<TriangleVertex>::Apply(vertexArray, buffers[0], triangleAttributes);
+	DirectStateAccess::VertexArrayElementBuffer(vertexArray, buffers[1]);
+	state.BindVertexArray(vertexArray);
+
+	const GLint transformUniform = uniformShader.GetUniform(ShaderReflection::Id("objectTransform"));
+	const GLint colorUniform = uniformShader.GetUniform(ShaderReflection::Id("objectColor"));
+	MeasureFrames("glUniform per object", objectCount, [&]()
+	{
+		uniformShader.Use();
+		for (size_t i = 0; i < objectCount; ++i)
+		{
+			const ObjectBlock object = GetObjectBlock(i, objectCount);
+			uniformShader.SetVec4(transformUniform, object.objectTransform.x, object.objectTransform.y, object.objectTransform.z, object.objectTransform.w);
+			uniformShader.SetVec4(colorUniform, object.objectColor.x, object.objectColor.y, object.objectColor.z, object.objectColor.w);
+			glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, nullptr);
+		}
+	});
+
+	// Every object owns a small buffer, written again with glBufferSubData every frame
+	std::vector<GLuint> objectBuffers(objectCount);
+	for (GLuint& objectBuffer : objectBuffers)
+	{
+		objectBuffer = DirectStateAccess::CreateBuffer();
+		DirectStateAccess::BufferData(objectBuffer, sizeof(ObjectBlock), nullptr, GL_DYNAMIC_DRAW);
+	}
+	MeasureFrames("uniform buffer per object", objectCount, [&]()
+	{
+		blockShader.Use();
+		for (size_t i = 0; i < objectCount; ++i)
+		{
+			const ObjectBlock object = GetObjectBlock(i, objectCount);
+			DirectStateAccess::BufferSubData(objectBuffers[i], 0, sizeof(object), &object);
+			state.BindBufferBase(GL_UNIFORM_BUFFER, OBJECT_BINDING, objectBuffers[i]);
+			glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, nullptr);
+		}
+	});
+
+	{
+		// The allocations are aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, which can be much more than the size of the block
+		GLint alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		const GLsizeiptr objectSize = (sizeof(ObjectBlock) + alignment - 1) / alignment * alignment;
+		UniformRing ring(static_cast<GLsizeiptr>(objectCount) * objectSize);
+		std::vector<UniformRing::Allocation> allocations(objectCount);
+		MeasureFrames("uniform ring", objectCount, [&]()
+		{
+			ring.BeginFrame();
+			for (size_t i = 0; i < objectCount; ++i)
+			{
+				allocations[i] = ring.Allocate(sizeof(ObjectBlock));
+				if (allocations[i].data != nullptr)
+				{
+					const ObjectBlock object = GetObjectBlock(i, objectCount);
+					memcpy(allocations[i].data, &object, sizeof(object));
+				}
+			}
+			ring.EndFrame();
+			blockShader.Use();
+			for (size_t i = 0; i < objectCount; ++i)
+			{
+				if (allocations[i].data != nullptr)
+				{
+					ring.Bind(OBJECT_BINDING, allocations[i], sizeof(ObjectBlock));
+					glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, nullptr);
+				}
+			}
+			ring.Fence();
+		});
+	}
+
+	state.BindVertexArray(0);
+	glDeleteBuffers(static_cast<GLsizei>(objectBuffers.size()), objectBuffers.data());
+	glDeleteBuffers(2, buffers);
+	glDeleteVertexArrays(1, &vertexArray);
+	state.Forget(GL_VERTEX_ARRAY, vertexArray);
+	for (GLuint buffer : objectBuffers)
+	{
+		state.Forget(GL_BUFFER, buffer);
+	}
+	for (GLuint buffer : buffers)
+	{
+		state.Forget(GL_BUFFER, buffer);
+	}
+	return true;
+}
+
+// The particles of WriteParticles computed by a compute shader, into a storage buffer laid out as TriangleVertex
+const std::string particlesSource = R"glsl(#version 430 core
+layout (local_size_x = 64) in;
+
+layout (std430) buffer Particles
+{
+	float values[];
+};
+
+uniform int count;
+uniform int frame;
+
+void main()
+{
+	int i = int(gl_GlobalInvocationID.x);
+	if (i >= count)
+	{
+		return;
+	}
+	float angle = float(i % 1024) * 0.00614 + float(frame) * 0.01;
+	float radius = float(i / 1024 % 1024) / 1024.0;
+	int first = i * 6;
+	values[first] = radius * cos(angle);
+	values[first + 1] = radius * sin(angle);
+	values[first + 2] = 0.0;
+	values[first + 3] = radius;
+	values[first + 4] = 1.0 - radius;
+	values[first + 5] = 0.5;
+}
+)glsl";
+
+// The largest difference between the GPU and the CPU allowed when checking the particles read back
+const float PARTICLE_TOLERANCE = 1e-3f;
+
+// Writes particleCount particles with a compute shader and draws them as vertices every frame, once with the barriers
+// of MemoryBarrierTracker and once with GL_ALL_BARRIER_BITS after every dispatch, then reads them back and checks them
+bool BenchmarkCompute(size_t particleCount)
+{
+	// The kernel is "#version 430 core" with a shader storage block, GL_ARB_compute_shader alone cannot compile it
+	if (!GLEW_VERSION_4_3)
+	{
+		std::cout << "ERROR::MEMORY_BARRIERS::BENCHMARK::COMPUTE_NOT_SUPPORTED" << std::endl;
+		return false;
+	}
+	const ShaderCode particlesCode = { "particles.comp", particlesSource.data(), particlesSource.size(), ShaderCache::Hash(particlesSource) };
+	Shader compute(GL_COMPUTE_SHADER, particlesCode);
+	Shader shader(EmbeddedShaders::core_vs, EmbeddedShaders::core_frag, std::vector<std::string>());
+	const GLuint PARTICLES_BINDING = 0;
+	if (!compute.IsReady() || !shader.IsReady() || !compute.BindStorageBlock(ShaderReflection::Id("Particles"), PARTICLES_BINDING))
+	{
+		std::cout << "ERROR::MEMORY_BARRIERS::BENCHMARK::SHADER_NOT_READY" << std::endl;
+		return false;
+	}
+	const GLint countUniform = compute.GetUniform(ShaderReflection::Id("count"));
+	const GLint frameUniform = compute.GetUniform(ShaderReflection::Id("frame"));
+
+	GLStateCache& state = GLStateCache::Global();
+	const GLsizeiptr size = static_cast<GLsizeiptr>(particleCount * sizeof(TriangleVertex));
+	const GLuint vertexArray = DirectStateAccess::CreateVertexArray();
+	const GLuint buffer = DirectStateAccess::CreateBuffer();
+	DirectStateAccess::BufferStorage(buffer, size, nullptr, 0);
+	VertexLayout<TriangleVertex>::Apply(vertexArray, buffer, triangleAttributes);
+	state.BindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLES_BINDING, buffer);
+
+	// The buffer is read as vertices every frame, and copied back to the application at the end
+	MemoryBarrierTracker& barriers = MemoryBarrierTracker::Global();
+	const GLbitfield uses = GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT;
+	const GLsizei count = static_cast<GLsizei>(particleCount);
+	int frame = 0;
+	auto dispatch = [&]()
+	{
+		compute.Use();
+		compute.SetInt(countUniform, count);
+		compute.SetInt(frameUniform, frame++);
+		compute.DispatchInvocations(static_cast<GLuint>(particleCount));
+	};
+	auto draw = [&]()
+	{
+		shader.Use();
+		state.BindVertexArray(vertexArray);
+		glDrawArrays(GL_POINTS, 0, count);
+	};
+
+	barriers.ResetStatistics();
+	MeasureFrames("compute, tracked barriers", particleCount, [&]()
+	{
+		dispatch();
+		barriers.Write(GL_BUFFER, buffer, uses);
+		barriers.Use(GL_BUFFER, buffer, GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+		barriers.Apply();
+		draw();
+	});
+	const MemoryBarrierTracker::Statistics statistics = barriers.GetStatistics();
+	std::cout << "  " << statistics.barriers << " barriers with the bits 0x" << std::hex << statistics.bits << std::dec << ", "
+		<< statistics.skipped << " uses without a barrier" << std::endl;
+
+	MeasureFrames("compute, GL_ALL_BARRIER_BITS", particleCount, [&]()
+	{
+		dispatch();
+		glMemoryBarrier(GL_ALL_BARRIER_BITS);
+		draw();
+	});
+
+	// The last frame again through the tracker, then the particles are read back and compared with the CPU
+	frame--;
+	dispatch();
+	barriers.Write(GL_BUFFER, buffer, uses);
+	barriers.Use(GL_BUFFER, buffer, GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+	barriers.Apply();
+	draw();
+	barriers.Use(GL_BUFFER, buffer, GL_BUFFER_UPDATE_BARRIER_BIT);
+	barriers.Apply();
+	std::vector<TriangleVertex> particles(particleCount), expected(particleCount);
+	state.BindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, size, particles.data());
+	WriteParticles(expected.data(), particleCount, frame - 1);
+
+	size_t wrong = 0;
+	for (size_t i = 0; i < particleCount; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			if (std::fabs(particles[i].position[j] - expected[i].position[j]) > PARTICLE_TOLERANCE
+				|| std::fabs(particles[i].color[j] - expected[i].color[j]) > PARTICLE_TOLERANCE)
+			{
+				wrong++;
+				break;
+			}
+		}
+	}
+	std::cout << "VERTEX::BENCHMARK compute read back: " << wrong << " of " << particleCount << " particles wrong, "
+		<< barriers.GetTrackedCount() << " resources still tracked" << std::endl;
+
+	state.BindVertexArray(0);
+	glDeleteBuffers(1, &buffer);
+	glDeleteVertexArrays(1, &vertexArray);
+	barriers.Forget(GL_BUFFER, buffer);
+	state.Forget(GL_BUFFER, buffer);
+	state.Forget(GL_VERTEX_ARRAY, vertexArray);
+	return wrong == 0;
+}
+
+// A vertex and a fragment shader for the pipeline benchmark, every VERTEX_VARIANT and FRAGMENT_VARIANT is a different stage
+const std::string variantVertexSource = R"glsl(#version 330 core
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 color;
+
+out vec3 shade;
+
+void main()
+{
+	gl_Position = vec4(position * (1.0 + float(VERTEX_VARIANT) * 0.01), 1.0);
+	shade = color;
+}
+)glsl";
+
+const std::string variantFragmentSource = R"glsl(#version 330 core
+in vec3 shade;
+
+out vec4 color;
+
+void main()
+{
+	color = vec4(shade * (1.0 - float(FRAGMENT_VARIANT) * 0.01), 1.0);
+}
+)glsl";
+
+// Writes a text into a file of the working directory, returns false if the file could not be written
+bool WriteFile(const std::string& path, const std::string& text)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(text.data(), static_cast<std::streamsize>(text.size()));
+	if (!file)
+	{
+		std::cout << "ERROR::BENCHMARK::FILE_NOT_SUCCESFULLY_WRITTEN " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// The memory in use, in KB: the video memory used as reported by GL_NVX_gpu_memory_info or GL_ATI_meminfo (as minus the free memory)
+// when the driver has one of them, otherwise the resident memory of the process, which holds the programs of software renderers.
+// name is set to what was measured.
+long long GetMemoryKilobytes(std::string& name)
+{
+	if (GLEW_NVX_gpu_memory_info)
+	{
+		name = "GPU memory (GL_NVX_gpu_memory_info)";
+		GLint total = 0, available = 0;
+		glGetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &total);
+		glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available);
+		return total - available;
+	}
+	if (GLEW_ATI_meminfo)
+	{
+		name = "GPU memory (GL_ATI_meminfo)";
+		GLint free[4] = { 0, 0, 0, 0 };
+		glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, free);
+		return -static_cast<long long>(free[0]);
+	}
+	name = "process resident memory";
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? static_cast<long long>(counters.WorkingSetSize / 1024) : 0;
+#else
+	long long pages = 0, resident = 0;
+	std::ifstream statm("/proc/self/statm");
+	statm >> pages >> resident;
+	return resident * sysconf(_SC_PAGESIZE) / 1024;
+#endif
+}
+
+// Builds variantCount vertex shaders combined with variantCount fragment shaders and draws a triangle with every combination,
+// once with a program linked for every combination (N x M links) and once with separable stages and pipelines (N + M links)
+bool BenchmarkPipelines(size_t variantCount)
+{
+	if (!ShaderPipelineCache::IsSupported())
+	{
+		std::cout << "ERROR::SHADER::PIPELINE::BENCHMARK::NOT_SUPPORTED" << std::endl;
+		return false;
+	}
+	// The stages of a pipeline are read through the preprocessor, so both ways read the sources from the same files
+	const std::string vertexPath = "benchmark_variant.vs";
+	const std::string fragmentPath = "benchmark_variant.frag";
+	if (!WriteFile(vertexPath, variantVertexSource) || !WriteFile(fragmentPath, variantFragmentSource))
+	{
+		return false;
+	}
+
+	const TriangleVertex vertices[] =
+	{
+		{ { -0.5f, -0.5f, 0.0f }, { 1.0f, 0.0f, 0.0f } },
+		{ { 0.5f, -0.5f, 0.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { 0.0f, 0.5f, 0.0f }, { 0.0f, 0.0f, 1.0f } }
+	};
+	GLStateCache& state = GLStateCache::Global();
+	const GLuint vertexArray = DirectStateAccess::CreateVertexArray();
+	const GLuint buffer = DirectStateAccess::CreateBuffer();
+	DirectStateAccess::BufferStorage(buffer, sizeof(vertices), vertices, 0);
+	VertexLayout<TriangleVertex>::Apply(vertexArray, buffer, triangleAttributes);
+	state.BindVertexArray(vertexArray);
+	std::cout << "VERTEX::BENCHMARK " << variantCount << " vertex shaders x " << variantCount << " fragment shaders" << std::endl;
+
+	// The first program built starts up the compiler of the driver, which keeps its memory afterwards.
+	// One more variant is built before measuring, so that memory is not counted for either way.
+	{
+		const std::string variant = std::to_string(variantCount);
+		Shader warmUp(vertexPath.c_str(), fragmentPath.c_str(), { "VERTEX_VARIANT " + variant, "FRAGMENT_VARIANT " + variant });
+		warmUp.Use();
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+
+	// The memory freed by the first way may be reused by the second one without showing in the resident memory,
+	// so the way expected to use less memory runs first
+	bool success = true;
+	std::string memoryName;
+	glFinish();
+	long long memory = GetMemoryKilobytes(memoryName);
+
+	// Every stage linked once into a separable program, and a pipeline per combination
+	auto start = std::chrono::high_resolution_clock::now();
+	{
+		ShaderPipelineCache pipelines;
+		for (size_t i = 0; i < variantCount; ++i)
+		{
+			const GLuint vertexStage = pipelines.GetStage(GL_VERTEX_SHADER, vertexPath, { "VERTEX_VARIANT " + std::to_string(i) });
+			for (size_t j = 0; j < variantCount; ++j)
+			{
+				const GLuint fragmentStage = pipelines.GetStage(GL_FRAGMENT_SHADER, fragmentPath, { "FRAGMENT_VARIANT " + std::to_string(j) });
+				const GLuint pipeline = pipelines.GetPipeline(vertexStage, fragmentStage);
+				success = pipeline != 0 && success;
+				ShaderPipelineCache::Use(pipeline);
+				glDrawArrays(GL_TRIANGLES, 0, 3);
+			}
+		}
+		glFinish();
+		const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		const ShaderPipelineCache::Statistics& statistics = pipelines.GetStatistics();
+		std::cout << "VERTEX::BENCHMARK pipelines: " << statistics.compiles << " links, "
+			<< statistics.vertexStages + statistics.fragmentStages - statistics.compiles << " loaded from the program binary cache, "
+			<< statistics.pipelines << " pipelines, " << milliseconds << " ms, " << GetMemoryKilobytes(memoryName) - memory << " KB more " << memoryName << std::endl;
+		ShaderPipelineCache::Use(0);
+	}
+	glFinish();
+	memory = GetMemoryKilobytes(memoryName);
+
+	// Every combination linked into its own program, the defines of both stages are given to both files
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<std::unique_ptr<Shader>> programs;
+	size_t cached = 0;
+	for (size_t i = 0; i < variantCount; ++i)
+	{
+		for (size_t j = 0; j < variantCount; ++j)
+		{
+			programs.emplace_back(new Shader(vertexPath.c_str(), fragmentPath.c_str(),
+				{ "VERTEX_VARIANT " + std::to_string(i), "FRAGMENT_VARIANT " + std::to_string(j) }));
+			Shader& program = *programs.back();
+			success = program.IsReady() && success;
+			cached += program.GetCacheStatus() == ShaderCache::HIT ? 1 : 0;
+			program.Use();
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+	}
+	glFinish();
+	const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << "VERTEX::BENCHMARK programs: " << programs.size() - cached << " links, " << cached << " loaded from the program binary cache, "
+		<< milliseconds << " ms, " << GetMemoryKilobytes(memoryName) - memory << " KB more " << memoryName << std::endl;
+	programs.clear();
+
+	state.BindVertexArray(0);
+	glDeleteBuffers(1, &buffer);
+	glDeleteVertexArrays(1, &vertexArray);
+	state.Forget(GL_BUFFER, buffer);
+	state.Forget(GL_VERTEX_ARRAY, vertexArray);
+	std::remove(vertexPath.c_str());
+	std::remove(fragmentPath.c_str());
+	if (!success)
+	{
+		std::cout << "ERROR::SHADER::PIPELINE::BENCHMARK::BUILD_FAILED" << std::endl;
+	}
+	return success;
+}
+
+// The size of every file of the source loading benchmark, and how many times all the files are read
+const size_t SOURCE_FILE_SIZE = 256 * 1024;
+const int SOURCE_PASSES = 3;
+
+// Reads a file the way the shaders used to: into a stringstream, then copied out of it into a string
+bool LoadWithStream(const std::string& path, std::string& text)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	std::stringstream stream;
+	stream << file.rdbuf();
+	text = stream.str();
+	return true;
+}
+
+// Writes fileCount shader files and reads all of them a few times, with an ifstream and a stringstream,
+// with ShaderSource::Load, and with ShaderSource::LoadAll reading the files in pairs like the two stages of a shader
+bool BenchmarkSources(size_t fileCount)
+{
+	// Lines of GLSL repeated up to the size of a file, every file starts with its own number so no two are the same
+	const std::string line = "\tcolor += texture(albedo, coordinates + vec2(0.001, 0.002)) * max(dot(normal, light), 0.0);\n";
+	std::vector<std::string> paths;
+	for (size_t i = 0; i < fileCount; ++i)
+	{
+		std::string text = "#version 330 core\n// benchmark file " + std::to_string(i) + "\n";
+		while (text.size() + line.size() <= SOURCE_FILE_SIZE)
+		{
+			text += line;
+		}
+		paths.push_back("benchmark_source_" + std::to_string(i) + ".glsl");
+		if (!WriteFile(paths.back(), text))
+		{
+			return false;
+		}
+	}
+
+	std::vector<std::string> expected(fileCount), texts(fileCount);
+	// The preprocessor hands out strings it shares instead of filling texts
+	std::vector<std::shared_ptr<const std::string>> shared(fileCount);
+	for (size_t i = 0; i < fileCount; ++i)
+	{
+		LoadWithStream(paths[i], expected[i]);
+	}
+	unsigned long long bytes = 0;
+	for (const std::string& text : expected)
+	{
+		bytes += text.size();
+	}
+	std::cout << "VERTEX::BENCHMARK " << fileCount << " files, " << bytes / (1024.0 * 1024.0) << " MB read " << SOURCE_PASSES << " times" << std::endl;
+
+	// Runs every pass of one way of reading, load reads all the files into texts. Returns false if a text differs from the file.
+	auto measure = [&](const std::string& name, unsigned int copies, std::function<bool()> load)
+	{
+		bool success = true;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int pass = 0; pass < SOURCE_PASSES; ++pass)
+		{
+			success = load() && success;
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		for (size_t i = 0; i < fileCount; ++i)
+		{
+			success = success && (shared[i] ? *shared[i] : texts[i]) == expected[i];
+		}
+		std::cout << "VERTEX::BENCHMARK " << name << ": " << seconds * 1e3 << " ms, " << bytes * SOURCE_PASSES / seconds * 1e-9 << " GB/s, "
+			<< bytes * SOURCE_PASSES * copies / (1024.0 * 1024.0) << " MB copied" << (success ? "" : ", WRONG TEXT") << std::endl;
+		texts.assign(fileCount, std::string());
+		shared.assign(fileCount, nullptr);
+		return success;
+	};
+
+	// The stream copies every byte into its buffer, then str() copies it again. ShaderSource reads it straight into the string.
+	bool success = measure("ifstream + stringstream", 2, [&]()
+	{
+		bool loaded = true;
+		for (size_t i = 0; i < fileCount; ++i)
+		{
+			loaded = LoadWithStream(paths[i], texts[i]) && loaded;
+		}
+		return loaded;
+	});
+	success = measure("ShaderSource::Load", 1, [&]()
+	{
+		bool loaded = true;
+		for (size_t i = 0; i < fileCount; ++i)
+		{
+			loaded = ShaderSource::Load(paths[i], texts[i]) && loaded;
+		}
+		return loaded;
+	}) && success;
+	success = measure("ShaderSource::LoadAll in pairs", 1, [&]()
+	{
+		bool loaded = true;
+		std::vector<std::string> pair;
+		for (size_t i = 0; i < fileCount; i += 2)
+		{
+			const size_t end = std::min(i + 2, fileCount);
+			loaded = ShaderSource::LoadAll(std::vector<std::string>(paths.begin() + i, paths.begin() + end), pair) && loaded;
+			std::move(pair.begin(), pair.end(), texts.begin() + i);
+		}
+		return loaded;
+	}) && success;
+
+	// The path the shaders take: the preprocessor reads the file (a file without includes is not copied again),
+	// and the text goes to glShaderSource with the #line after #version passed as a separate string.
+	// The copy the driver makes of the source is not counted, every way of reading needs it.
+	std::vector<GLuint> shaders(fileCount);
+	for (GLuint& shader : shaders)
+	{
+		shader = glCreateShader(GL_FRAGMENT_SHADER);
+	}
+	success = measure("ShaderPreprocessor::Expand + SetShaderSource", 1, [&]()
+	{
+		ShaderPreprocessor& preprocessor = ShaderPreprocessor::Global();
+		preprocessor.Invalidate(paths);
+		bool loaded = true;
+		for (size_t i = 0; i < fileCount; ++i)
+		{
+			std::shared_ptr<const ShaderPreprocessor::Expansion> source = preprocessor.Expand(paths[i]);
+			const ShaderCode code = { paths[i].c_str(), source->code->data(), source->code->size(), source->hash };
+			Shader::SetShaderSource(shaders[i], code, std::string());
+			loaded = !source->code->empty() && loaded;
+			shared[i] = source->code;
+		}
+		return loaded;
+	}) && success;
+	for (GLuint shader : shaders)
+	{
+		glDeleteShader(shader);
+	}
+
+	for (const std::string& path : paths)
+	{
+		std::remove(path.c_str());
+	}
+	if (!success)
+	{
+		std::cout << "ERROR::SHADER::SOURCE::BENCHMARK::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+	}
+	return success;
+}
+
+// Creates programCount variants of core.vs/core.frag in the asynchronous mode and waits until all of them can be used.
+// Prints the time and how many came from the program binary cache, returns false if one of them failed.
+bool BuildPrograms(const std::string& name, size_t programCount)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<std::unique_ptr<Shader>> programs;
+	for (size_t i = 0; i < programCount; ++i)
+	{
+		programs.emplace_back(new Shader(EmbeddedShaders::core_vs, EmbeddedShaders::core_frag, { "BENCHMARK_VARIANT " + std::to_string(i) }, true));
+	}
+	size_t ready = 0, failed = 0;
+	while (ready + failed < programCount)
+	{
+		ready = 0;
+		failed = 0;
+		for (const std::unique_ptr<Shader>& program : programs)
+		{
+			ready += program->IsReady() ? 1 : 0;
+			failed += !program->IsPending() && !program->IsReady() ? 1 : 0;
+		}
+	}
+	const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	size_t counts[4] = { 0, 0, 0, 0 };
+	for (const std::unique_ptr<Shader>& program : programs)
+	{
+		counts[program->GetCacheStatus()]++;
+	}
+	std::cout << "VERTEX::BENCHMARK " << name << ": " << programCount << " programs usable after " << milliseconds << " ms ("
+		<< counts[ShaderCache::HIT] << " hits, " << counts[ShaderCache::MISS] << " misses, " << counts[ShaderCache::INVALIDATED] << " invalidated, "
+		<< counts[ShaderCache::DISABLED] << " without cache)" << std::endl;
+	return failed == 0;
+}
+
+// Builds programCount programs with the program binary cache cleared, with the cache filled by the first run,
+// and with every entry marked as written by another driver, as after a driver update
+bool BenchmarkCache(size_t programCount)
+{
+	if (!ShaderCache::IsSupported())
+	{
+		std::cout << "ERROR::SHADER::CACHE::BENCHMARK::NOT_SUPPORTED" << std::endl;
+		return false;
+	}
+	// The entries of the benchmark are kept apart from the ones of the application, and deleted at the end
+	const std::string directory = ShaderCache::Directory();
+	ShaderCache::Directory() = "benchmark_shader_cache";
+	std::vector<uint64_t> keys;
+	for (size_t i = 0; i < programCount; ++i)
+	{
+		keys.push_back(Shader::GetCacheKey({ EmbeddedShaders::core_vs, EmbeddedShaders::core_frag }, { "BENCHMARK_VARIANT " + std::to_string(i) }));
+		ShaderCache::Remove(keys.back());
+	}
+
+	bool success = BuildPrograms("cold cache", programCount);
+	success = BuildPrograms("warm cache", programCount) && success;
+	for (uint64_t key : keys)
+	{
+		ShaderCache::MarkStale(key);
+	}
+	success = BuildPrograms("invalidated cache", programCount) && success;
+
+	for (uint64_t key : keys)
+	{
+		ShaderCache::Remove(key);
+	}
+	ShaderCache::Directory() = directory;
+	return success;
+}
+
+int main(int argc, char* argv[])
+{
+	const bool instances = argc > 1 && strcmp(argv[1], "--instances") == 0;
+	const bool batch = argc > 1 && strcmp(argv[1], "--batch") == 0;
+	const bool stream = argc > 1 && strcmp(argv[1], "--stream") == 0;
+	const bool arena = argc > 1 && strcmp(argv[1], "--arena") == 0;
+	const bool directStateAccess = argc > 1 && strcmp(argv[1], "--dsa") == 0;
+	const bool binding = argc > 1 && strcmp(argv[1], "--binding") == 0;
+	const bool uniforms = argc > 1 && strcmp(argv[1], "--uniforms") == 0;
+	const bool compute = argc > 1 && strcmp(argv[1], "--compute") == 0;
+	const bool pipelines = argc > 1 && strcmp(argv[1], "--pipelines") == 0;
+	const bool sources = argc > 1 && strcmp(argv[1], "--sources") == 0;
+	const bool cache = argc > 1 && strcmp(argv[1], "--cache") == 0;
+	const int countArgument = instances || batch || stream || arena || directStateAccess || binding || uniforms || compute || pipelines || sources || cache ? 2 : 1;
+	const long count = argc > countArgument ? std::strtol(argv[countArgument], nullptr, 10)
+		: (instances || stream || compute ? 1000000 : batch || arena || directStateAccess || binding || uniforms ? 10000
+		: pipelines ? 8 : sources ? 300 : cache ? 20 : 4 * 1024 * 1024);
+	if (argc > countArgument + 1 || count <= 0)
+	{
+		std::cout << "Usage: VertexBenchmark [vertex count]" << std::endl;
+		std::cout << "       VertexBenchmark --instances [largest instance count]" << std::endl;
+		std::cout << "       VertexBenchmark --batch [largest mesh count]" << std::endl;
+		std::cout << "       VertexBenchmark --stream [particle count]" << std::endl;
+		std::cout << "       VertexBenchmark --arena [mesh count]" << std::endl;
+		std::cout << "       VertexBenchmark --dsa [mesh count]" << std::endl;
+		std::cout << "       VertexBenchmark --binding [mesh count]" << std::endl;
+		std::cout << "       VertexBenchmark --uniforms [object count]" << std::endl;
+		std::cout << "       VertexBenchmark --compute [particle count]" << std::endl;
+		std::cout << "       VertexBenchmark --pipelines [variant count]" << std::endl;
+		std::cout << "       VertexBenchmark --sources [file count]" << std::endl;
+		std::cout << "       VertexBenchmark --cache [program count]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// The same context as the application, in a window which is never shown. Compute shaders need OpenGL 4.3.
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, compute ? 4 : 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	GLFWwindow* window = glfwCreateWindow(1, 1, "VertexBenchmark", nullptr, nullptr);
+	if (window == nullptr)
+	{
+		std::cout << "Failed to create GLFW window" << std::endl;
+		glfwTerminate();
+		return EXIT_FAILURE;
+	}
+	glfwMakeContextCurrent(window);
+	glewExperimental = GL_TRUE;
+	if (GLEW_OK != glewInit())
+	{
+		std::cout << "Failed to initialize GLEW" << std::endl;
+		glfwTerminate();
+		return EXIT_FAILURE;
+	}
+	GLStateCache::Global().Viewport(0, 0, 1, 1);
+
+	const bool success = instances ? BenchmarkInstances(static_cast<size_t>(count))
+		: batch ? BenchmarkBatch(static_cast<size_t>(count))
+		: stream ? BenchmarkStreaming(static_cast<size_t>(count))
+		: arena ? BenchmarkArena(static_cast<size_t>(count))
+		: directStateAccess ? BenchmarkDirectStateAccess(static_cast<size_t>(count))
+		: binding ? BenchmarkBinding(static_cast<size_t>(count))
+		: uniforms ? BenchmarkUniforms(static_cast<size_t>(count))
+		: compute ? BenchmarkCompute(static_cast<size_t>(count))
+		: pipelines ? BenchmarkPipelines(static_cast<size_t>(count))
+		: sources ? BenchmarkSources(static_cast<size_t>(count))
+		: cache ? BenchmarkCache(static_cast<size_t>(count)) : BenchmarkFormats(static_cast<size_t>(count));
+	glfwTerminate();
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}